@@ -0,0 +1,76 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include <cmath>
+
+#include "ArrowsAtlas.h"
+
+//---------------------------------------------------------------
+int ArrowsAtlas::directionIndex (double ang)
+{
+    int k = (int) std::lround (ang * DirectionSteps / (2*M_PI)) % DirectionSteps;
+    return k < 0 ? k+DirectionSteps : k;
+}
+//---------------------------------------------------------------
+double ArrowsAtlas::directionAngle (int index)
+{
+    return index * 2*M_PI / DirectionSteps;
+}
+//---------------------------------------------------------------
+void ArrowsAtlas::draw (QPainter &pnt, int i, int j, quint64 key,
+                        const std::function <void (QPainter &, int, int)> &render)
+{
+    QMutexLocker lock (&mutex);
+    auto it = cells.constFind (key);
+    int cell;
+    if (it != cells.constEnd()) {
+        cell = it.value();
+    }
+    else {
+        if (cells.size() >= MaxPages*CellsPerPage) {
+            pages.clear ();     // many colors or sizes: start again
+            cells.clear ();
+        }
+        cell = cells.size();
+        int page = cell / CellsPerPage;
+        if (page >= (int) pages.size()) {
+            int size = CellsPerLine*CellSize;
+            pages.push_back (QImage (size, size, QImage::Format_ARGB32_Premultiplied));
+            pages.back().fill (Qt::transparent);
+        }
+        int k = cell % CellsPerPage;
+        int x = k % CellsPerLine * CellSize;
+        int y = k / CellsPerLine * CellSize;
+        QPainter pntCell (&pages [page]);
+        pntCell.setRenderHint (QPainter::Antialiasing, true);
+        pntCell.setClipRect (x, y, CellSize, CellSize);
+        render (pntCell, x+CellSize/2, y+CellSize/2);
+        cells.insert (key, cell);
+    }
+    int k = cell % CellsPerPage;
+    pnt.drawImage (i-CellSize/2, j-CellSize/2, pages [cell / CellsPerPage],
+                   k % CellsPerLine * CellSize, k / CellsPerLine * CellSize,
+                   CellSize, CellSize);
+}
+//---------------------------------------------------------------
+void ArrowsAtlas::clear ()
+{
+    QMutexLocker lock (&mutex);
+    pages.clear ();
+    cells.clear ();
+}
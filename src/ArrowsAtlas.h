@@ -0,0 +1,65 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef ARROWSATLAS_H
+#define ARROWSATLAS_H
+
+#include <functional>
+#include <vector>
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPainter>
+
+//===============================================================
+// Images des flèches (vent, courant, vagues) dessinées une seule fois.
+// Chaque flèche occupe une case d'une page ; la clé contient tout
+// ce dont dépend son image (type, classe de vitesse, direction par
+// pas de 5°, couleur...). Une flèche de la carte est ensuite copiée
+// de sa case par un seul drawImage.
+// Les couches de la carte sont dessinées en parallèle : les accès
+// à un atlas sont protégés par son mutex.
+//===============================================================
+class ArrowsAtlas
+{
+    public:
+        static const int CellSize = 48;         // flèche centrée dans sa case
+        static const int DirectionSteps = 72;   // 5°
+
+        // Index of the direction ang (radians) and its angle
+        static int    directionIndex (double ang);
+        static double directionAngle (int index);
+
+        // Draws the arrow of key centered at (i, j). The arrow is first drawn
+        // in its cell if needed, by render (painter of the page, center
+        // of the cell).
+        void draw (QPainter &pnt, int i, int j, quint64 key,
+                   const std::function <void (QPainter &, int, int)> &render);
+        void clear ();
+
+    private:
+        static const int CellsPerLine = 21;     // pages of 1008x1008 pixels
+        static const int CellsPerPage = CellsPerLine*CellsPerLine;
+        static const int MaxPages = 8;
+        std::vector <QImage> pages;
+        QHash <quint64, int> cells;     // index of the cell of each key
+        QMutex mutex;
+};
+
+#endif
@@ -16,13 +16,13 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
  
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 #include <cstdint>
 
 #include <QMessageBox>
 #include <QDir>
-#include <QPointer>
 
 #include "GribAnimator.h"
 #include "ImageWriter.h"
@@ -191,6 +191,18 @@ void GribAnimator::showImage(int ind, bool showmsg)
 	if (closestatus != 0) return;	// animation creation interrupted
 
 	currentImage = ind;
+	if (currentImage >= nbReadyImages) {
+		waitingImage = isCreatingImages;	// shown when it is drawn
+		if (waitingImage) {
+			lbmessage->setText(
+				QString(tr("Making animation : image %1/%2"))
+								.arg(currentImage+1, 3)
+								.arg(nbImages, 3)
+					);
+		}
+		return;
+	}
+	waitingImage = false;
 	lbimage->setPixmap( *(vectorImages[currentImage]->pixmap) );
 	if (showmsg) {
 		lbmessage->setText(
@@ -209,7 +221,7 @@ void GribAnimator::showNextImage()
 	
 	if (!autoLoop)
 	{
-		if (currentImage >= vectorImages.size())
+		if (currentImage >= (unsigned int) nbImages)
 			timerLoop->stop();
 		else
 			showImage(currentImage);
@@ -217,17 +229,21 @@ void GribAnimator::showNextImage()
 	else
 	{
 		// little pause before next loop
-		if (currentImage == vectorImages.size()-1)
+		if (currentImage == (unsigned int) nbImages-1)
 		{
 			timerLoop->stop();
 			timerPause->setSingleShot(true);
 			timerPause->start(500);
 		}
 			
-		currentImage = currentImage % vectorImages.size();
+		currentImage = currentImage % nbImages;
 		showImage(currentImage);
 	}
-
+	// waits for the image to be drawn
+	if (waitingImage && timerLoop->isActive()) {
+		timerLoop->stop();
+		mustResumeAnim = true;
+	}
 }
 //---------------------------------------
 void GribAnimator::setAutoLoop(bool auto_)
@@ -249,10 +265,15 @@ void GribAnimator::rewindAnim()
 //---------------------------------------
 void GribAnimator::startAnim(int speed)
 {
-	if (currentImage >= vectorImages.size()) {
+	if (currentImage >= (unsigned int) nbImages) {
 		currentImage = 0;
 		showImage(0);
 	}
+	if (waitingImage) {
+		timerLoop->setInterval(speed);
+		mustResumeAnim = true;
+		return;
+	}
  	timerLoop->start(speed);
 }
 //---------------------------------------
@@ -265,12 +286,16 @@ void GribAnimator::setSpeed(int speed)
 void GribAnimator::pauseAnim()
 {
  	timerLoop->stop();
+	mustResumeAnim = false;
 }
 //---------------------------------------
 void GribAnimator::timerPauseOut()
 {
 	if (autoLoop) {
- 		timerLoop->start();
+		if (waitingImage)
+			mustResumeAnim = true;
+		else
+ 			timerLoop->start();
 	}
 }
 
@@ -278,65 +303,171 @@ void GribAnimator::timerPauseOut()
 //===================================================================
 void GribAnimator::createImages()
 {
-	QPainter pnt;
-	std::set<time_t>::iterator iter;
-	int num=0;
-	// XXX hack, find if we have been destroyed by processEvents() loop
-	QPointer<GribAnimator> ref = this;
-
-	stackWidgets->setCurrentWidget(createAnimProgressBar);
     lbmessage->setFont(Font::getFont(FONT_StatusBar));
-	closestatus=0;
-	bool isEarthMapValid = false;
-	for (iter=gribplot->getListDates()->begin();
-				iter!=gribplot->getListDates()->end();   ++iter, num++)
-	{
-		time_t date = *iter;
-		
-//  		qApp->processEvents (); 
-		if (ref == nullptr || closestatus != 0) break;
-		
-		currentImage = num;
+	closestatus = 0;
+	// The terrain warns before modifying the data shared with the copies
+	// of its plotter.
+	connect(terre, SIGNAL(stoppingMapRendering()), this, SLOT(stopRendering()),
+			Qt::DirectConnection);
+	isCreatingImages = true;
+	if (! dates.empty()) {
 		lbmessage->setText(
 			QString(tr("Making animation : image %1/%2 : %3"))
-								.arg(currentImage+1, 3)
+								.arg(1, 3)
 								.arg(nbImages, 3)
-								.arg(Util::formatDateTimeLong(date))
+								.arg(Util::formatDateTimeLong(dates[0]))
 					);
-		
-		qApp->processEvents ();
-		if (ref == nullptr || closestatus != 0) break;
-		
-		AnimImage *img = new AnimImage();
-		assert(img);
-		
-		img->date = date;
-		img->pixmap = drawer->createPixmap_GriddedData ( 
-								date, isEarthMapValid, 
-								gribplot,
-								nullptr,
-								proj,
-								lspois );
-		isEarthMapValid = true;
-		
-        if (img->pixmap == nullptr) {
-            QMessageBox::critical (nullptr,
-				tr("Error"),
-                tr("Need more memory."));
-			delete img;
-			break;
+	}
+	renderNextImage();
+}
+//---------------------------------------
+void GribAnimator::finishImages()
+{
+	if (! isCreatingImages)
+		return;
+	isCreatingImages = false;
+	if (! terre.isNull()) {
+		disconnect(terre, SIGNAL(stoppingMapRendering()), this, SLOT(stopRendering()));
+	}
+	for (Renderer &r : renderers) {
+		if (r.imageIndex >= 0) {
+			r.thread->stop();
+			r.imageIndex = -1;
 		}
-		
-		vectorImages.push_back (img);
-		showImage (currentImage, false);
-		createAnimProgressBar->setCurrentValue (num+1);
 	}
-
-	if (ref == nullptr  || closestatus != 0)
+	imagesToRender.clear();
+	// only the images before the first missing one are played
+	for (unsigned int i=nbReadyImages; i<vectorImages.size(); i++) {
+		delete vectorImages[i];
+	}
+	vectorImages.resize (nbReadyImages);
+	nbImages = nbReadyImages;
+	createAnimProgressBar->hide();
+}
+//---------------------------------------
+// Gives the next dates to the idle threads
+void GribAnimator::renderNextImage()
+{
+	if (closestatus != 0 || !isCreatingImages)
+		return;
+	if (terre.isNull() || terre->getGriddedPlotter() != gribplot) {
+		finishImages();		// the GRIB file has been closed
+		return;
+	}
+	if (nbReadyImages >= dates.size()) {
+		finishImages();
+		return;
+	}
+	for (Renderer &r : renderers) {
+		if (imagesToRender.empty())
+			break;
+		if (r.imageIndex < 0)
+			renderImage (r);
+	}
+}
+//---------------------------------------
+void GribAnimator::renderImage (Renderer &r)
+{
+	r.imageIndex = *imagesToRender.begin();
+	imagesToRender.erase (imagesToRender.begin());
+
+	MapRenderThread::Job job;
+	job.clearLayers = false;
+	if (r.mustCopyPlotter) {
+		r.plotter.reset (gribplot->createDrawingCopy());
+		job.clearLayers = true;
+		r.mustCopyPlotter = false;
+	}
+	job.settings = drawer;
+	job.proj = proj->clone();
+	job.plotter = r.plotter;
+	job.date = dates[r.imageIndex];
+	job.satellitePlotter = nullptr;
+	job.isEarthMapValid = r.isEarthMapValid;
+	job.drawCartouche = true;
+	job.interactive = false;
+	job.isMapMoved = false;
+	job.previews = false;
+	r.thread->render (job);
+	r.isEarthMapValid = true;
+}
+//---------------------------------------
+// The terrain will modify the data of the plotter: the images are drawn
+// again later, with new copies of the plotter.
+void GribAnimator::stopRendering()
+{
+	bool stopped = false;
+	for (Renderer &r : renderers) {
+		r.mustCopyPlotter = true;
+		if (r.imageIndex < 0)
+			continue;
+		r.thread->stop();		// the image is dropped
+		imagesToRender.insert (r.imageIndex);
+		r.imageIndex = -1;
+		stopped = true;
+	}
+	if (stopped)
+		QTimer::singleShot(0, this, SLOT(renderNextImage()));
+}
+//---------------------------------------
+void GribAnimator::slotFrameReady()
+{
+	auto it = std::find_if (renderers.begin(), renderers.end(),
+				[this] (const Renderer &r) {return r.thread == sender();});
+	if (it == renderers.end())
+		return;
+	Renderer &r = *it;
+	QImage image;
+	Projection *p;
+	if (r.imageIndex < 0 || ! r.thread->takeFrame (&image, &p))
+		return;
+	delete p;
+	int index = r.imageIndex;
+	r.imageIndex = -1;
+	if (closestatus != 0 || !isCreatingImages)
 		return;
 
-	stackWidgets->setCurrentWidget(animCommand);
-	rewindAnim();
+	if (image.isNull()) {
+        QMessageBox::critical (nullptr,
+			tr("Error"),
+			tr("Need more memory."));
+		finishImages();
+		return;
+	}
+	// POIs are widgets: drawn here, in the GUI thread
+	if (! terre.isNull()) {
+		QPainter pnt (&image);
+		for (auto poi : terre->getListPOIs()) {
+            if (poi->isVisible()) {
+				poi->drawContent (pnt, proj, true);
+			}
+		}
+	}
+	AnimImage *img = new AnimImage();
+	assert(img);
+	img->date = dates[index];
+	img->pixmap = new QPixmap (QPixmap::fromImage (image));
+	vectorImages[index] = img;
+
+	// the images are played in order: the next missing one is awaited
+	unsigned int nbReady = nbReadyImages;
+	while (nbReadyImages < vectorImages.size() && vectorImages[nbReadyImages] != nullptr)
+		nbReadyImages ++;
+	if (nbReadyImages > nbReady) {
+		createAnimProgressBar->setCurrentValue (nbReadyImages);
+		if (nbReady == 0) {
+			animCommand->setEnabled(true);
+			showImage(0);
+		}
+		else if (waitingImage && currentImage < nbReadyImages) {
+			showImage(currentImage);
+			if (mustResumeAnim) {
+				mustResumeAnim = false;
+	 			timerLoop->start();
+			}
+		}
+	}
+	renderNextImage();
 }
  
 //=============================================================================
@@ -350,12 +481,12 @@ QFrame *GribAnimator::createFrameGui(QWidget *parent)
     lbimage = new QLabel();
     frameLayout->addWidget(lbimage);
 
-	// Pile : progressBar when computing images, command widget after
-	stackWidgets = new QStackedWidget(this);
-		createAnimProgressBar = new CreateAnimProgressBar(nbImages, this);
-		stackWidgets->addWidget(createAnimProgressBar);
-		stackWidgets->addWidget(animCommand);
-    frameLayout->addWidget(stackWidgets);
+	// Commands, usable as soon as the first image is drawn,
+	// and progressBar while computing the images
+    frameLayout->addWidget(animCommand);
+	animCommand->setEnabled(false);
+	createAnimProgressBar = new CreateAnimProgressBar(nbImages, this);
+    frameLayout->addWidget(createAnimProgressBar);
     
     lbmessage = new QLabel(tr("Making animation"));
     frameLayout->addWidget(lbmessage);
@@ -368,11 +499,16 @@ QFrame *GribAnimator::createFrameGui(QWidget *parent)
 GribAnimator::~GribAnimator()
 {
 // 	DBG ("destructor GribAnimator");
+	closestatus = 2;
+	for (Renderer &r : renderers) {
+		delete r.thread;	// stops the drawing
+		r.imageIndex = -1;
+	}
+	finishImages();
 	
 	Util::cleanVectorPointers (vectorImages);
 
     delete proj;
-    delete drawer;
 }
 
 //-------------------------------------------------------------------------------
@@ -389,15 +525,34 @@ GribAnimator::GribAnimator (Terrain *terre)
 	this->gribplot = terre->getGriddedPlotter();
 	
 	this->proj     = terre->getProjection()->clone();
-	this->drawer   = new MapDrawer (* terre->getDrawer());
-	this->lspois   = terre->getListPOIs();
+	this->drawer   = std::make_shared <MapDrawer> (* terre->getDrawer());
 
     W = proj->getW();
     H = proj->getH();
-	nbImages = gribplot->getListDates()->size();
+	dates.assign (gribplot->getListDates()->begin(), gribplot->getListDates()->end());
+	nbImages = dates.size();
 	
-	vectorImages.reserve (nbImages);
+	vectorImages.assign (nbImages, nullptr);	// by index of the date
+	for (int i=0; i<nbImages; i++) {
+		imagesToRender.insert (i);
+	}
+	nbReadyImages = 0;
 	currentImage = 0;
+	isCreatingImages = false;
+	waitingImage = false;
+	mustResumeAnim = false;
+	// half of the cores: the map drawing is itself parallel
+	int nbRenderers = qBound (1, QThread::idealThreadCount()/2, std::max(nbImages,1));
+	renderers.resize (nbRenderers);
+	for (Renderer &r : renderers) {
+		r.thread = new MapRenderThread ();
+		assert(r.thread);
+		r.plotter.reset (gribplot->createDrawingCopy());
+		r.imageIndex = -1;
+		r.isEarthMapValid = false;
+		r.mustCopyPlotter = false;
+		connect(r.thread, SIGNAL(frameReady()), this, SLOT(slotFrameReady()));
+	}
 	
 	speed = Util::getSetting("animSpeed", 200).toInt();
 	autoLoop = Util::getSetting("animAutoLoop", false).toBool();
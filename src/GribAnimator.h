@@ -27,15 +27,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QComboBox>
 #include <QPushButton>
 #include <QProgressBar>
-#include <QStackedWidget>
 #include <QAction>
 #include <QSlider>
+#include <QPointer>
 #include <vector>
+#include <set>
+#include <memory>
 
 #include "DialogBoxColumn.h"
 #include "Terrain.h"
 #include "Projection.h"
 #include "GribPlot.h"
+#include "MapRenderThread.h"
 #include "POI.h"
 
 //=====================================================================================
@@ -123,19 +126,44 @@ class GribAnimator : public QDialog
 		void rewindAnim();
 		void setAutoLoop(bool);
 		void timerPauseOut();
+		void renderNextImage();
+		void stopRendering();
+		void slotFrameReady();
 		    
     private:
 		int 		W, H;
-        MapDrawer 	*drawer;
-        GriddedPlotter 	*gribplot;
+        std::shared_ptr <const MapDrawer> drawer;	// settings of the terrain
+        GriddedPlotter 	*gribplot;			// plotter of the terrain
         Projection 	*proj;
-	    QList<POI*> lspois;
-		Terrain 	*terre;
+		QPointer<Terrain> terre;
 		
 		volatile int 	closestatus;		
         std::vector <AnimImage *> vectorImages;
-		void	createImages();
+        std::vector <time_t> dates;
         unsigned int		currentImage;
+
+		// The images are drawn by several threads, ahead of the animation
+		// in the order of the dates. Each one has its own drawer and its
+		// own copy of the plotter of the terrain: the settings and the
+		// date of the terrain are not modified.
+		// The animation may be played as soon as the first one is ready:
+		// it waits for the images which are not yet drawn.
+		struct Renderer {
+			MapRenderThread *thread;
+			std::shared_ptr <GriddedPlotter> plotter;	// drawing copy
+			int		imageIndex;			// image being drawn, -1 if none
+			bool	isEarthMapValid;
+			bool	mustCopyPlotter;	// the data of the file changed
+		};
+		std::vector <Renderer> renderers;
+		std::set <int> imagesToRender;	// indexes of the dates, in order
+		unsigned int nbReadyImages;		// the images before it are drawn
+		bool	isCreatingImages;
+		bool	waitingImage;		// the current image isn't drawn yet
+		bool	mustResumeAnim;		// play when it is ready
+		void	createImages();
+		void	finishImages();
+		void	renderImage (Renderer &renderer);
         int 	nbImages;
         int		speed;
         bool	autoLoop;
@@ -149,7 +177,6 @@ class GribAnimator : public QDialog
 
         QFrame 			*frameGui;
         QVBoxLayout 	*frameLayout;
-        QStackedWidget 	*stackWidgets;
         QTimer *timerLoop;
         QTimer *timerPause;
         QLabel *lbimage, *lbmessage;
@@ -39,12 +39,25 @@ GribPlot::GribPlot (const GribPlot &model)
 }
 //----------------------------------------------------
 GribPlot::~GribPlot() {
-    delete gribReader;
+	if (! isReaderShared)
+	    delete gribReader;
+}
+//----------------------------------------------------
+GriddedPlotter *GribPlot::createDrawingCopy () const
+{
+	GribPlot *plot = new GribPlot ();
+	assert (plot);
+	plot->gribReader = gribReader;
+	plot->isReaderShared = true;
+	plot->fileName = fileName;
+	plot->copyDrawingSettings (*this);
+	return plot;
 }
 //----------------------------------------------------
 void GribPlot::initNewGribPlot(bool interpolateValues, bool windArrowsOnGribGrid, bool currentArrowsOnGribGrid)
 {
     gribReader = nullptr;
+    isReaderShared = false;
     
 	this->mustInterpolateValues = interpolateValues;
 	this->drawWindArrowsOnGrid = windArrowsOnGribGrid;
@@ -77,8 +90,11 @@ void GribPlot::loadGrib (LongTaskProgress * taskProgress, int nbrecs)
 void GribPlot::loadFile (const QString &fileName, LongTaskProgress * taskProgress, int nbrecs)
 {
 	this->fileName = fileName;
-    delete gribReader;
+	clearIsolinesCache ();
+	if (! isReaderShared)
+	    delete gribReader;
 	gribReader = new GribReader ();
+	isReaderShared = false;
 	loadGrib(taskProgress, nbrecs);
 	if (isReaderOk())
 		return;
@@ -90,6 +106,7 @@ void GribPlot::duplicateFirstCumulativeRecord ( bool mustDuplicate )
 	mustDuplicateFirstCumulativeRecord = mustDuplicate;
     if (isReaderOk())
     {
+		clearIsolinesCache ();
 		if (mustDuplicate) {
 			gribReader->copyFirstCumulativeRecord ();
 		}
@@ -105,6 +122,7 @@ void GribPlot::duplicateMissingWaveRecords ( bool mustDuplicate )
 	mustDuplicateMissingWaveRecords = mustDuplicate;
     if (isReaderOk())
     {
+		clearIsolinesCache ();
 		if (mustDuplicate) {
 			gribReader->copyMissingWaveRecords ();
 		}
@@ -120,6 +138,7 @@ void GribPlot::interpolateMissingRecords ( bool mustInterpolate )
 	mustInterpolateMissingRecords = mustInterpolate;
     if (isReaderOk())
     {
+		clearIsolinesCache ();
 		if (mustInterpolate) {
 			gribReader->interpolateMissingRecords ();
 		}
@@ -161,21 +180,28 @@ void GribPlot::draw_GridPoints (const DataCode &dtc, QPainter &pnt, const Projec
 
 	int deltaI, deltaJ;
 	analyseVisibleGridDensity (proj, rec, 6, &deltaI, &deltaJ);
-	for (int j=0; j<rec->getNj(); j+=deltaJ) {
-    	for (int i=0; i<rec->getNi(); i+=deltaI) {
-            if (rec->hasValue(i,j))
-            {
-                double lon, lat;
-                int px,py;
-                rec->getXY(i, j, &lon , &lat);
-                proj->map2screen(lon, lat, &px,&py);
-                pnt.drawLine(px-dl,py, px+dl,py);
-                pnt.drawLine(px,py-dl, px,py+dl);
-                proj->map2screen(lon -360.0, lat, &px,&py);
-                pnt.drawLine(px-dl,py, px+dl,py);
-                pnt.drawLine(px,py-dl, px,py+dl);
-            }
-        }
+	// Only the visible points, on the same lattice as the whole grid
+	GridWindow win;
+	getVisibleGridWindow (proj, rec, dl, &win);
+	int j0 = (win.jmin+deltaJ-1)/deltaJ*deltaJ;
+	for (int j=j0; j<=win.jmax; j+=deltaJ) {
+		for (auto &cols : win.columns) {
+			int i0 = (cols.first+deltaI-1)/deltaI*deltaI;
+			for (int i=i0; i<=cols.second; i+=deltaI) {
+				if (rec->hasValue(i,j))
+				{
+					double lon, lat;
+					int px,py;
+					rec->getXY(i, j, &lon , &lat);
+					proj->map2screen(lon, lat, &px,&py);
+					pnt.drawLine(px-dl,py, px+dl,py);
+					pnt.drawLine(px,py-dl, px,py+dl);
+					proj->map2screen(lon -360.0, lat, &px,&py);
+					pnt.drawLine(px-dl,py, px+dl,py);
+					pnt.drawLine(px,py-dl, px,py+dl);
+				}
+			}
+		}
 	}
 }
 
@@ -191,7 +217,7 @@ void GribPlot::draw_WIND_Arrows (
     if (!isReaderOk()) {
         return;
     }
-	windAltitude = altitude;
+	setWindAltitude (altitude);
     windArrowColor = arrowsColor;
     GribRecord *recx = gribReader->getRecord
 								(DataCode(GRB_WIND_VX,altitude),currentDate);
@@ -226,7 +252,7 @@ void GribPlot::draw_WIND_Arrows (
                     vy = -co;
             	}
                 if (barbules)
-                    drawWindArrowWithBarbs(pnt, i,j, vx,vy, (lat<0), arrowsColor);
+                    drawWindBarbs(pnt, i,j, vx,vy, (lat<0), arrowsColor);
                 else
                     drawWindArrow(pnt, i,j, vx,vy);
 			}
@@ -238,35 +264,42 @@ void GribPlot::draw_WIND_Arrows (
 	    space =  drawWindArrowsOnGrid ? windBarbuleSpaceOnGrid : windBarbuleSpace;
     else
 	    space =  drawWindArrowsOnGrid ? windArrowSpaceOnGrid : windArrowSpace;
+	space = getArrowsSpacing (space);
 
 	bool draw_on_grid = drawWindArrowsOnGrid;
 	if (draw_on_grid && ! analyseVisibleGridDensity(proj, recx, space/2)) {
 		draw_on_grid = false;
-	    space =  barbules ? windBarbuleSpace:windArrowSpace;
+	    space =  getArrowsSpacing (barbules ? windBarbuleSpace:windArrowSpace);
 	}
     
     int W = proj->getW();
     int H = proj->getH();
     if (draw_on_grid)
-    {	// Flèches uniquement sur les points de la grille
-		for (int gj=0; gj<recx->getNj(); gj++) {
-			for (int gi=0; gi<recx->getNi(); gi++) {
-				recx->getXY(gi, gj, &lon, &lat);
-                if (! recx->isXInMap(lon))
-                    lon += 360.0;   // tour du monde ?
-
-				proj->map2screen(lon, lat, &i,&j);
-				if (i > W)
-					proj->map2screen(lon-360, lat, &i,&j);
-
-				draw_wind_arrow();
+    {	// Flèches uniquement sur les points visibles de la grille
+		GridWindow win;
+		getVisibleGridWindow (proj, recx, space, &win);
+		for (int gj=win.jmin; gj<=win.jmax; gj++) {
+			for (auto &cols : win.columns) {
+				for (int gi=cols.first; gi<=cols.second; gi++) {
+					recx->getXY(gi, gj, &lon, &lat);
+					if (! recx->isXInMap(lon))
+						lon += 360.0;   // tour du monde ?
+
+					proj->map2screen(lon, lat, &i,&j);
+					if (i > W)
+						proj->map2screen(lon-360, lat, &i,&j);
+
+					draw_wind_arrow();
+				}
 			}
-    	}
+		}
     }
     else
     {	// Flèches uniformément réparties sur l'écran
-		for (j= 0; j<H; j+=space) {
-			for (i= 0; i< W; i+=space) {
+		double ox, oy;
+		proj->getScreenOrigin (&ox, &oy);
+		for (j=getLatticeStart(oy,space,space); j<H+space; j+=space) {
+			for (i=getLatticeStart(ox,space,space); i<W+space; i+=space) {
 				proj->screen2map(i,j, &lon,&lat);
 				if (! recx->isXInMap(lon))
 					lon += 360.0;   // tour du monde ?
@@ -289,7 +322,7 @@ void GribPlot::draw_CURRENT_Arrows (
     if (!isReaderOk()) {
         return;
     }
-	currentAltitude = altitude;
+	setCurrentAltitude (altitude);
     currentArrowColor = arrowsColor;
 
     GribRecord *recx = gribReader->getRecord
@@ -312,7 +345,7 @@ void GribPlot::draw_CURRENT_Arrows (
     double lon, lat;
 
 	bool draw_on_grid = drawCurrentArrowsOnGrid;
-	if (draw_on_grid && ! analyseVisibleGridDensity(proj, recx, currentArrowSpaceOnGrid/2)) {
+	if (draw_on_grid && ! analyseVisibleGridDensity(proj, recx, getArrowsSpacing(currentArrowSpaceOnGrid)/2)) {
 		draw_on_grid = false;
 	}
 
@@ -335,26 +368,32 @@ void GribPlot::draw_CURRENT_Arrows (
     int W = proj->getW();
     int H = proj->getH();
     if (draw_on_grid)
-    {	// Flèches uniquement sur les points de la grille
-		for (int gj=0; gj<recx->getNj(); gj++) {
-			for (int gi=0; gi<recx->getNi(); gi++) {
-				recx->getXY(gi, gj, &lon, &lat);
-				if (! recx->isXInMap(lon))
-					lon += 360.0;   // tour du monde ?
-
-				proj->map2screen(lon,lat, &i,&j);
-				if (i > W)
-					proj->map2screen(lon-360, lat, &i,&j);
-
-				draw_current_arrow();
+    {	// Flèches uniquement sur les points visibles de la grille
+		GridWindow win;
+		getVisibleGridWindow (proj, recx, getArrowsSpacing(currentArrowSpaceOnGrid), &win);
+		for (int gj=win.jmin; gj<=win.jmax; gj++) {
+			for (auto &cols : win.columns) {
+				for (int gi=cols.first; gi<=cols.second; gi++) {
+					recx->getXY(gi, gj, &lon, &lat);
+					if (! recx->isXInMap(lon))
+						lon += 360.0;   // tour du monde ?
+
+					proj->map2screen(lon,lat, &i,&j);
+					if (i > W)
+						proj->map2screen(lon-360, lat, &i,&j);
+
+					draw_current_arrow();
+				}
 			}
-    	}
+		}
     }
     else 
     {	// Flèches uniformément réparties sur l'écran
-    	int space = currentArrowSpace;
-		for (j=0; j<H; j+=space) {
-			for (i=0; i<W; i+=space) {
+    	int space = getArrowsSpacing (currentArrowSpace);
+		double ox, oy;
+		proj->getScreenOrigin (&ox, &oy);
+		for (j=getLatticeStart(oy,space,space); j<H+space; j+=space) {
+			for (i=getLatticeStart(ox,space,space); i<W+space; i+=space) {
 				proj->screen2map(i,j, &lon, &lat);
 				if (! recx->isXInMap(lon))
 					lon += 360.0;   // tour du monde ?
@@ -386,14 +425,14 @@ void GribPlot::draw_ColoredMapPlain (
 	
 	switch (dtc.dataType) {
 		case GRB_PRV_WIND_XY2D :
-			windAltitude = dtc.getAltitude ();
+			setWindAltitude (dtc.getAltitude ());
 			drawColorMapGeneric_2D (pnt,proj,smooth, 
 							DataCode (GRB_WIND_VX, dtc.levelType,dtc.levelValue),
 							DataCode (GRB_WIND_VY, dtc.levelType,dtc.levelValue),
 							DataColors::function_getColor );
 			break;
 		case GRB_PRV_CUR_XY2D :
-			currentAltitude = dtc.getAltitude ();
+			setCurrentAltitude (dtc.getAltitude ());
 			drawColorMapGeneric_2D (pnt,proj,smooth, 
 							DataCode (GRB_CUR_VX, dtc.levelType,dtc.levelValue),
 							DataCode (GRB_CUR_VY, dtc.levelType,dtc.levelValue),
@@ -519,31 +558,37 @@ void GribPlot::draw_WAVES_Arrows (
     int H = proj->getH();
 
 	bool draw_on_grid = drawWindArrowsOnGrid;
-	if (draw_on_grid && !analyseVisibleGridDensity(proj, recDir, currentArrowSpaceOnGrid/2)) {
+	if (draw_on_grid && !analyseVisibleGridDensity(proj, recDir, getArrowsSpacing(currentArrowSpaceOnGrid)/2)) {
 		draw_on_grid = false;
 	}
     
     if (draw_on_grid)
-    {	// Flèches uniquement sur les points de la grille
-		for (int gj=0; gj<recDir->getNj(); gj++) {
-			for (int gi=0; gi<recDir->getNi(); gi++) {
-				recDir->getXY(gi, gj, &lon, &lat);
-				if (! recDir->isXInMap(lon))
-					lon += 360.0;   // tour du monde ?
-
-				proj->map2screen(lon, lat, &i,&j);
-				if (i > W)
-					proj->map2screen(lon-360, lat, &i,&j);
-
-				draw_wave_arrow();
+    {	// Flèches uniquement sur les points visibles de la grille
+		GridWindow win;
+		getVisibleGridWindow (proj, recDir, getArrowsSpacing(currentArrowSpaceOnGrid), &win);
+		for (int gj=win.jmin; gj<=win.jmax; gj++) {
+			for (auto &cols : win.columns) {
+				for (int gi=cols.first; gi<=cols.second; gi++) {
+					recDir->getXY(gi, gj, &lon, &lat);
+					if (! recDir->isXInMap(lon))
+						lon += 360.0;   // tour du monde ?
+
+					proj->map2screen(lon, lat, &i,&j);
+					if (i > W)
+						proj->map2screen(lon-360, lat, &i,&j);
+
+					draw_wave_arrow();
+				}
 			}
-    	}
+		}
     }
     else
     {	// Flèches uniformément réparties sur l'écran
-    	int space = currentArrowSpace;
-		for (j=0; j<H; j+=space) {
-			for (i=0; i<W; i+=space) {
+    	int space = getArrowsSpacing (currentArrowSpace);
+		double ox, oy;
+		proj->getScreenOrigin (&ox, &oy);
+		for (j=getLatticeStart(oy,space,space); j<H+space; j+=space) {
+			for (i=getLatticeStart(ox,space,space); i<W+space; i+=space) {
 				proj->screen2map(i,j, &lon, &lat);
 				if (!recDir->isXInMap(lon))
 					lon += 360.0;   // tour du monde ?
@@ -46,6 +46,8 @@ class GribPlot : public RegularGridPlot
 
 		virtual void  setCurrentDate (time_t t);
 
+		virtual GriddedPlotter *createDrawingCopy () const;
+
 		virtual bool  isReaderOk() const  
 						{return gribReader!=nullptr && gribReader->isOk();}
 
@@ -91,6 +93,7 @@ class GribPlot : public RegularGridPlot
 						bool currentArrowsOnGribGrid=true );
         
 		GribReader 	*gribReader;        
+		bool        isReaderShared;     // drawing copy: reader of the model
         QString 	fileName;
 };
 
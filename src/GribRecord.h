@@ -112,6 +112,8 @@ class GribRecord : public RegularGridRecord
         virtual void lonLat2XY(double lon, double lat, double *x, double *y) const override {
                 grid->lonLat2XY(lon, lat, *x, *y);
             }
+        bool isLonLatAligned () const override
+						{ return ok && grid && grid->isLonLatAligned(); }
 
         // Valeur pour un point de la grille
         data_t getValue (int i, int j) const 
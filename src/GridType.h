@@ -16,6 +16,10 @@ public:
 
     virtual double rotGrid2Earth(int x, int y) const = 0;
 
+    // Columns along the meridians and rows along the parallels:
+    // x depends only on lon and y only on lat, both monotonic.
+    virtual bool isLonLatAligned() const { return false; }
+
 protected:
     double rescale_lon(double lon) const {
         double new_lon = lon;
@@ -57,6 +61,8 @@ public:
 
     double rotGrid2Earth(int x, int y) const override { return 0.;}
 
+    bool isLonLatAligned() const override { return true; }
+
 private:
     int Nx{0};
     int Ny{0};
@@ -99,6 +105,8 @@ public:
 
     double rotGrid2Earth(int x, int y) const override { return 0.;}
 
+    bool isLonLatAligned() const override { return true; }
+
 private:
     int Nx{0};
     int Ny{0};
@@ -16,8 +16,11 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 
+#include <algorithm>
+
 #include "GriddedPlotter.h"
 #include "DataQString.h"
+#include "Font.h"
 
 /* Longueur de fleche courant */
 #define LF_MINC_A	3.
@@ -41,6 +44,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 GriddedPlotter::GriddedPlotter ()
 {
 	fastInterpolation = true;
+	interactiveRendering = false;
+	colorMapStep = 0;
 	windAltitude = Altitude (LV_TYPE_NOT_DEFINED,0);
 	
     windArrowSpace = 28;      // distance mini entre flèches
@@ -65,6 +70,7 @@ GriddedPlotter::GriddedPlotter ()
 GriddedPlotter::~GriddedPlotter ()
 {
 	listDates.clear();
+	clearIsolinesCache ();
 }
 //---------------------------------------------------
 void GriddedPlotter::setUseGustColorAbsolute (bool b)
@@ -81,6 +87,28 @@ void GriddedPlotter::updateGraphicsParameters ()
 	setCloudsColorMode ("cloudsColorMode");	
     thinWindArrows = Util::getSetting("thinWindArrows", false).toBool();
 }
+//---------------------------------------------------
+// Dates and settings of the drawings (see createDrawingCopy)
+void GriddedPlotter::copyDrawingSettings (const GriddedPlotter &model)
+{
+	listDates = model.listDates;
+	currentDate = model.currentDate;
+	mustInterpolateValues = model.mustInterpolateValues;
+	fastInterpolation = model.fastInterpolation;
+	drawWindArrowsOnGrid = model.drawWindArrowsOnGrid;
+	drawCurrentArrowsOnGrid = model.drawCurrentArrowsOnGrid;
+	mustDuplicateFirstCumulativeRecord = model.mustDuplicateFirstCumulativeRecord;
+	mustInterpolateMissingRecords = model.mustInterpolateMissingRecords;
+	mustDuplicateMissingWaveRecords = model.mustDuplicateMissingWaveRecords;
+	thinWindArrows = model.thinWindArrows;
+	isCloudsColorModeWhite = model.isCloudsColorModeWhite;
+	useJetStreamColorMap = model.useJetStreamColorMap;
+	if (useGustColorAbsolute != model.useGustColorAbsolute)
+		setUseGustColorAbsolute (model.useGustColorAbsolute);
+	QMutexLocker lock (&model.altitudeMutex);
+	windAltitude = model.windAltitude;
+	currentAltitude = model.currentAltitude;
+}
 
 //==================================================================================
 // Flèches de direction du vent
@@ -124,20 +152,34 @@ void GriddedPlotter::drawTransformedLine( QPainter &pnt,
 void GriddedPlotter::drawWaveArrow (QPainter &pnt,
             int i, int j, double dir)
 {
-    double ang = (dir-90)/180.0*M_PI;
-    QPen pen (QColor(255,0,255)); // color fuchsia
-    pen.setWidth (1);
-    pnt.setPen (pen);
-    // Flèche centrée sur l'origine
-    drawTransformedLine(pnt, ang, i, j, windArrowSize, 5, 2);
+    int k = ArrowsAtlas::directionIndex ((dir-90)/180.0*M_PI);
+    waveArrowsAtlas.draw (pnt, i, j, k, [&] (QPainter &p, int ci, int cj) {
+        QPen pen (QColor(255,0,255)); // color fuchsia
+        pen.setWidth (1);
+        p.setPen (pen);
+        // Flèche centrée sur l'origine
+        drawTransformedLine(p, ArrowsAtlas::directionAngle(k), ci, cj, windArrowSize, 5, 2);
+    });
 }
 //-----------------------------------------------------------------------------
 void GriddedPlotter::drawCurrentArrow (QPainter &pnt, int i, int j, double cx, double cy)
 {
     double vkn = sqrt(cx*cx+cy*cy)*3.6/1.852;
 	// double ang = atan2(cy, -cx)-M_PI;  // unlike wind, arrows follows the current
-    double ang = atan2(cy, -cx);  // unlike wind, arrows follows the current
-    
+    int k = ArrowsAtlas::directionIndex (atan2(cy, -cx));  // unlike wind, arrows follows the current
+    // speed classes: 0.05 kn below 0.5 kn, 0.25 kn up to 10 kn (constant size above)
+    vkn = std::min (vkn, QF_MAXC);
+    int speed = (vkn < 0.5) ? (int) std::lround (vkn*20)
+                            : 10 + (int) std::lround ((vkn-0.5)*4);
+    quint64 key = ((quint64) speed << 8) | k;
+    currentArrowsAtlas.draw (pnt, i, j, key, [&] (QPainter &p, int ci, int cj) {
+        double v = (speed <= 10) ? speed/20.0 : 0.5 + (speed-10)/4.0;
+        drawCurrentArrowShape (p, ci, cj, v, ArrowsAtlas::directionAngle(k));
+    });
+}
+//-----------------------------------------------------------------------------
+void GriddedPlotter::drawCurrentArrowShape (QPainter &pnt, int i, int j, double vkn, double ang)
+{
     double tf_a = (TF_MAXC_A - TF_MINC_A) / (TF_MAXC - TF_MINC);
     double tf_b = TF_MAXC_A-TF_MAXC*tf_a;
     double qf_a = (QF_MAXC_A - QF_MINC_A) / (QF_MAXC - QF_MINC);
@@ -207,15 +249,48 @@ void GriddedPlotter::drawCurrentArrow (
 //-----------------------------------------------------------------------------
 void GriddedPlotter::drawWindArrow (QPainter &pnt, int i, int j, double vx, double vy)
 {
-    double ang = atan2(vy, -vx);
-    QPen pen (windArrowColor);
-	if (thinWindArrows)
-		pen.setWidth (1);
-	else
-		pen.setWidth (2);
-    pnt.setPen (pen);
-    // Flèche centrée sur l'origine
-    drawTransformedLine(pnt, ang, i, j, windArrowSize, 5, 2);
+    int k = ArrowsAtlas::directionIndex (atan2(vy, -vx));
+    quint64 key = ((quint64) windArrowColor.rgba() << 32) | (thinWindArrows << 8) | k;
+    windArrowsAtlas.draw (pnt, i, j, key, [&] (QPainter &p, int ci, int cj) {
+        QPen pen (windArrowColor);
+        if (thinWindArrows)
+            pen.setWidth (1);
+        else
+            pen.setWidth (2);
+        p.setPen (pen);
+        // Flèche centrée sur l'origine
+        drawTransformedLine(p, ArrowsAtlas::directionAngle(k), ci, cj, windArrowSize, 5, 2);
+    });
+}
+//-----------------------------------------------------------------------------
+// Class of the drawing of the barbs (speed in knots)
+static int getBarbsSpeedClass (double vkn)
+{
+    static const double limits[] = {1, 7.5, 12.5, 17.5, 22.5, 27.5, 32.5,
+                                    37.5, 45, 55, 65, 75, 85};
+    int n = 0;
+    for (double limit : limits)
+        if (vkn >= limit)
+            n ++;
+    return n;
+}
+//-----------------------------------------------------------------------------
+void GriddedPlotter::drawWindBarbs (QPainter &pnt, int i, int j, double vx, double vy,
+                                    bool south, const QColor &arrowColor)
+{
+	if (! GribDataIsDef(vx) || ! GribDataIsDef(vy))
+		return;
+    double v = sqrt(vx*vx+vy*vy);
+    int k = ArrowsAtlas::directionIndex (atan2(vy, -vx));
+    int speed = getBarbsSpeedClass (v*3.6/1.852);
+    quint64 key = ((quint64) arrowColor.rgba() << 32) | (1 << 16)
+                    | (south << 15) | (thinWindArrows << 14) | (speed << 8) | k;
+    windArrowsAtlas.draw (pnt, i, j, key, [&] (QPainter &p, int ci, int cj) {
+        // same speed class, direction of the atlas
+        double ang = ArrowsAtlas::directionAngle (k);
+        drawWindArrowWithBarbs_static (p, ci, cj, -v*cos(ang), v*sin(ang),
+                    south, arrowColor, windBarbuleSize, thinWindArrows);
+    });
 }
 //-----------------------------------------------------------------------------
 void GriddedPlotter::drawWindArrowWithBarbs (
@@ -400,6 +475,289 @@ void GriddedPlotter::draw_CoveredZone
 //==========================================================================
 // draw colored map
 
+//--------------------------------------------------------------------------
+// Blocks (a, k) of the screen grid to draw: the whole grid, or only
+// the parts of the clip region when a part of the map is redrawn.
+//--------------------------------------------------------------------------
+QVector <QRect> GriddedPlotter::getColorMapBlocks (const QPainter &pnt,
+												const ScreenMapGrid &grid)
+{
+	QVector <QRect> blocks;
+	int step = grid.getStep();
+	QRect all (0, 0, grid.getNx(), grid.getNy());
+	if (! pnt.hasClipping()) {
+		blocks.push_back (all);
+		return blocks;
+	}
+	for (const QRect &r : pnt.clipRegion()) {
+		QRect b = QRect (QPoint (r.left()/step, r.top()/step),
+						 QPoint (r.right()/step, r.bottom()/step)).intersected (all);
+		if (! b.isEmpty())
+			blocks.push_back (b);
+	}
+	return blocks;
+}
+//--------------------------------------------------------------------------
+// Color of the block of step*step pixels at (i, j).
+// The blocks of the screen grid are always inside the image.
+//--------------------------------------------------------------------------
+void GriddedPlotter::fillColorMapBlock (QImage *image, int i, int j, int step, QRgb rgb)
+{
+	for (int y=j; y<j+step; y++) {
+		QRgb *line = reinterpret_cast<QRgb *> (image->scanLine (y));
+		for (int x=i; x<i+step; x++)
+			line [x] = rgb;
+	}
+}
+//--------------------------------------------------------------------------
+// Color maps drawn in the space of the grid.
+// When the grid is coarser than the blocks of the screen, the grid
+// points are colored once (one texel per point), then the colors are
+// resampled to the blocks. The position in the grid of each block
+// (mesh warp from the grid to the screen) is kept while the projection
+// and the geometry of the grid don't change.
+//--------------------------------------------------------------------------
+namespace {
+struct GridGeometry
+{
+	int    ni, nj;
+	double xmin, xmax, ymin, ymax, dx, dy;
+	bool   entireWorld;
+	
+	GridGeometry (const GriddedRecord *rec)
+		: ni (rec->getNi()), nj (rec->getNj()),
+		  xmin (rec->getXmin()), xmax (rec->getXmax()),
+		  ymin (rec->getYmin()), ymax (rec->getYmax()),
+		  dx (rec->getDeltaX()), dy (rec->getDeltaY()),
+		  entireWorld (rec->entireWorldInLongitude)
+		{}
+	bool operator== (const GridGeometry &g) const
+		{ return ni==g.ni && nj==g.nj && xmin==g.xmin && xmax==g.xmax
+				&& ymin==g.ymin && ymax==g.ymax && dx==g.dx && dy==g.dy
+				&& entireWorld==g.entireWorld; }
+};
+}
+//--------------------------------------------------------------------------
+struct GriddedPlotter::ColorMapWarp
+{
+	ColorMapWarp (const std::shared_ptr <const ScreenMapGrid> &grid,
+				  const GridGeometry &geometry)
+		: screenGrid (grid), geometry (geometry)
+		{}
+	std::shared_ptr <const ScreenMapGrid> screenGrid;
+	GridGeometry geometry;
+	std::vector <double> gx, gy;	// position of the blocks (NAN: outside)
+};
+//--------------------------------------------------------------------------
+std::shared_ptr <const GriddedPlotter::ColorMapWarp> GriddedPlotter::getColorMapWarp (
+				const std::shared_ptr <const ScreenMapGrid> &grid,
+				const GriddedRecord *rec)
+{
+	GridGeometry geometry (rec);
+	QMutexLocker lock (&colorMapWarpMutex);
+	for (auto it=colorMapWarps.begin(); it!=colorMapWarps.end(); ++it) {
+		if ((*it)->screenGrid == grid && (*it)->geometry == geometry) {
+			colorMapWarps.splice (colorMapWarps.begin(), colorMapWarps, it);
+			return colorMapWarps.front();
+		}
+	}
+	
+	auto warp = std::make_shared <ColorMapWarp> (grid, geometry);
+	int nx = grid->getNx();
+	int ny = grid->getNy();
+	warp->gx.resize (nx*ny);
+	warp->gy.resize (nx*ny);
+	for (int a=0; a<nx; a++) {
+		const double *vlon = grid->getColumnLon (a);
+		const double *vlat = grid->getColumnLat (a);
+		for (int k=0; k<ny; k++) {
+			double lon = vlon[k];
+			double lat = vlat[k];
+			double pi, pj;
+			bool zero;
+			if (! rec->isXInMap(lon))
+				lon += 360.0;    // tour complet ?
+			if (! rec->isPointInMap(lon, lat)
+					|| ! rec->getGridPosition (lon, lat, &pi, &pj, &zero))
+				pi = pj = NAN;
+			warp->gx [a*ny+k] = pi;
+			warp->gy [a*ny+k] = pj;
+		}
+	}
+	colorMapWarps.push_front (warp);
+	while (colorMapWarps.size() > 4)		// previews and final map
+		colorMapWarps.pop_back ();
+	return warp;
+}
+//--------------------------------------------------------------------------
+// Colors of the grid points of a window of the grid: the columns of
+// the window are packed side by side, from the row jmin.
+//--------------------------------------------------------------------------
+struct GridTexels {
+	QImage texels;
+	std::vector <char> defined;
+	std::vector <int> columns;	// position in texels of each grid column (or -1)
+	int ni, jmin;
+};
+//--------------------------------------------------------------------------
+// Color at the position (pi, pj) of the grid, from the colors of the
+// grid points (same rules as getInterpolatedValueUsingRegularGrid).
+//--------------------------------------------------------------------------
+static bool getGridColor (const GridTexels &tex,
+						  bool entireWorld, double pi, double pj,
+						  bool interpolate, QRgb *rgb)
+{
+	double const eps = 1e-4;
+	int ni = tex.ni;
+	int nw = tex.texels.width();
+	int nh = tex.texels.height();
+	int i0 = (int) floor (pi);
+	int j0 = (int) floor (pj);
+	int i1 = (i0+1 >= ni && entireWorld) ? 0 : i0+1;
+	int j1 = j0+1;
+	auto isDef = [&] (int i, int j) {
+		return i>=0 && i<ni && j>=tex.jmin && j<tex.jmin+nh && tex.columns [i] >= 0
+				&& tex.defined [(j-tex.jmin)*nw + tex.columns [i]];
+	};
+	auto color = [&] (int i, int j) {
+		return reinterpret_cast <const QRgb *> (tex.texels.constScanLine (j-tex.jmin)) [tex.columns [i]];
+	};
+	// very close to a grid point ?
+	double dx = pi-i0;
+	double dy = pj-j0;
+	int ii = (dx<eps) ? i0 : ((1-dx)<eps) ? i1 : -1;
+	int jj = (dy<eps) ? j0 : ((1-dy)<eps) ? j1 : -1;
+	if (ii>=0 && jj>=0) {
+		if (! isDef (ii,jj))
+			return false;
+		*rgb = color (ii,jj);
+		return true;
+	}
+	bool h00 = isDef (i0,j0);
+	bool h10 = isDef (i1,j0);
+	bool h01 = isDef (i0,j1);
+	bool h11 = isDef (i1,j1);
+	int nbval = h00 + h10 + h01 + h11;
+	if (nbval < 3)
+		return false;
+	
+	if (! interpolate) {
+		int i = (dx < 0.5) ? i0 : i1;
+		int j = (dy < 0.5) ? j0 : j1;
+		if (! isDef (i,j))
+			return false;
+		*rgb = color (i,j);
+		return true;
+	}
+	dx = (3.0 - 2.0*dx)*dx*dx;   // pseudo hermite interpolation
+	dy = (3.0 - 2.0*dy)*dy*dy;
+	if (nbval == 3) {
+		// triangle of the 3 points: distance to the corner
+		// opposite to the missing one
+		double k = !h00 ? (1-dx)+(1-dy) : !h01 ? dx+(1-dy)
+				 : !h10 ? (1-dx)+dy : dx+dy;
+		if (k > 1)
+			return false;
+	}
+	double w00 = h00 ? (1-dx)*(1-dy) : 0;
+	double w10 = h10 ? dx*(1-dy) : 0;
+	double w01 = h01 ? (1-dx)*dy : 0;
+	double w11 = h11 ? dx*dy : 0;
+	double sum = w00 + w10 + w01 + w11;
+	if (sum <= 0)
+		return false;
+	QRgb c00 = h00 ? color (i0,j0) : 0;
+	QRgb c10 = h10 ? color (i1,j0) : 0;
+	QRgb c01 = h01 ? color (i0,j1) : 0;
+	QRgb c11 = h11 ? color (i1,j1) : 0;
+	QRgb res = 0;
+	for (int shift : {0, 8, 16, 24}) {
+		double v = w00*((c00>>shift)&0xff) + w10*((c10>>shift)&0xff)
+				 + w01*((c01>>shift)&0xff) + w11*((c11>>shift)&0xff);
+		res |= (QRgb) qBound (0, qRound (v/sum), 255) << shift;
+	}
+	*rgb = res;
+	return true;
+}
+//--------------------------------------------------------------------------
+bool GriddedPlotter::drawColorMapOnGrid (
+		QPainter &pnt, const Projection *proj, bool smooth,
+		const std::vector <GriddedRecord *> &recs,
+		const std::function <double (int i, int j)> &getValue,
+		QRgb (DataColors::*function_getColor) (double v, bool smooth)
+	)
+{
+	// the colors of the grid points can't be interpolated across
+	// the steps of the color scale
+	if (! smooth && mustInterpolateValues)
+		return false;
+	GriddedRecord *rec = recs[0];
+	for (GriddedRecord *r : recs) {
+		if (! r->isRegularGrid() || !(GridGeometry(r) == GridGeometry(rec)))
+			return false;
+	}
+	int ni = rec->getNi();
+	int nj = rec->getNj();
+	int step = getColorMapStep ();
+	if (ni < 2 || nj < 2 || ! analyseVisibleGridDensity (proj, rec, step))
+		return false;		// grid finer than the blocks
+	
+	// colors of the grid points, only in the visible part of the grid
+	// (a tile or a zoomed map uses a small part of a large grid)
+	GridWindow win;
+	getVisibleGridWindow (proj, rec, 2*step, &win);
+	if (win.jmax < win.jmin || win.columns.empty())
+		return true;		// grid out of the map
+	GridTexels tex;
+	tex.ni = ni;
+	tex.jmin = win.jmin;
+	tex.columns.assign (ni, -1);
+	int nw = 0;
+	for (auto &cols : win.columns) {
+		for (int i=cols.first; i<=cols.second; i++)
+			tex.columns [i] = nw++;
+	}
+	int nh = win.jmax-win.jmin+1;
+	tex.texels = QImage (nw, nh, QImage::Format_ARGB32);
+	tex.defined.resize (nw*nh);
+	for (int j=win.jmin; j<=win.jmax; j++) {
+		QRgb *line = reinterpret_cast<QRgb *> (tex.texels.scanLine (j-win.jmin));
+		char *def = &tex.defined [(j-win.jmin)*nw];
+		for (auto &cols : win.columns) {
+			for (int i=cols.first; i<=cols.second; i++) {
+				double v = getValue (i,j);
+				int k = tex.columns [i];
+				def [k] = GribDataIsDef(v);
+				line [k] = GribDataIsDef(v) ? (this->*function_getColor) (v, smooth) : 0;
+			}
+		}
+	}
+	// resampled to the blocks of the screen
+    int W = proj->getW();
+    int H = proj->getH();
+    QImage *image = new QImage(W,H,QImage::Format_ARGB32);
+    image->fill( qRgba(0,0,0,0));
+    std::shared_ptr <const ScreenMapGrid> grid = ScreenMapGrid::get (proj, step);
+    std::shared_ptr <const ColorMapWarp> warp = getColorMapWarp (grid, rec);
+    int ny = grid->getNy();
+    QRgb rgb;
+    for (const QRect &r : getColorMapBlocks (pnt, *grid)) {
+        for (int a=r.left(); a<=r.right(); a++) {
+            const double *gx = &warp->gx [a*ny];
+            const double *gy = &warp->gy [a*ny];
+            for (int k=r.top(); k<=r.bottom(); k++)
+            {
+                if (! std::isnan (gx[k])
+                		&& getGridColor (tex, rec->entireWorldInLongitude,
+                						 gx[k], gy[k], mustInterpolateValues, &rgb))
+                    fillColorMapBlock (image, step*a, step*k, step, rgb);
+            }
+        }
+    }
+	pnt.drawImage(0,0,*image);
+    delete image;
+    return true;
+}
 //--------------------------------------------------------------------------
 // Carte de couleurs générique en dimension 1
 //--------------------------------------------------------------------------
@@ -414,6 +772,10 @@ void  GriddedPlotter::drawColorMapGeneric_1D (
 	GriddedRecord *rec = getReader()->getRecord (dtc, currentDate);
     if (rec == nullptr)
         return;
+    if (drawColorMapOnGrid (pnt, proj, smooth, {rec},
+    		[rec] (int i, int j) {return rec->getValueOnRegularGrid (i,j);},
+    		function_getColor))
+        return;
     int i, j;
     double lon, lat, v;
     int W = proj->getW();
@@ -421,22 +783,30 @@ void  GriddedPlotter::drawColorMapGeneric_1D (
     QRgb   rgb;
     QImage *image = new QImage(W,H,QImage::Format_ARGB32);
     image->fill( qRgba(0,0,0,0));
-    for (i=0; i<W-1; i+=2) {
-        for (j=0; j<H-1; j+=2)
-        {
-            proj->screen2map(i,j, &lon, &lat);
-            if (! rec->isXInMap(lon))
-                lon += 360.0;    // tour complet ?
-            if (rec->isPointInMap(lon, lat))
+    // geographic coordinates of the pixels (i, j) (multiples of step)
+    int step = getColorMapStep ();
+    std::shared_ptr <const ScreenMapGrid> grid = ScreenMapGrid::get (proj, step);
+    // only the blocks inside the clip region of the painter
+    for (const QRect &r : getColorMapBlocks (pnt, *grid)) {
+        for (int a=r.left(); a<=r.right(); a++) {
+            i = step*a;
+            const double *vlon = grid->getColumnLon (a);
+            const double *vlat = grid->getColumnLat (a);
+            for (int k=r.top(); k<=r.bottom(); k++)
             {
-                v = rec->getInterpolatedValue (lon, lat, mustInterpolateValues);
-                if (GribDataIsDef(v))
+                j = step*k;
+                lon = vlon[k];
+                lat = vlat[k];
+                if (! rec->isXInMap(lon))
+                    lon += 360.0;    // tour complet ?
+                if (rec->isPointInMap(lon, lat))
                 {
-                    rgb = (this->*function_getColor) (v, smooth);
-                    image->setPixel(i,  j, rgb);
-                    image->setPixel(i+1,j, rgb);
-                    image->setPixel(i,  j+1, rgb);
-                    image->setPixel(i+1,j+1, rgb);
+                    v = rec->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                    if (GribDataIsDef(v))
+                    {
+                        rgb = (this->*function_getColor) (v, smooth);
+                        fillColorMapBlock (image, i, j, step, rgb);
+                    }
                 }
             }
         }
@@ -459,6 +829,15 @@ void  GriddedPlotter::drawColorMapGeneric_2D (
 	GriddedRecord *recY = getReader()->getRecord (dtcY, currentDate);
     if (recX == nullptr || recY == nullptr)
         return;
+    if (drawColorMapOnGrid (pnt, proj, smooth, {recX, recY},
+    		[recX, recY] (int i, int j) {
+    			double vx = recX->getValueOnRegularGrid (i,j);
+    			double vy = recY->getValueOnRegularGrid (i,j);
+    			return (GribDataIsDef(vx) && GribDataIsDef(vy)) ?
+    						sqrt(vx*vx+vy*vy) : GRIB_NOTDEF;
+    		},
+    		function_getColor))
+        return;
     int i, j;
     double lon, lat, vx, vy, v;
     int W = proj->getW();
@@ -466,26 +845,34 @@ void  GriddedPlotter::drawColorMapGeneric_2D (
     QRgb   rgb;
     QImage *image = new QImage(W,H,QImage::Format_ARGB32);
     image->fill( qRgba(0,0,0,0));
-    for (i=0; i<W-1; i+=2) {
-        for (j=0; j<H-1; j+=2)
-        {
-            proj->screen2map(i,j, &lon, &lat);
-            
-            if (! recX->isXInMap(lon))
-                lon += 360.0;    // tour complet ?
-            if (recX->isPointInMap(lon, lat))
+    // geographic coordinates of the pixels (i, j) (multiples of step)
+    int step = getColorMapStep ();
+    std::shared_ptr <const ScreenMapGrid> grid = ScreenMapGrid::get (proj, step);
+    // only the blocks inside the clip region of the painter
+    for (const QRect &r : getColorMapBlocks (pnt, *grid)) {
+        for (int a=r.left(); a<=r.right(); a++) {
+            i = step*a;
+            const double *vlon = grid->getColumnLon (a);
+            const double *vlat = grid->getColumnLat (a);
+            for (int k=r.top(); k<=r.bottom(); k++)
             {
-                vx = recX->getInterpolatedValue (lon, lat, mustInterpolateValues);
-                vy = recY->getInterpolatedValue (lon, lat, mustInterpolateValues);
-				
-                if (GribDataIsDef(vx) && GribDataIsDef(vy))
+                j = step*k;
+                lon = vlon[k];
+                lat = vlat[k];
+            
+                if (! recX->isXInMap(lon))
+                    lon += 360.0;    // tour complet ?
+                if (recX->isPointInMap(lon, lat))
                 {
-                    v = sqrt(vx*vx+vy*vy);
-                    rgb = (this->*function_getColor) (v, smooth);
-                    image->setPixel(i,  j, rgb);
-                    image->setPixel(i+1,j, rgb);
-                    image->setPixel(i,  j+1, rgb);
-                    image->setPixel(i+1,j+1, rgb);
+                    vx = recX->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                    vy = recY->getInterpolatedValue (lon, lat, mustInterpolateValues);
+				
+                    if (GribDataIsDef(vx) && GribDataIsDef(vy))
+                    {
+                        v = sqrt(vx*vx+vy*vy);
+                        rgb = (this->*function_getColor) (v, smooth);
+                        fillColorMapBlock (image, i, j, step, rgb);
+                    }
                 }
             }
         }
@@ -511,6 +898,16 @@ void  GriddedPlotter::drawColorMapGeneric_Abs_Delta_2D (
     GriddedRecord *rec2 = getReader()->getRecord (dtc2, currentDate);
     if (rec2 == nullptr )
         return;
+    if (drawColorMapOnGrid (pnt, proj, smooth, {recX, recY, rec2},
+    		[recX, recY, rec2] (int i, int j) {
+    			double vx = recX->getValueOnRegularGrid (i,j);
+    			double vy = recY->getValueOnRegularGrid (i,j);
+    			double v2 = rec2->getValueOnRegularGrid (i,j);
+    			return (GribDataIsDef(vx) && GribDataIsDef(vy) && GribDataIsDef(v2)) ?
+    						fabs(sqrt(vx*vx+vy*vy) -v2) : GRIB_NOTDEF;
+    		},
+    		function_getColor))
+        return;
 
     int i, j;
     double lon, lat;
@@ -519,27 +916,35 @@ void  GriddedPlotter::drawColorMapGeneric_Abs_Delta_2D (
     QRgb   rgb;
     QImage *image = new QImage(W,H,QImage::Format_ARGB32);
     image->fill( qRgba(0,0,0,0));
-    for (i=0; i<W-1; i+=2) {
-        for (j=0; j<H-1; j+=2)
-        {
-            proj->screen2map(i,j, &lon, &lat);
-
-            if (! recX->isXInMap(lon))
-                lon += 360.0;    // tour complet ?
-            if (recX->isPointInMap(lon, lat))
+    // geographic coordinates of the pixels (i, j) (multiples of step)
+    int step = getColorMapStep ();
+    std::shared_ptr <const ScreenMapGrid> grid = ScreenMapGrid::get (proj, step);
+    // only the blocks inside the clip region of the painter
+    for (const QRect &r : getColorMapBlocks (pnt, *grid)) {
+        for (int a=r.left(); a<=r.right(); a++) {
+            i = step*a;
+            const double *vlon = grid->getColumnLon (a);
+            const double *vlat = grid->getColumnLat (a);
+            for (int k=r.top(); k<=r.bottom(); k++)
             {
-                double vx = recX->getInterpolatedValue (lon, lat, mustInterpolateValues);
-                double vy = recY->getInterpolatedValue (lon, lat, mustInterpolateValues);
-                double v2 = rec2->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                j = step*k;
+                lon = vlon[k];
+                lat = vlat[k];
 
-                if (GribDataIsDef(vx) && GribDataIsDef(vy) && GribDataIsDef(v2))
+                if (! recX->isXInMap(lon))
+                    lon += 360.0;    // tour complet ?
+                if (recX->isPointInMap(lon, lat))
                 {
-                    double v = fabs(sqrt(vx*vx+vy*vy) -v2);
-                    rgb = (this->*function_getColor) (v, smooth);
-                    image->setPixel(i,  j, rgb);
-                    image->setPixel(i+1,j, rgb);
-                    image->setPixel(i,  j+1, rgb);
-                    image->setPixel(i+1,j+1, rgb);
+                    double vx = recX->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                    double vy = recY->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                    double v2 = rec2->getInterpolatedValue (lon, lat, mustInterpolateValues);
+
+                    if (GribDataIsDef(vx) && GribDataIsDef(vy) && GribDataIsDef(v2))
+                    {
+                        double v = fabs(sqrt(vx*vx+vy*vy) -v2);
+                        rgb = (this->*function_getColor) (v, smooth);
+                        fillColorMapBlock (image, i, j, step, rgb);
+                    }
                 }
             }
         }
@@ -561,6 +966,15 @@ void  GriddedPlotter::drawColorMapGeneric_Abs_Delta_Data (
 	GriddedRecord *rec2 = getReader()->getRecord (dtc2, currentDate);
     if (rec1 == nullptr || rec2 == nullptr )
         return;
+    if (drawColorMapOnGrid (pnt, proj, smooth, {rec1, rec2},
+    		[rec1, rec2] (int i, int j) {
+    			double vx = rec1->getValueOnRegularGrid (i,j);
+    			double vy = rec2->getValueOnRegularGrid (i,j);
+    			return (GribDataIsDef(vx) && GribDataIsDef(vy)) ?
+    						fabs(vx-vy) : GRIB_NOTDEF;
+    		},
+    		function_getColor))
+        return;
     int i, j;
     double lon, lat;
     int W = proj->getW();
@@ -568,26 +982,34 @@ void  GriddedPlotter::drawColorMapGeneric_Abs_Delta_Data (
     QRgb   rgb;
     QImage *image = new QImage(W,H,QImage::Format_ARGB32);
     image->fill( qRgba(0,0,0,0));
-    for (i=0; i<W-1; i+=2) {
-        for (j=0; j<H-1; j+=2)
-        {
-            proj->screen2map(i,j, &lon, &lat);
-            
-            if (! rec1->isXInMap(lon))
-                lon += 360.0;    // tour complet ?
-            if (rec1->isPointInMap(lon, lat))
+    // geographic coordinates of the pixels (i, j) (multiples of step)
+    int step = getColorMapStep ();
+    std::shared_ptr <const ScreenMapGrid> grid = ScreenMapGrid::get (proj, step);
+    // only the blocks inside the clip region of the painter
+    for (const QRect &r : getColorMapBlocks (pnt, *grid)) {
+        for (int a=r.left(); a<=r.right(); a++) {
+            i = step*a;
+            const double *vlon = grid->getColumnLon (a);
+            const double *vlat = grid->getColumnLat (a);
+            for (int k=r.top(); k<=r.bottom(); k++)
             {
-                double vx = rec1->getInterpolatedValue (lon, lat, mustInterpolateValues);
-                double vy = rec2->getInterpolatedValue (lon, lat, mustInterpolateValues);
-
-                if (GribDataIsDef(vx) && GribDataIsDef(vy))
+                j = step*k;
+                lon = vlon[k];
+                lat = vlat[k];
+            
+                if (! rec1->isXInMap(lon))
+                    lon += 360.0;    // tour complet ?
+                if (rec1->isPointInMap(lon, lat))
                 {
-                    double v = fabs(vx-vy);
-                    rgb = (this->*function_getColor) (v, smooth);
-                    image->setPixel(i,  j, rgb);
-                    image->setPixel(i+1,j, rgb);
-                    image->setPixel(i,  j+1, rgb);
-                    image->setPixel(i+1,j+1, rgb);
+                    double vx = rec1->getInterpolatedValue (lon, lat, mustInterpolateValues);
+                    double vy = rec2->getInterpolatedValue (lon, lat, mustInterpolateValues);
+
+                    if (GribDataIsDef(vx) && GribDataIsDef(vy))
+                    {
+                        double v = fabs(vx-vy);
+                        rgb = (this->*function_getColor) (v, smooth);
+                        fillColorMapBlock (image, i, j, step, rgb);
+                    }
                 }
             }
         }
@@ -599,7 +1021,7 @@ void  GriddedPlotter::drawColorMapGeneric_Abs_Delta_Data (
 
 //-------------------------------------------------------------------------
 void GriddedPlotter::draw_listIsolines (
-						std::vector <IsoLine *> & listIsolines,
+						const IsoLineList & listIsolines,
 						QPainter &pnt, const Projection *proj)
 {
     for(auto & listIsoline : listIsolines)
@@ -609,11 +1031,12 @@ void GriddedPlotter::draw_listIsolines (
 }
 //--------------------------------------------------------------------------
 void GriddedPlotter::draw_listIsolines_labels (
-						std::vector <IsoLine *>  & listIsolines,
+						const IsoLineList & listIsolines,
 						double coef,
 						double offset,
-						QColor &color,
-						QPainter &pnt, const Projection *proj, 
+						const QColor &color,
+						const Projection *proj, 
+						LabelPlacer &placer,
 						int density 	// default -1
 					)
 {
@@ -632,22 +1055,53 @@ void GriddedPlotter::draw_listIsolines_labels (
 		if (density < 20)
 			density = 20;
 	}
-    std::vector <QRect> overlap;
+    QFont fontText = Font::getFont(FONT_IsolineLabel);
+    QFontMetrics fmet(fontText);
+    QPen penText(color);
+	// use a gradient, because it's a bug sometimes with solid pattern (black background)
+	QLinearGradient gradient;
+    int r = 255;
+	gradient.setColorAt(0, QColor(r,r,r, 170));
+	gradient.setColorAt(1, QColor(r,r,r, 170));
+    int ascent = fmet.ascent();
+    
+    std::vector <QPoint>  positions;
     int first = 0;
     for(auto & listIsoline : listIsolines)
     {
         first += 20;
-        listIsoline->drawIsoLineLabels (pnt, overlap, color, proj, density, first, coef,offset);
+        int v = qRound (listIsoline->getValue()*coef+offset);
+        QString label = QString::number (v);
+        int priority = (v%10 == 0) ? LabelPlacer::PriorityRoundValue
+                                   : LabelPlacer::PriorityNormal;
+        QRect rect = fmet.boundingRect(label);
+        positions.clear();
+        listIsoline->getLabelsPositions (proj, density, first, positions);
+        for (auto const &pos : positions)
+        {
+            rect.moveTo(pos.x()-rect.width()/2, pos.y()-rect.height()/2);
+            // keep some space around the label
+            QRect reserved (rect.x() -rect.width()/2, rect.y() -rect.height()/2, 
+                            rect.width()*2, rect.height()*2);
+            placer.addCandidate (rect, reserved, priority,
+                    [=] (QPainter &pnt) {
+                        pnt.setPen(penText);
+                        pnt.setFont(fontText);
+                        pnt.setBrush(gradient);
+                        pnt.drawRect(rect.x()-1, rect.y(), rect.width()+2, ascent+2);
+                        pnt.drawText(rect, Qt::AlignHCenter|Qt::AlignVCenter, label);
+                    });
+        }
     }
 }
 //----------------------------------------------------
 void GriddedPlotter::complete_listIsolines (
-				std::vector <IsoLine *> *listIsolines,
+				IsoLineList *listIsolines,
 				DataCode dtc,
 				double dataMin, double dataMax, double dataStep, 
 				const Projection *proj
 ) {
-    Util::cleanVectorPointers (*listIsolines);    
+    listIsolines->clear ();
 	GriddedReader *reader = getReader ();
     if (reader == nullptr)
         return;
@@ -659,21 +1113,68 @@ void GriddedPlotter::complete_listIsolines (
     int deltaI, deltaJ;
     analyseVisibleGridDensity (proj, rec, 16, &deltaI, &deltaJ);
 	//DBG("deltaI=%d deltaJ=%d", deltaI, deltaJ);
-	IsoLine *iso;
-	for (double val=dataMin; val<=dataMax; val += dataStep)
+	QMutexLocker lock (&isolinesCacheMutex);
+	for (auto it=isolinesCache.begin(); it!=isolinesCache.end(); ++it)
 	{
-		iso = new IsoLine (val, rec, deltaI, deltaJ);
-        if (iso->getNbSegments()>0)
-            listIsolines->push_back (iso);
-        else
-            delete iso;
+		if (it->reader == reader && it->rec == rec
+				&& it->dtc == dtc && it->date == currentDate
+				&& it->deltaI == deltaI && it->deltaJ == deltaJ
+				&& it->dataMin == dataMin && it->dataMax == dataMax
+				&& it->dataStep == dataStep)
+		{
+			isolinesCache.splice (isolinesCache.begin(), isolinesCache, it);
+			*listIsolines = isolinesCache.front().isolines;
+			return;
+		}
+	}
+	IsolinesCacheEntry entry;
+	entry.reader = reader;
+	entry.rec = rec;
+	entry.dtc = dtc;
+	entry.date = currentDate;
+	entry.dataMin = dataMin;
+	entry.dataMax = dataMax;
+	entry.dataStep = dataStep;
+	entry.deltaI = deltaI;
+	entry.deltaJ = deltaJ;
+	// All the values are extracted in a single pass on the grid
+	std::vector <IsoLine *> isolines;
+	IsoLine::extractIsoLines (&isolines, rec, 
+							dataMin, dataMax, dataStep, deltaI, deltaJ);
+	entry.isolines.assign (isolines.begin(), isolines.end());
+	isolinesCache.push_front (std::move(entry));
+	*listIsolines = isolinesCache.front().isolines;
+
+	// the evicted isolines are deleted by their last user
+	while ((int)isolinesCache.size() > isolinesCacheMaxSize) {
+		isolinesCache.pop_back ();
 	}
 }
 //-----------------------------------------------------------------
+void GriddedPlotter::clearIsolinesCache ()
+{
+	QMutexLocker lock (&isolinesCacheMutex);
+	isolinesCache.clear ();
+}
+//-----------------------------------------------------------------
+void GriddedPlotter::setDensityView (const Projection *view)
+{
+	densityView.reset (view ? view->clone() : nullptr);
+}
+//-----------------------------------------------------------------
+int GriddedPlotter::getLatticeStart (double origin, int space, int margin)
+{
+	int o = (int) floor (origin);
+	int k = (int) ceil ((double)(o-margin) / space);
+	return k*space - o;
+}
+//-----------------------------------------------------------------
 void GriddedPlotter::analyseVisibleGridDensity 
 		(const Projection *proj, GriddedRecord *rec, 
 		 double coef, int *deltaI, int *deltaJ) const 
 {
+	if (densityView)
+		proj = densityView.get();
     int i0, j0, i1, j1;
 	double x0,y0, x1,y1;
 	i0 = proj->getW()/2;
@@ -699,6 +1200,8 @@ void GriddedPlotter::analyseVisibleGridDensity
 bool GriddedPlotter::analyseVisibleGridDensity 
 		(const Projection *proj, GriddedRecord *rec, int dl) const
 {
+	if (densityView)
+		proj = densityView.get();
 	double lon, lat;
     int px,py, px1, py1;
 
@@ -717,6 +1220,75 @@ bool GriddedPlotter::analyseVisibleGridDensity
 
     return true;
 }
+//-----------------------------------------------------------------
+// The window is computed from the lon/lat bounds of the map, enlarged
+// by margin pixels and one grid step. It is the whole grid when the
+// grid isn't aligned on lon/lat or when the bounds are not exact.
+void GriddedPlotter::getVisibleGridWindow (const Projection *proj,
+				const GriddedRecord *rec, int margin, GridWindow *win) const
+{
+	int Ni = rec->getNi();
+	int Nj = rec->getNj();
+	win->jmin = 0;
+	win->jmax = Nj-1;
+	win->columns.assign (1, std::make_pair (0, Ni-1));
+	if (Ni < 2 || Nj < 2 || ! rec->isLonLatAligned() || ! proj->isCylindrical())
+		return;
+
+	double x0,y0, x1,y1;
+	proj->getVisibleArea (&x0,&y0, &x1,&y1);
+	if (x0 > x1)
+		std::swap (x0, x1);
+	if (y0 > y1)
+		std::swap (y0, y1);
+	double mx = margin*(x1-x0)/proj->getW() + fabs(rec->getDeltaX());
+	double my = margin*(y1-y0)/proj->getH() + fabs(rec->getDeltaY());
+	x0 -= mx;
+	x1 += mx;
+	y0 = std::max (y0-my, -90.0);
+	y1 = std::min (y1+my,  90.0);
+
+	double ia,ja, ib,jb;
+	rec->lonLat2XY (x0, y0, &ia, &ja);
+	rec->lonLat2XY (x0, y1, &ib, &jb);
+	double a = std::min (ja, jb);
+	double b = std::max (ja, jb);
+	if (b < 0 || a > Nj-1) {	// grid out of the map
+		win->jmax = -1;
+		win->columns.clear ();
+		return;
+	}
+	win->jmin = (int) std::max (0.0, floor(a));
+	win->jmax = (int) std::min (Nj-1.0, ceil(b));
+
+	if (x1-x0 >= 360)
+		return;
+	// Longitudes of the map may be shifted by 360° relative to the grid
+	win->columns.clear ();
+	for (double shift : {-360.0, 0.0, 360.0})
+	{
+		rec->lonLat2XY (x0+shift, y0, &ia, &ja);
+		rec->lonLat2XY (x1+shift, y0, &ib, &jb);
+		a = std::min (ia, ib);
+		b = std::max (ia, ib);
+		if (b < 0 || a > Ni-1)
+			continue;
+		win->columns.push_back (std::make_pair ((int) std::max (0.0, floor(a)),
+												(int) std::min (Ni-1.0, ceil(b))));
+	}
+	// Merge the overlapping ranges
+	std::sort (win->columns.begin(), win->columns.end());
+	size_t n = 0;
+	for (size_t k=1; k < win->columns.size(); k++) {
+		if (win->columns[k].first <= win->columns[n].second+1)
+			win->columns[n].second = std::max (win->columns[n].second,
+											   win->columns[k].second);
+		else
+			win->columns[++n] = win->columns[k];
+	}
+	if (! win->columns.empty())
+		win->columns.resize (n+1);
+}
 
 //======================================================================
 void GriddedPlotter::draw_DATA_Labels (
@@ -724,7 +1296,8 @@ void GriddedPlotter::draw_DATA_Labels (
                 const QFont 	&labelsFont,
                 const QColor   &labelsColor,
 				QString  (formatLabelFunction) (float v, bool withUnit),
-				QPainter &pnt, const Projection *proj)
+				const Projection *proj,
+				LabelPlacer &placer)
 {
 	GriddedReader *reader = getReader();
     if (reader == nullptr)
@@ -735,8 +1308,6 @@ void GriddedPlotter::draw_DATA_Labels (
 		return;
 
     QFontMetrics fmet (labelsFont);
-    pnt.setFont (labelsFont);
-    pnt.setPen  (labelsColor);
 
 	double lon, lat, v;
     int i, j, dimin, djmin;
@@ -748,7 +1319,15 @@ void GriddedPlotter::draw_DATA_Labels (
             v = rec->getInterpolatedValue (lon, lat, mustInterpolateValues);
             if (GribDataIsDef(v)) {
                 QString strtemp = formatLabelFunction (v,false);
-                pnt.drawText(i-fmet.width("XXX")/2, j+fmet.ascent()/2, strtemp);
+                int x = i-fmet.width("XXX")/2;
+                int y = j+fmet.ascent()/2;
+                QRect rect (x, y-fmet.ascent(), fmet.width(strtemp), fmet.height());
+                placer.addCandidate (rect, rect, LabelPlacer::PriorityData,
+                        [=] (QPainter &pnt) {
+                            pnt.setFont (labelsFont);
+                            pnt.setPen  (labelsColor);
+                            pnt.drawText(x, y, strtemp);
+                        });
             }
         }
     } 
@@ -761,7 +1340,8 @@ void GriddedPlotter::draw_DATA_MinMax (
                         const QString  &maxSymbol,
                         const QFont 	 &labelsFont,
                         const QColor   &labelsColor,
-						QPainter &pnt, const Projection *proj)
+						const Projection *proj,
+						LabelPlacer &placer)
 {
 	GriddedReader *reader = getReader();
     if (reader == nullptr)
@@ -772,8 +1352,6 @@ void GriddedPlotter::draw_DATA_MinMax (
 		return;
 
     QFontMetrics fmet (labelsFont);
-    pnt.setFont (labelsFont);
-    pnt.setPen  (labelsColor);
 
     int i, j, Ni, Nj, pi,pj;
     double x, y, v;
@@ -795,153 +1373,159 @@ void GriddedPlotter::draw_DATA_MinMax (
     Ni = rec->getNi();
     Nj = rec->getNj();
 
-    for (j=1; j<Nj-1; j++) {     // !!!! 1 to end-1
-        for (i=1; i<Ni-1; i++) {
-            v = rec->getValueOnRegularGrid (i, j );
-            if ( v <= meanValue
-                   && v < rec->getValueOnRegularGrid (i-1, j-1 )  // Minima local ?
-                   && v < rec->getValueOnRegularGrid (i-1, j   )
-                   && v < rec->getValueOnRegularGrid (i-1, j+1 )
-                   && v < rec->getValueOnRegularGrid (i  , j-1 )
-                   && v < rec->getValueOnRegularGrid (i  , j+1 )
-                   && v < rec->getValueOnRegularGrid (i+1, j-1 )
-                   && v < rec->getValueOnRegularGrid (i+1, j   )
-                   && v < rec->getValueOnRegularGrid (i+1, j+1 )
-            ) {
-                rec->getXY(i, j, &x, &y);
-
-                // in which quarter of the grid are we
-                if (i <= Ni/2 && j <= Nj/2) {
-                    // if we found a record low for the quarter - we save it
-                    if (v < q1savLv) {
-                        q1savLv = v;
-                        q1savLx = x;
-                        q1savLy = y;
-                    }
-                } else if (i <= Ni/2 && j > Nj/2) {
-                    // if we found a record low for the quarter - we save it
-                    if (v < q2savLv) {
-                        q2savLv = v;
-                        q2savLx = x;
-                        q2savLy = y;
-                    }
-                } else if (i > Ni/2 && j <= Nj/2) {
-                    // if we found a record low for the quarter - we save it
-                    if (v < q3savLv) {
-                        q3savLv = v;
-                        q3savLx = x;
-                        q3savLy = y;
-                    }
-                } else if (i > Ni/2 && j > Nj/2) {
-                    // if we found a record low for the quarter - we save it
-                    if (v < q4savLv) {
-                        q4savLv = v;
-                        q4savLx = x;
-                        q4savLy = y;
-                    }
-                }
+    // Only the visible part of the grid is searched, split in 4 quarters
+    GridWindow win;
+    getVisibleGridWindow (proj, rec, fmet.height(), &win);
+    int winNi = 0;
+    for (auto &cols : win.columns)
+        winNi += cols.second - cols.first + 1;
+    int midI = winNi/2;
+    int midJ = (win.jmax - win.jmin + 1)/2;
 
-            }
-            else if ( v > meanValue
-                   && v > rec->getValueOnRegularGrid (i-1, j-1 )  // Maxima local ?
-                   && v > rec->getValueOnRegularGrid (i-1, j   )
-                   && v > rec->getValueOnRegularGrid (i-1, j+1 )
-                   && v > rec->getValueOnRegularGrid (i  , j-1 )
-                   && v > rec->getValueOnRegularGrid (i  , j+1 )
-                   && v > rec->getValueOnRegularGrid (i+1, j-1 )
-                   && v > rec->getValueOnRegularGrid (i+1, j   )
-                   && v > rec->getValueOnRegularGrid (i+1, j+1 )
-            ) {
-                rec->getXY(i, j, &x, &y);
-
-                // in which quarter of the grid are we
-                if (i <= Ni/2 && j <= Nj/2) {
-                    // if we found a record high for the quarter - we save it
-                    if (v > q1savHv) {
-                        q1savHv = v;
-                        q1savHx = x;
-                        q1savHy = y;
-                    }
-                } else if (i <= Ni/2 && j > Nj/2) {
-                    // if we found a record high for the quarter - we save it
-                    if (v > q2savHv) {
-                        q2savHv = v;
-                        q2savHx = x;
-                        q2savHy = y;
-                    }
-                } else if (i > Ni/2 && j <= Nj/2) {
-                    // if we found a record high for the quarter - we save it
-                    if (v > q3savHv) {
-                        q3savHv = v;
-                        q3savHx = x;
-                        q3savHy = y;
-                    }
-                } else if (i > Ni/2 && j > Nj/2) {
-                    // if we found a record high for the quarter - we save it
-                    if (v > q4savHv) {
-                        q4savHv = v;
-                        q4savHx = x;
-                        q4savHy = y;
-                    }
-                }
+	for (j=std::max(win.jmin,1); j<=std::min(win.jmax,Nj-2); j++) {     // !!!! 1 to end-1
+		int qj = j - win.jmin;
+		int qi0 = 0;      // position of the columns in the window
+		for (auto &cols : win.columns) {
+			int qoffset = qi0 - cols.first;
+			qi0 += cols.second - cols.first + 1;
+			for (i=std::max(cols.first,1); i<=std::min(cols.second,Ni-2); i++) {
+				int qi = i + qoffset;
+				v = rec->getValueOnRegularGrid (i, j );
+				if ( v <= meanValue
+				       && v < rec->getValueOnRegularGrid (i-1, j-1 )  // Minima local ?
+				       && v < rec->getValueOnRegularGrid (i-1, j   )
+				       && v < rec->getValueOnRegularGrid (i-1, j+1 )
+				       && v < rec->getValueOnRegularGrid (i  , j-1 )
+				       && v < rec->getValueOnRegularGrid (i  , j+1 )
+				       && v < rec->getValueOnRegularGrid (i+1, j-1 )
+				       && v < rec->getValueOnRegularGrid (i+1, j   )
+				       && v < rec->getValueOnRegularGrid (i+1, j+1 )
+				) {
+					rec->getXY(i, j, &x, &y);
 
-            }
-        }
-    }
+					// in which quarter of the grid are we
+					if (qi <= midI && qj <= midJ) {
+						// if we found a record low for the quarter - we save it
+						if (v < q1savLv) {
+							q1savLv = v;
+							q1savLx = x;
+							q1savLy = y;
+						}
+					} else if (qi <= midI && qj > midJ) {
+						// if we found a record low for the quarter - we save it
+						if (v < q2savLv) {
+							q2savLv = v;
+							q2savLx = x;
+							q2savLy = y;
+						}
+					} else if (qi > midI && qj <= midJ) {
+						// if we found a record low for the quarter - we save it
+						if (v < q3savLv) {
+							q3savLv = v;
+							q3savLx = x;
+							q3savLy = y;
+						}
+					} else if (qi > midI && qj > midJ) {
+						// if we found a record low for the quarter - we save it
+						if (v < q4savLv) {
+							q4savLv = v;
+							q4savLx = x;
+							q4savLy = y;
+						}
+					}
+
+				}
+				else if ( v > meanValue
+				       && v > rec->getValueOnRegularGrid (i-1, j-1 )  // Maxima local ?
+				       && v > rec->getValueOnRegularGrid (i-1, j   )
+				       && v > rec->getValueOnRegularGrid (i-1, j+1 )
+				       && v > rec->getValueOnRegularGrid (i  , j-1 )
+				       && v > rec->getValueOnRegularGrid (i  , j+1 )
+				       && v > rec->getValueOnRegularGrid (i+1, j-1 )
+				       && v > rec->getValueOnRegularGrid (i+1, j   )
+				       && v > rec->getValueOnRegularGrid (i+1, j+1 )
+				) {
+					rec->getXY(i, j, &x, &y);
+
+					// in which quarter of the grid are we
+					if (qi <= midI && qj <= midJ) {
+						// if we found a record high for the quarter - we save it
+						if (v > q1savHv) {
+							q1savHv = v;
+							q1savHx = x;
+							q1savHy = y;
+						}
+					} else if (qi <= midI && qj > midJ) {
+						// if we found a record high for the quarter - we save it
+						if (v > q2savHv) {
+							q2savHv = v;
+							q2savHx = x;
+							q2savHy = y;
+						}
+					} else if (qi > midI && qj <= midJ) {
+						// if we found a record high for the quarter - we save it
+						if (v > q3savHv) {
+							q3savHv = v;
+							q3savHx = x;
+							q3savHy = y;
+						}
+					} else if (qi > midI && qj > midJ) {
+						// if we found a record high for the quarter - we save it
+						if (v > q4savHv) {
+							q4savHv = v;
+							q4savHx = x;
+							q4savHy = y;
+						}
+					}
+
+				}
+			}
+		}
+	}
     // now display the maxima and minima for each quarter
+    auto drawSymbol = [&] (double x, double y, const QString &symbol, QChar c)
+    {
+        for (double dx : {0.0, -360.0}) {
+            proj->map2screen(x+dx, y, &pi, &pj);
+            int px = pi-fmet.width(c)/2;
+            int py = pj+fmet.ascent()/2;
+            QRect rect (px, py-fmet.ascent(), fmet.width(symbol), fmet.height());
+            placer.addCandidate (rect, rect, LabelPlacer::PriorityExtremum,
+                    [=] (QPainter &pnt) {
+                        pnt.setFont (labelsFont);
+                        pnt.setPen  (labelsColor);
+                        pnt.drawText(px, py, symbol);
+                    });
+        }
+    };
     if (q1savLv < 9999999.9) {
-        proj->map2screen(q1savLx, q1savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
-        proj->map2screen(q1savLx-360.0,q1savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
+        drawSymbol (q1savLx, q1savLy, minSymbol, 'L');
     }
     if (q1savHv > 0.0) {
-        proj->map2screen(q1savHx, q1savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
-        proj->map2screen(q1savHx-360.0,q1savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
+        drawSymbol (q1savHx, q1savHy, maxSymbol, 'H');
     }
     // next quarter
     if (q2savLv < 9999999.9) {
-        proj->map2screen(q2savLx, q2savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
-        proj->map2screen(q2savLx-360.0,q2savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
+        drawSymbol (q2savLx, q2savLy, minSymbol, 'L');
     }
     if (q2savHv > 0.0) {
-        proj->map2screen(q2savHx, q2savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
-        proj->map2screen(q2savHx-360.0,q2savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
+        drawSymbol (q2savHx, q2savHy, maxSymbol, 'H');
     }
     // next quarter
     if (q3savLv < 9999999.9) {
-        proj->map2screen(q3savLx, q3savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
-        proj->map2screen(q3savLx-360.0,q3savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
+        drawSymbol (q3savLx, q3savLy, minSymbol, 'L');
     }
     if (q3savHv > 0.0) {
-        proj->map2screen(q3savHx, q3savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
-        proj->map2screen(q3savHx-360.0,q3savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
+        drawSymbol (q3savHx, q3savHy, maxSymbol, 'H');
     }
     // last quarter
     if (q4savLv < 9999999.9) {
-        proj->map2screen(q4savLx, q4savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
-        proj->map2screen(q4savLx-360.0,q4savLy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('L')/2, pj+fmet.ascent()/2, minSymbol);;
+        drawSymbol (q4savLx, q4savLy, minSymbol, 'L');
     }
     if (q4savHv > 0.0) {
-        proj->map2screen(q4savHx, q4savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
-        proj->map2screen(q4savHx-360.0,q4savHy, &pi, &pj);
-        pnt.drawText(pi-fmet.width('H')/2, pj+fmet.ascent()/2, maxSymbol);
+        drawSymbol (q4savHx, q4savHy, maxSymbol, 'H');
     }
-
- }
+}
 
 //------------------------------------------------------------
 void GriddedPlotter::setCurrentDateClosestFromNow ()
@@ -25,14 +25,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <set>
 #include <map>
+#include <list>
+#include <memory>
+#include <functional>
 
 #include <QPainter>
+#include <QMutex>
 
 #include "DataMeteoAbstract.h"
 #include "DataColors.h"
 #include "GriddedReader.h"
 #include "Projection.h"
+#include "ScreenMapGrid.h"
 #include "IsoLine.h"
+#include "LabelPlacer.h"
+#include "ArrowsAtlas.h"
 #include "Util.h"
 #include "LongTaskProgress.h"
 
@@ -54,6 +61,12 @@ class GriddedPlotter :
 		
 		virtual void  updateGraphicsParameters ();
 		
+		/** Plotter of the same data with a copy of the settings, for the
+			drawings in another thread. It shares the reader, which must not
+			be modified while the copy is used, and has its own caches.
+		*/
+		virtual GriddedPlotter *createDrawingCopy () const = 0;
+		
 		//----------------------------------------------------------------
 		// Data manipulation
 		//----------------------------------------------------------------
@@ -103,25 +116,48 @@ class GriddedPlotter :
 		virtual void setUseJetStreamColorMap (bool b)
 							{useJetStreamColorMap = b;}
 		virtual void setUseGustColorAbsolute (bool b);
+		bool getUseJetStreamColorMap () const {return useJetStreamColorMap;}
+		bool getUseGustColorAbsolute () const {return useGustColorAbsolute;}
+		/** Fast drawing while the map is moving: coarser color maps
+			and fewer arrows.
+		*/
+		virtual void setInteractiveRendering (bool b)
+							{interactiveRendering = b;}
+		/** Size of the blocks of the color maps for the coarse previews
+			of the map (0: size given by the rendering mode).
+		*/
+		virtual void setColorMapStep (int step)
+							{colorMapStep = step;}
+		/** View of the whole map while its tiles are drawn: the density
+			of the visible grid is computed once on this view, the same
+			for all the tiles (nullptr: the projection of the drawing).
+		*/
+		virtual void setDensityView (const Projection *view);
 
         virtual Altitude getWindAltitude () 
-							{return windAltitude;}
+							{QMutexLocker lock (&altitudeMutex); return windAltitude;}
 		
         virtual Altitude getCurrentAltitude () 
-							{return currentAltitude;}
+							{QMutexLocker lock (&altitudeMutex); return currentAltitude;}
 		
 		//----------------------------------------------------------------
 		// Drawing functions (virtual not pure)
 		//----------------------------------------------------------------
+		/** Labels functions: the labels are candidates of the placer,
+			drawn by LabelPlacer::placeCandidates with those of the other
+			families, by priority.
+		*/
 		/** Data: write numerical values on the map (temperature).
 		*/
         virtual void draw_DATA_Labels (DataCode dtc,
                         const QFont &labelsFont,
                         const QColor &labelsColor,
                         QString  (formatLabelFunction) (float v, bool withUnit),
-                        QPainter &pnt, const Projection *proj);
+                        const Projection *proj,
+                        LabelPlacer &placer);
 
 		/** Pressure: write H and L at hight and low points (pressure).
+			The symbols have the highest priority.
 		*/
         virtual void draw_DATA_MinMax (DataCode dtc,
                         double   meanValue,
@@ -129,7 +165,8 @@ class GriddedPlotter :
                         const QString &maxSymbol,
                         const QFont &labelsFont,
                         const QColor &labelsColor,
-                        QPainter &pnt, const Projection *proj);
+                        const Projection *proj,
+                        LabelPlacer &placer);
 		
 		//----------------------------------------------------------------
 		// Drawing functions (pure virtual)
@@ -174,25 +211,29 @@ class GriddedPlotter :
 		//----------------------------------------------------------------
 		// Isolines functions
 		//----------------------------------------------------------------
-		/** Draw all the Isolines contained in a list.
+		/** Fill the list with the isolines of the current record.
+			The isolines are shared with the cache of the plotter: they
+			stay valid while the list holds them.
 		*/
         virtual void complete_listIsolines (
-						std::vector <IsoLine *> *listIsolines,
+						IsoLineList *listIsolines,
 						DataCode dtc,
 						double dataMin, double dataMax, double dataStep,
 						const Projection *proj);
 						
         void draw_listIsolines (
-						std::vector <IsoLine *> & listIsolines,
+						const IsoLineList & listIsolines,
 						QPainter &pnt, const Projection *proj);
 
+		/** Labels of all the isolines of the list, round values first.
+		*/
         void draw_listIsolines_labels (
-						std::vector <IsoLine *> & listIsolines,
+						const IsoLineList & listIsolines,
 						double coef, 
 						double offset,
-						QColor &color,
-						QPainter &pnt, 
+						const QColor &color,
 						const Projection *proj,
+						LabelPlacer &placer,
 						int density = -1
   					);
 
@@ -239,9 +280,23 @@ class GriddedPlotter :
 		bool    thinWindArrows;
 		bool 	useJetStreamColorMap;
 		bool    useGustColorAbsolute;
+		bool    interactiveRendering;
+		int     colorMapStep;
+		std::unique_ptr <Projection> densityView;
+		/** First position (>= -margin) of a screen lattice of step space,
+			aligned on the origin of the whole map at this scale:
+			the tiles show the arrows of the map at the same places.
+		*/
+		static int getLatticeStart (double origin, int space, int margin);
 
 		Altitude windAltitude;		  // current wind altitude
 		Altitude currentAltitude;	  // current altitude
+		// the layers of the map are drawn in parallel
+		mutable QMutex altitudeMutex;
+		void  setWindAltitude (const Altitude &alt)
+					{QMutexLocker lock (&altitudeMutex); windAltitude = alt;}
+		void  setCurrentAltitude (const Altitude &alt)
+					{QMutexLocker lock (&altitudeMutex); currentAltitude = alt;}
 		
 		QColor windArrowColor;        // couleur des flèches du vent
 		int    windArrowSpace;        // distance mini entre flèches (pixels)
@@ -252,11 +307,28 @@ class GriddedPlotter :
 		int    currentArrowSpace;        // distance mini entre flèches (pixels)
         int    currentArrowSpaceOnGrid;  // distance mini entre flèches si affichage sur grille
 
+        // Arrows of the map, copied from the atlas of their layer
         void    drawWindArrow (QPainter &pnt, int i, int j, double vx, double vy);
+        void    drawWindBarbs (QPainter &pnt, int i, int j, double vx, double vy,
+        					   bool south, const QColor &arrowColor);
         void    drawWaveArrow (QPainter &pnt, int i, int j, double dir);
         void    drawCurrentArrow (QPainter &pnt, int i, int j, double vx, double vy);
+        ArrowsAtlas windArrowsAtlas;
+        ArrowsAtlas waveArrowsAtlas;
+        ArrowsAtlas currentArrowsAtlas;
 
 		//-----------------------------------------------------------------
+		// Size in pixels of the colored blocks of the color maps
+		int   getColorMapStep () const
+					{return colorMapStep>0 ? colorMapStep
+								: interactiveRendering ? 4 : 2;}
+		// Spacing of the arrows (pixels)
+		int   getArrowsSpacing (int space) const
+					{return interactiveRendering ? 2*space : space;}
+		static void fillColorMapBlock (QImage *image, int i, int j, int step, QRgb rgb);
+		static QVector <QRect> getColorMapBlocks (const QPainter &pnt,
+												const ScreenMapGrid &grid);
+
 		void  drawColorMapGeneric_1D (
 				QPainter &pnt, const Projection *proj, bool smooth,
 				DataCode dtc,
@@ -278,14 +350,63 @@ class GriddedPlotter :
 				QRgb (DataColors::*function_getColor) (double v, bool smooth)
 			);
 		
+		// Color maps drawn in the space of the grid, then resampled to
+		// the screen (false: the records can't use it).
+		bool  drawColorMapOnGrid (
+				QPainter &pnt, const Projection *proj, bool smooth,
+				const std::vector <GriddedRecord *> &recs,
+				const std::function <double (int i, int j)> &getValue,
+				QRgb (DataColors::*function_getColor) (double v, bool smooth)
+			);
+		struct ColorMapWarp;
+		std::list <std::shared_ptr <const ColorMapWarp> > colorMapWarps;  // last used first
+		QMutex  colorMapWarpMutex;
+		std::shared_ptr <const ColorMapWarp> getColorMapWarp (
+				const std::shared_ptr <const ScreenMapGrid> &grid,
+				const GriddedRecord *rec);
+		
 		void analyseVisibleGridDensity (const Projection *proj, GriddedRecord *rec, 
 										double coef, int *deltaI, int *deltaJ) const;
 
 		bool analyseVisibleGridDensity (const Projection *proj, GriddedRecord *rec, 
 										int size) const;
 
+		/** Indices of the grid points near the visible part of the map:
+		    rows jmin..jmax, columns in one or more ranges (the visible
+		    area may cross the edge of a grid around the world).
+		*/
+		struct GridWindow {
+			int jmin, jmax;
+			std::vector <std::pair <int,int> > columns;
+		};
+		void getVisibleGridWindow (const Projection *proj, const GriddedRecord *rec,
+										int margin, GridWindow *win) const;
+
+		/** Must be called when records are deleted or replaced.
+		*/
+		void clearIsolinesCache ();
+		
+		void copyDrawingSettings (const GriddedPlotter &model);
 		
 	private:
+		//-----------------------------------------------------------------
+		// Isolines of a record for a set of values. The geometry (lon/lat)
+		// doesn't depend on the projection: it is kept across repaints.
+		// The record is identified by its reader, data code and date
+		// (the same address may be reused by another record).
+		struct IsolinesCacheEntry {
+			const GriddedReader *reader;
+			const GriddedRecord *rec;
+			DataCode dtc;
+			time_t   date;
+			double dataMin, dataMax, dataStep;
+			int    deltaI, deltaJ;
+			IsoLineList isolines;
+		};
+		std::list <IsolinesCacheEntry> isolinesCache;	// most recently used first
+		QMutex isolinesCacheMutex;
+		static const int isolinesCacheMaxSize = 32;
+
         int    windArrowSize;         // longueur des flèches
         int    windBarbuleSize;       // longueur des flèches
 
@@ -301,6 +422,7 @@ class GriddedPlotter :
                     double si, double co, int di, int dj, int b);
         static void drawTriangle(QPainter &pnt, bool south,
                     double si, double co, int di, int dj, int b);
+        void drawCurrentArrowShape (QPainter &pnt, int i, int j, double vkn, double ang);
 };
 
 #endif
@@ -29,25 +29,19 @@ GriddedRecord::GriddedRecord ()
 }
 
 //=====================================================================
-// Interpolation using a regular rectangular grid
+// Position of a point in the regular rectangular grid (grid unit).
+// zero: the point is after the last column of a grid covering
+// the world (the next column is the first one).
 //=====================================================================
-data_t  GriddedRecord::getInterpolatedValueUsingRegularGrid (
-				double lon, double lat,
-				bool interpolateValues) const
+bool GriddedRecord::getGridPosition (double lon, double lat,
+				double *pi, double *pj, bool *zero) const
 {
-    double val;
-    double const eps = 1e-4;
-    double pi, pj;     // coord. in grid unit
-    // 00 10      point is in a square
-    // 01 11
-    int i0, j0, i1, j1;
-    bool zero = false;
-
+    *zero = false;
     if (!isOk() || getDeltaX()==0 || getDeltaY()==0) {
-        return GRIB_NOTDEF;
+        return false;
     }
     if (!isYInMap(lat)) {
-		return GRIB_NOTDEF;
+		return false;
     } 
     if (!isXInMap(lon)) {
 		if (! entireWorldInLongitude) {
@@ -55,7 +49,7 @@ data_t  GriddedRecord::getInterpolatedValueUsingRegularGrid (
 			if (!isXInMap(lon)) {
 				lon -= 2*360.0;              // tour du monde à gauche ?
 				if (!isXInMap(lon)) {
-					return GRIB_NOTDEF;
+					return false;
 				}
 			}
 		}
@@ -63,7 +57,7 @@ data_t  GriddedRecord::getInterpolatedValueUsingRegularGrid (
 			while (lon< 0)
 				lon += 360;
 			if (lon > xmax) {
-			    zero = true;
+			    *zero = true;
 			}
 		}
     }
@@ -71,7 +65,27 @@ data_t  GriddedRecord::getInterpolatedValueUsingRegularGrid (
         lon += 360.;
     }
 
-    lonLat2XY(lon, lat, &pi, &pj);
+    lonLat2XY(lon, lat, pi, pj);
+    return true;
+}
+//=====================================================================
+// Interpolation using a regular rectangular grid
+//=====================================================================
+data_t  GriddedRecord::getInterpolatedValueUsingRegularGrid (
+				double lon, double lat,
+				bool interpolateValues) const
+{
+    double val;
+    double const eps = 1e-4;
+    double pi, pj;     // coord. in grid unit
+    // 00 10      point is in a square
+    // 01 11
+    int i0, j0, i1, j1;
+    bool zero;
+
+    if (! getGridPosition (lon, lat, &pi, &pj, &zero)) {
+        return GRIB_NOTDEF;
+    }
     i0 = (int) floor(pi);  // point 00
 	i1 = zero?0:i0+1;
 	
@@ -61,6 +61,9 @@ class GriddedRecord : public DataRecordAbstract
 		/** Grid type.
 		*/
 		virtual bool isRegularGrid () const = 0;
+		/** Grid indices i and j follow the longitude and the latitude.
+		*/
+		virtual bool isLonLatAligned () const   { return false; }
 		
 		/** All records must have (or simulate) a rectangular regular grid.
 		*/ 
@@ -69,6 +72,8 @@ class GriddedRecord : public DataRecordAbstract
 		virtual data_t  getInterpolatedValueUsingRegularGrid (
 								double px, double py,
 								bool interpolateValues) const;
+		bool    getGridPosition (double lon, double lat,
+								double *pi, double *pj, bool *zero) const;
 						
 		virtual int     getNi () const = 0;
         virtual int     getNj () const = 0;
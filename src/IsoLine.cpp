@@ -16,249 +16,421 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 
+#include <algorithm>
+#include <unordered_map>
+
 #include "IsoLine.h"
-#include "Font.h"
+#include "LineSimplifier.h"
 
 //---------------------------------------------------------------
-IsoLine::IsoLine (double val, GriddedRecord *rec, int deltaI, int deltaJ)
+IsoLine::IsoLine (double val)
 {
-    this->rec    = rec;
     this->value  = val;
-	
-    W = rec->getNi();
-    H = rec->getNj();
+    nbSegments = 0;
     int gr = 80;
     isoLineColor = QColor(gr,gr,gr);
-    //---------------------------------------------------------
-    // Génère la liste des segments.
-    extractIsoLine (rec, deltaI, deltaJ);
-    //extractIsoLine (rec, 1, 1);
 }
 //---------------------------------------------------------------
 IsoLine::~IsoLine()
 {
-    for (auto & it : trace) {
-        delete it;
-        it = nullptr;
-    }
-    trace.clear();
 }
 
 //---------------------------------------------------------------
 void IsoLine::drawIsoLine (QPainter &pnt,
                             const Projection *proj)
 {
-    int   a,b,c,d;
 	pnt.setRenderHint(QPainter::Antialiasing, true);
-
+    // Simplification : écart maxi d'un demi pixel avec la ligne complète
+    float tolerance = 0.5/proj->getScale();
+    std::vector <QPoint> pts;
     //---------------------------------------------------------
-    // Dessine les segments
+    // Dessine les polylignes visibles
     //---------------------------------------------------------
-    for (auto const &seg :trace)
+    for (auto const &poly : polylines)
     {
-        // Teste la visibilité (bug clipping sous windows avec pen.setWidthF())
-        if ( proj->isPointVisible(seg->px1, seg->py1)
-                 ||    proj->isPointVisible(seg->px2, seg->py2))
+        for (double dx : {0.0, -360.0, 360.0})
         {
-            proj->map2screen( seg->px1, seg->py1, &a, &b );
-            proj->map2screen( seg->px2, seg->py2, &c, &d );
-            pnt.drawLine(a,b, c,d);
+            // tour du monde ? copie dessinée seulement si elle est visible
+            if (proj->intersect (poly.xmin+dx, poly.xmax+dx, poly.ymin, poly.ymax))
+                drawPolyline (pnt, proj, poly, dx, tolerance, pts);
         }
-        // tour du monde ?
-        if ( proj->isPointVisible(seg->px1-360.0, seg->py1)
-                 ||    proj->isPointVisible(seg->px2-360.0, seg->py2))
-        {
-            proj->map2screen( seg->px1-360.0, seg->py1, &a, &b );
-            proj->map2screen( seg->px2-360.0, seg->py2, &c, &d );
-            pnt.drawLine(a,b, c,d);
+    }
+}
+//---------------------------------------------------------------
+// Dessine une polyligne décalée de dx degrés en ne gardant que
+// les points nécessaires à la précision demandée.
+// Seuls les segments dont une extrémité est visible sont dessinés
+// (bug clipping sous windows avec pen.setWidthF()).
+void IsoLine::drawPolyline (QPainter &pnt, const Projection *proj,
+						const IsoLinePolyline &poly, double dx,
+						float tolerance, std::vector <QPoint> &pts)
+{
+    int a, b;
+    int last = poly.first + poly.count;
+    int prev = -1;
+    bool prevVisible = false;
+    auto flush = [&] {
+        if (pts.size() > 1)
+            pnt.drawPolyline (pts.data(), pts.size());
+        pts.clear();
+    };
+    pts.clear();
+    for (int k=poly.first; k<last; k++)
+    {
+        if (significance[k] < tolerance)
+            continue;
+        bool visible = proj->isPointVisible (lons[k]+dx, lats[k]);
+        if (prev >= 0 && (visible || prevVisible)) {
+            if (pts.empty()) {
+                proj->map2screen (lons[prev]+dx, lats[prev], &a, &b);
+                pts.push_back (QPoint(a,b));
+            }
+            proj->map2screen (lons[k]+dx, lats[k], &a, &b);
+            if (pts.back() != QPoint(a,b))
+                pts.push_back (QPoint(a,b));
+        }
+        else {
+            flush ();
         }
+        prev = k;
+        prevVisible = visible;
     }
+    flush ();
 }
 
 //---------------------------------------------------------------
-void IsoLine::drawIsoLineLabels(QPainter &pnt, std::vector <QRect> &overlap, 
-                            QColor &couleur, const Projection *proj,
-                            int density, int first, double coef,double offset)
+void IsoLine::getLabelsPositions (const Projection *proj,
+                            int density, int first,
+                            std::vector <QPoint> &positions)
 {
-    int   a,b,c,d;
+    int   a,b;
     int nb = first;
-    QString label;
-
-    label = label.sprintf("%d", qRound(value*coef+offset));
-
-    QPen penText(couleur);
-    QFont fontText = Font::getFont(FONT_IsolineLabel);
-    QFontMetrics fmet(fontText);
-    QRect rect = fmet.boundingRect(label);
-    pnt.setPen(penText);
-    pnt.setFont(fontText);
-
-	// use a gradient, because it's a bug sometimes with solid pattern (black background)
-	QLinearGradient gradient;
-    int r = 255;
-	gradient.setColorAt(0, QColor(r,r,r, 170));
-	gradient.setColorAt(1, QColor(r,r,r, 170));
-    pnt.setBrush(gradient);
-
-    //---------------------------------------------------------
-    // Ecrit les labels
-    //---------------------------------------------------------
-    for (auto it=trace.begin(); it!=trace.end(); ++it,nb++)
+    for (auto const &poly : polylines)
     {
-        if (nb % density == 0) {
-            Segment *seg = *it;
-    		rect = fmet.boundingRect(label);
-            proj->map2screen( seg->px1, seg->py1, &a, &b );
-            proj->map2screen( seg->px2, seg->py2, &c, &d );
-            rect.moveTo((a+c)/2-rect.width()/2, (b+d)/2-rect.height()/2);
-            bool o = false;
-            // XXX Bad, linear search
-            for (auto const &r : overlap) {
-                if (r.intersects(rect)) {
-                    o = true;
-                    break;
+        int last = poly.first + poly.count - 1;
+        for (int k=poly.first; k<last; k++, nb++)
+        {
+            if (nb % density != 0)
+                continue;
+            double x = (lons[k]+lons[k+1])/2;
+            double y = (lats[k]+lats[k+1])/2;
+            // tour du monde ?
+            for (double dx : {0.0, -360.0, 360.0})
+            {
+                if (proj->isPointVisible (x+dx, y)) {
+                    proj->map2screen (x+dx, y, &a, &b);
+                    positions.push_back (QPoint(a,b));
                 }
             }
-            if (!o) {
-                pnt.drawRect(rect.x()-1, rect.y(), rect.width()+2, fmet.ascent()+2);
-                pnt.drawText(rect, Qt::AlignHCenter|Qt::AlignVCenter, label);
-                overlap.push_back({rect.x() -rect.width()/2, rect.y() -rect.height()/2, 
-                    rect.width()*2, rect.height()*2});
-                // tour du monde ?
-                proj->map2screen( seg->px1-360.0, seg->py1, &a, &b );
-                proj->map2screen( seg->px2-360.0, seg->py2, &c, &d );
-                rect.moveTo((a+c)/2-rect.width()/2, (b+d)/2-rect.height()/2);
-                pnt.drawRect(rect.x()-1, rect.y(), rect.width()+2, fmet.ascent()+2);
-                pnt.drawText(rect, Qt::AlignHCenter|Qt::AlignVCenter, label);
-            }
         }
     }
 }
 //==================================================================================
-// Segment
+// Extraction des isolignes
 //==================================================================================
-Segment::Segment ( int I, int J,
-				char c1, char c2, char c3, char c4,
-				GriddedRecord *rec, double val,
-				int deltaI, int deltaJ)
+// Carré (ab-cd) de la grille :
+// a  b
+// c  d
+// Les sommets sont numérotés 0=a 1=b 2=c 3=d.
+class IsoLineCell
 {
-	this->deltaI = deltaI;
-	this->deltaJ = deltaJ;
-    traduitCode(I,J, c1, i,j);
-    traduitCode(I,J, c2, k,l);
-    traduitCode(I,J, c3, m,n);
-    traduitCode(I,J, c4, o,p);
+    public:
+        IsoLineCell (const GriddedRecord *rec)
+            : rec(rec), W(rec->getNi()), H(rec->getNj()) {}
 
-    intersectionAreteGrille (i,j, k,l,  &px1,&py1, rec, val);
-    intersectionAreteGrille (m,n, o,p,  &px2,&py2, rec, val);
-}
+        void setCell (int I, int J, int deltaI, int deltaJ,
+                      double a, double b, double c, double d)
+        {
+            ci[0] = I-deltaI;  cj[0] = J-deltaJ;  v[0] = a;
+            ci[1] = I;         cj[1] = J-deltaJ;  v[1] = b;
+            ci[2] = I-deltaI;  cj[2] = J;         v[2] = c;
+            ci[3] = I;         cj[3] = J;         v[3] = d;
+        }
+
+        // Segments d'isoligne de la valeur value qui traversent le carré
+        void addSegments (std::vector <IsoLineSegment> &trace, double value);
+
+    private:
+        const GriddedRecord *rec;
+        int    W, H;
+        int    ci[4], cj[4];
+        double v[4];
+
+        uint64_t edgeKey (int s1, int s2) const
+        {
+            uint64_t n1 = (uint64_t) cj[s1]*W + ci[s1];
+            uint64_t n2 = (uint64_t) cj[s2]*W + ci[s2];
+            if (n1 > n2)
+                std::swap (n1, n2);
+            return n1*((uint64_t) W*H) + n2;
+        }
+        void intersectionAreteGrille (int s1, int s2, double value,
+                                      double *x, double *y) const;
+        void addSegment (std::vector <IsoLineSegment> &trace,
+                         int s1, int s2, int s3, int s4, double value) const
+        {
+            IsoLineSegment seg;
+            seg.e1 = edgeKey (s1, s2);
+            seg.e2 = edgeKey (s3, s4);
+            intersectionAreteGrille (s1, s2, value, &seg.x1, &seg.y1);
+            intersectionAreteGrille (s3, s4, value, &seg.x2, &seg.y2);
+            trace.push_back (seg);
+        }
+};
 //-----------------------------------------------------------------------
-void Segment::intersectionAreteGrille (
-					int i,int j, int k,int l,
-					double *x, double *y,
-					GriddedRecord *rec, double val)
+void IsoLineCell::intersectionAreteGrille (int s1, int s2, double value,
+                                           double *x, double *y) const
 {
-    double xa, xb, ya, yb, pa, pb, dec;
-
-    pa = rec->getValueOnRegularGrid (i,j);
-    pb = rec->getValueOnRegularGrid (k,l);
+    double xa, xb, ya, yb, dec;
+    double pa = v[s1];
+    double pb = v[s2];
 
-    // Abscisse
-    rec->getXY(i, j, &xa, &ya);
-    rec->getXY(k, l, &xb, &yb);
+    rec->getXY(ci[s1], cj[s1], &xa, &ya);
+    rec->getXY(ci[s2], cj[s2], &xb, &yb);
 
     if (pb != pa)
-        dec = (val-pa)/(pb-pa);
+        dec = (value-pa)/(pb-pa);
     else
         dec = 0.5;
     if (fabs(dec)>1)
         dec = 0.5;
     *x = xa+(xb-xa)*dec;
-
-    // Ordonnée
-    if (pb != pa)
-        dec = (val-pa)/(pb-pa);
-    else
-        dec = 0.5;
-    if (fabs(dec)>1)
-        dec = 0.5;
     *y = ya+(yb-ya)*dec;
 }
-//---------------------------------------------------------------
-void Segment::traduitCode (int I, int J, char c1, int &i, int &j) {
-    switch (c1) {
-        case 'a':  i=I-deltaI; j=J-deltaJ; break;
-        case 'b':  i=I;        j=J-deltaJ; break;
-        case 'c':  i=I-deltaI; j=J; break;
-        case 'd':  i=I;        j=J; break;
-        default:   i=I;        j=J;
+//-----------------------------------------------------------------------
+void IsoLineCell::addSegments (std::vector <IsoLineSegment> &trace, double value)
+{
+    double a = v[0], b = v[1], c = v[2], d = v[3];
+
+    if ((a< value && b< value && c< value  && d < value)
+         || (a>value && b>value && c>value  && d > value))
+        return;
+    // Détermine si 1 ou 2 segments traversent la case ab-cd
+    //--------------------------------
+    // 1 segment en diagonale
+    //--------------------------------
+    if     ((a<=value && b<=value && c<=value  && d>value)
+         || (a>value && b>value && c>value  && d<=value))
+        addSegment (trace, 2,3, 1,3, value);
+    else if ((a<=value && c<=value && d<=value  && b>value)
+         || (a>value && c>value && d>value  && b<=value))
+        addSegment (trace, 0,1, 1,3, value);
+    else if ((c<=value && d<=value && b<=value  && a>value)
+         || (c>value && d>value && b>value  && a<=value))
+        addSegment (trace, 0,1, 0,2, value);
+    else if ((a<=value && b<=value && d<=value  && c>value)
+         || (a>value && b>value && d>value  && c<=value))
+        addSegment (trace, 0,2, 2,3, value);
+    //--------------------------------
+    // 1 segment H ou V
+    //--------------------------------
+    else if ((a<=value && b<=value   &&  c>value && d>value)
+         || (a>value && b>value   &&  c<=value && d<=value))
+        addSegment (trace, 0,2, 1,3, value);
+    else if ((a<=value && c<=value   &&  b>value && d>value)
+         || (a>value && c>value   &&  b<=value && d<=value))
+        addSegment (trace, 0,1, 2,3, value);
+    //--------------------------------
+    // 2 segments en diagonale
+    //--------------------------------
+    else if  (a<=value && d<=value   &&  c>value && b>value) {
+        addSegment (trace, 0,1, 1,3, value);
+        addSegment (trace, 0,2, 2,3, value);
+    }
+    else if  (a>value && d>value   &&  c<=value && b<=value) {
+        addSegment (trace, 0,1, 0,2, value);
+        addSegment (trace, 1,3, 2,3, value);
     }
 }
 
 //-----------------------------------------------------------------------
-// Génère la liste des segments. XXXX
-// Les coordonnées sont les indices dans la grille du GriddedRecord
-//---------------------------------------------------------
-void IsoLine::extractIsoLine (GriddedRecord *rec, int deltaI, int deltaJ)
+// Génère les isolignes de toutes les valeurs en un seul parcours de la grille.
+// Les coordonnées sont celles des points de la grille du GriddedRecord
+//-----------------------------------------------------------------------
+void IsoLine::extractIsoLines (std::vector <IsoLine *> *listIsolines,
+						GriddedRecord *rec,
+						double dataMin, double dataMax, double dataStep,
+						int deltaI, int deltaJ)
 {
-    int i, j, W, H;
-    double a,b,c,d;
-    W = rec->getNi();
-    H = rec->getNj();
+    if (dataStep <= 0 || dataMax < dataMin || deltaI < 1 || deltaJ < 1)
+        return;
+    int W = rec->getNi();
+    int H = rec->getNj();
+    if (W < 2 || H < 2)
+        return;
+    int nbLevels = (int) floor ((dataMax-dataMin)/dataStep + 1e-6) + 1;
 
-	for (j=deltaI; j<H; j+=deltaJ)     // !!!! 1 to end
+    // Segments de chaque valeur (tableaux réutilisés pour toute la grille)
+    std::vector < std::vector <IsoLineSegment> > traces (nbLevels);
+    // Valeurs des 2 lignes de la grille qui bordent la rangée de carrés
+    std::vector <double> row0 (W), row1 (W);
+    IsoLineCell cell (rec);
+    int i, j, k, kmin, kmax;
+    double a,b,c,d, vmin,vmax;
+
+    for (i=0; i<W; i+=deltaI)
+        row0[i] = rec->getValueOnRegularGrid (i, 0);
+
+    for (j=deltaJ; j<H; j+=deltaJ)
     {
-        a = rec->getValueOnRegularGrid (deltaI, j-deltaJ );
-        c = rec->getValueOnRegularGrid (deltaI, j  );
-        for (i=deltaI; i<W; i+=deltaI, a =b, c = d )
-        {
-            b = rec->getValueOnRegularGrid (i,        j-deltaJ);
-            d = rec->getValueOnRegularGrid (i,        j  );
+        for (i=0; i<W; i+=deltaI)
+            row1[i] = rec->getValueOnRegularGrid (i, j);
 
+        for (i=deltaI; i<W; i+=deltaI)
+        {
+            a = row0[i-deltaI];
+            b = row0[i];
+            c = row1[i-deltaI];
+            d = row1[i];
             if( a == GRIB_NOTDEF || b == GRIB_NOTDEF || c == GRIB_NOTDEF || d == GRIB_NOTDEF ) continue;
 
-            if ((a< value && b< value && c< value  && d < value)
-                 || (a>value && b>value && c>value  && d > value))
+            // Seules les valeurs comprises entre le min et le max du carré
+            // peuvent le traverser (marge de 1 pour les arrondis)
+            vmin = std::min (std::min(a,b), std::min(c,d));
+            vmax = std::max (std::max(a,b), std::max(c,d));
+            kmin = (int) ceil  ((vmin-dataMin)/dataStep) - 1;
+            kmax = (int) floor ((vmax-dataMin)/dataStep) + 1;
+            if (kmin < 0)
+                kmin = 0;
+            if (kmax > nbLevels-1)
+                kmax = nbLevels-1;
+            if (kmin > kmax)
                 continue;
-            // Détermine si 1 ou 2 segments traversent la case ab-cd
-            // a  b
-            // c  d
-            //--------------------------------
-            // 1 segment en diagonale
-            //--------------------------------
-            if     ((a<=value && b<=value && c<=value  && d>value)
-                 || (a>value && b>value && c>value  && d<=value))
-                trace.push_back(new Segment (i,j, 'c','d',  'b','d',rec,value,deltaI,deltaJ));
-            else if ((a<=value && c<=value && d<=value  && b>value)
-                 || (a>value && c>value && d>value  && b<=value))
-                trace.push_back(new Segment (i,j, 'a','b',  'b','d',rec,value,deltaI,deltaJ));
-            else if ((c<=value && d<=value && b<=value  && a>value)
-                 || (c>value && d>value && b>value  && a<=value))
-                trace.push_back(new Segment (i,j, 'a','b',  'a','c',rec,value,deltaI,deltaJ));
-            else if ((a<=value && b<=value && d<=value  && c>value)
-                 || (a>value && b>value && d>value  && c<=value))
-                trace.push_back(new Segment (i,j, 'a','c',  'c','d',rec,value,deltaI,deltaJ));
-            //--------------------------------
-            // 1 segment H ou V
-            //--------------------------------
-            else if ((a<=value && b<=value   &&  c>value && d>value)
-                 || (a>value && b>value   &&  c<=value && d<=value))
-                trace.push_back(new Segment (i,j, 'a','c',  'b','d',rec,value,deltaI,deltaJ));
-            else if ((a<=value && c<=value   &&  b>value && d>value)
-                 || (a>value && c>value   &&  b<=value && d<=value))
-                trace.push_back(new Segment (i,j, 'a','b',  'c','d',rec,value,deltaI,deltaJ));
-            //--------------------------------
-            // 2 segments en diagonale
-            //--------------------------------
-            else if  (a<=value && d<=value   &&  c>value && b>value) {
-                trace.push_back(new Segment (i,j, 'a','b',  'b','d',rec,value,deltaI,deltaJ));
-                trace.push_back(new Segment (i,j, 'a','c',  'c','d',rec,value,deltaI,deltaJ));
+
+            cell.setCell (i, j, deltaI, deltaJ, a, b, c, d);
+            for (k=kmin; k<=kmax; k++)
+                cell.addSegments (traces[k], dataMin + k*dataStep);
+        }
+        std::swap (row0, row1);
+    }
+
+    for (k=0; k<nbLevels; k++)
+    {
+        if (traces[k].empty())
+            continue;
+        IsoLine *iso = new IsoLine (dataMin + k*dataStep);
+        assert (iso);
+        iso->buildPolylines (traces[k]);
+        listIsolines->push_back (iso);
+    }
+}
+
+//-----------------------------------------------------------------------
+// Relie les segments qui partagent une arête de la grille.
+// Une arête est traversée par 2 segments au plus (1 par carré voisin).
+//-----------------------------------------------------------------------
+void IsoLine::buildPolylines (const std::vector <IsoLineSegment> &segments)
+{
+    int nbseg = segments.size();
+    nbSegments = nbseg;
+
+    std::unordered_map <uint64_t, std::pair<int,int> > edges;
+    edges.reserve (2*nbseg);
+    for (int s=0; s<nbseg; s++)
+    {
+        for (uint64_t e : {segments[s].e1, segments[s].e2}) {
+            auto res = edges.insert (std::make_pair (e, std::make_pair (s, -1)));
+            if (! res.second)
+                res.first->second.second = s;
+        }
+    }
+    // Segment voisin de cur par l'arête e (-1 si aucun)
+    auto neighbour = [&edges] (uint64_t e, int cur) {
+        auto it = edges.find (e);
+        if (it == edges.end())
+            return -1;
+        return (it->second.first == cur) ? it->second.second : it->second.first;
+    };
+
+    std::vector <bool> used (nbseg, false);
+    std::vector <double> backx, backy;
+    lons.reserve (nbseg + nbseg/4);
+    lats.reserve (nbseg + nbseg/4);
+
+    for (int s=0; s<nbseg; s++)
+    {
+        if (used[s])
+            continue;
+        used[s] = true;
+        IsoLinePolyline poly;
+        poly.first = lons.size();
+        poly.closed = false;
+        lons.push_back (segments[s].x1);
+        lats.push_back (segments[s].y1);
+        lons.push_back (segments[s].x2);
+        lats.push_back (segments[s].y2);
+
+        // Vers l'avant à partir de l'arête e2
+        uint64_t edge = segments[s].e2;
+        int cur = s;
+        int next;
+        while ((next = neighbour (edge, cur)) >= 0 && ! used[next])
+        {
+            const IsoLineSegment &seg = segments[next];
+            used[next] = true;
+            if (seg.e1 == edge) {
+                lons.push_back (seg.x2);
+                lats.push_back (seg.y2);
+                edge = seg.e2;
             }
-            else if  (a>value && d>value   &&  c<=value && b<=value) {
-                trace.push_back(new Segment (i,j, 'a','b',  'a','c',rec,value,deltaI,deltaJ));
-                trace.push_back(new Segment (i,j, 'b','d',  'c','d',rec,value,deltaI,deltaJ));
+            else {
+                lons.push_back (seg.x1);
+                lats.push_back (seg.y1);
+                edge = seg.e1;
             }
+            cur = next;
+        }
+        if (edge == segments[s].e1)
+        {
+            // Ligne fermée : le dernier point est le premier
+            poly.closed = true;
+            lons.back() = lons[poly.first];
+            lats.back() = lats[poly.first];
+        }
+        else
+        {
+            // Vers l'arrière à partir de l'arête e1
+            backx.clear();
+            backy.clear();
+            edge = segments[s].e1;
+            cur = s;
+            while ((next = neighbour (edge, cur)) >= 0 && ! used[next])
+            {
+                const IsoLineSegment &seg = segments[next];
+                used[next] = true;
+                if (seg.e1 == edge) {
+                    backx.push_back (seg.x2);
+                    backy.push_back (seg.y2);
+                    edge = seg.e2;
+                }
+                else {
+                    backx.push_back (seg.x1);
+                    backy.push_back (seg.y1);
+                    edge = seg.e1;
+                }
+                cur = next;
+            }
+            lons.insert (lons.begin()+poly.first, backx.rbegin(), backx.rend());
+            lats.insert (lats.begin()+poly.first, backy.rbegin(), backy.rend());
+        }
+        poly.count = lons.size() - poly.first;
+        polylines.push_back (poly);
+    }
 
+    // Rectangle englobant et simplification de chaque polyligne
+    significance.resize (lons.size());
+    for (auto &poly : polylines)
+    {
+        int last = poly.first + poly.count;
+        poly.xmin = poly.xmax = lons[poly.first];
+        poly.ymin = poly.ymax = lats[poly.first];
+        for (int k=poly.first+1; k<last; k++) {
+            poly.xmin = std::min (poly.xmin, lons[k]);
+            poly.xmax = std::max (poly.xmax, lons[k]);
+            poly.ymin = std::min (poly.ymin, lats[k]);
+            poly.ymax = std::max (poly.ymax, lats[k]);
         }
+        LineSimplifier::computeSignificance (&lons[poly.first], &lats[poly.first],
+                                    poly.count, &significance[poly.first]);
     }
 }
@@ -26,7 +26,9 @@ Dessin des données GRIB (avec QT)
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <memory>
 #include <set>
+#include <cstdint>
 
 #include <QPainter>
 
@@ -34,72 +36,77 @@ Dessin des données GRIB (avec QT)
 #include "Projection.h"
 #include "Util.h"
 
-// TODO: join segments and draw a spline
-
 //===============================================================
-// Elément d'isobare qui passe dans un carré (ab-cd)de la grille.
+// Elément d'isoligne qui passe dans un carré (ab-cd) de la grille.
 // a  b
 // c  d
-// Rejoint l'arête (i,j)-(k,l) à l'arête (m,n)-(o,p) (indices ds la grille GRIB)
-class Segment
+// Relie l'intersection avec l'arête e1 à l'intersection avec l'arête e2.
+// Une arête est identifiée par les indices de ses 2 sommets dans la grille,
+// ce qui permet de retrouver les segments voisins.
+struct IsoLineSegment
 {
-    public:
-        Segment ( int I, int J,
-                  char c1, char c2, char c3, char c4,
-                  GriddedRecord *rec, double value,
-				  int deltaI, int deltaJ
-				);
-
-        int   i,j,  k,l;   // arête 1
-        double px1,  py1;   // Coordonées de l'intersection (i,j)-(k,l)
-        int m,n, o,p;      // arête 2
-        double px2,  py2;   // Coordonées de l'intersection (m,n)-(o,p)
+	uint64_t e1, e2;     // arêtes traversées
+	double   x1, y1;     // intersection avec l'arête e1
+	double   x2, y2;     // intersection avec l'arête e2
+};
 
-    private:
-		int deltaI, deltaJ;
-		
-        void traduitCode(int I, int J, char c1, int &i, int &j);
-
-        void intersectionAreteGrille ( 
-					int i,int j, int k,int l,
-					double *x, double *y,
-					GriddedRecord *rec, double value);
+//===============================================================
+// Polyligne : points consécutifs dans les tableaux lons/lats de l'IsoLine
+struct IsoLinePolyline
+{
+	int  first;     // indice du premier point
+	int  count;     // nombre de points
+	bool closed;    // le dernier point est confondu avec le premier
+	double xmin, xmax, ymin, ymax;	// rectangle englobant
 };
 
 //===============================================================
 class IsoLine
 {
     public:
-        IsoLine ( double val,
-				  GriddedRecord *rec,
-				  int deltaI, int deltaJ);  
+        IsoLine (double val);
         ~IsoLine();
 
-
         void drawIsoLine (QPainter &pnt, const Projection *proj);
 
-        void drawIsoLineLabels (QPainter &pnt, std::vector <QRect> &overlap, QColor &couleur, 
-                  const Projection *proj, int density, int first, double coef, double offset);
+        // Positions (écran) possibles des labels : milieu d'un segment sur density
+        void getLabelsPositions (const Projection *proj, int density, int first,
+                  std::vector <QPoint> &positions);
 
-        int getNbSegments()     {return trace.size();}
+        int    getNbSegments()     {return nbSegments;}
+        int    getNbPolylines()    {return polylines.size();}
+        double getValue() const    {return value;}
+
+        //-----------------------------------------------------------------------
+        // Extrait en une seule passe sur la grille les isolignes des valeurs
+        // dataMin, dataMin+dataStep, ..., dataMax.
+        // Les segments sont reliés en polylignes ; les isolignes vides
+        // ne sont pas ajoutées à la liste.
+        //-----------------------------------------------------------------------
+        static void extractIsoLines (std::vector <IsoLine *> *listIsolines,
+						GriddedRecord *rec,
+						double dataMin, double dataMax, double dataStep,
+						int deltaI, int deltaJ);
 
     private:
         double value;
-        int    W, H;     // taille de la grille
-        const  GriddedRecord *rec;
-
         QColor isoLineColor;
-        std::vector <Segment *> trace;
+        int    nbSegments;
 
-        void intersectionAreteGrille (
-						int i,int j, int k,int l, double *x, double *y,
-                        GriddedRecord *rec);
+        std::vector <double> lons, lats;	// points de toutes les polylignes
+        std::vector <float>  significance;	// importance des points (Douglas-Peucker)
+        std::vector <IsoLinePolyline> polylines;
 
-        //-----------------------------------------------------------------------
-        // Génère la liste des segments.
-        // Les coordonnées sont les indices dans la grille du GribRecord
-        //---------------------------------------------------------
-        void extractIsoLine (GriddedRecord *rec, int deltaI, int deltaJ);
+        void buildPolylines (const std::vector <IsoLineSegment> &segments);
+
+        void drawPolyline (QPainter &pnt, const Projection *proj,
+						const IsoLinePolyline &poly, double dx,
+						float tolerance, std::vector <QPoint> &pts);
 };
 
+//===============================================================
+// Isolignes partagées entre le cache et les dessins en cours :
+// elles restent valides tant qu'une liste les contient.
+typedef std::vector <std::shared_ptr <IsoLine> > IsoLineList;
+
 #endif
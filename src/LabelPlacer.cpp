@@ -0,0 +1,98 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include <algorithm>
+
+#include "LabelPlacer.h"
+
+//---------------------------------------------------------------
+LabelPlacer::LabelPlacer (int W, int H, int cellSize)
+{
+    this->W = W;
+    this->H = H;
+    this->cellSize = cellSize>0 ? cellSize : 32;
+    nbCellsX = std::max (1, (W + this->cellSize-1) / this->cellSize);
+    nbCellsY = std::max (1, (H + this->cellSize-1) / this->cellSize);
+    cells.resize (nbCellsX*nbCellsY);
+}
+//---------------------------------------------------------------
+// Cases couvertes par le rectangle (les rectangles qui débordent
+// de l'écran sont rangés dans les cases du bord)
+void LabelPlacer::cellsRange (const QRect &rect,
+                              int *x0, int *y0, int *x1, int *y1) const
+{
+    *x0 = std::min (std::max (rect.left()   / cellSize, 0), nbCellsX-1);
+    *x1 = std::min (std::max (rect.right()  / cellSize, 0), nbCellsX-1);
+    *y0 = std::min (std::max (rect.top()    / cellSize, 0), nbCellsY-1);
+    *y1 = std::min (std::max (rect.bottom() / cellSize, 0), nbCellsY-1);
+}
+//---------------------------------------------------------------
+bool LabelPlacer::isFree (const QRect &rect) const
+{
+    int x0, y0, x1, y1;
+    cellsRange (rect, &x0, &y0, &x1, &y1);
+    for (int cy=y0; cy<=y1; cy++) {
+        for (int cx=x0; cx<=x1; cx++) {
+            for (int n : cells[cy*nbCellsX+cx]) {
+                if (rects[n].intersects (rect))
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+//---------------------------------------------------------------
+void LabelPlacer::reserve (const QRect &rect)
+{
+    int x0, y0, x1, y1;
+    int n = rects.size();
+    rects.push_back (rect);
+    cellsRange (rect, &x0, &y0, &x1, &y1);
+    for (int cy=y0; cy<=y1; cy++) {
+        for (int cx=x0; cx<=x1; cx++) {
+            cells[cy*nbCellsX+cx].push_back (n);
+        }
+    }
+}
+//---------------------------------------------------------------
+bool LabelPlacer::tryPlace (const QRect &rect, const QRect &reserved)
+{
+    if (! isFree (rect))
+        return false;
+    reserve (reserved);
+    return true;
+}
+//---------------------------------------------------------------
+void LabelPlacer::addCandidate (const QRect &rect, const QRect &reserved,
+                                int priority, const LabelDrawer &draw)
+{
+    candidates.push_back ({rect, reserved, priority, draw});
+}
+//---------------------------------------------------------------
+void LabelPlacer::placeCandidates (QPainter &pnt)
+{
+    std::stable_sort (candidates.begin(), candidates.end(),
+            [] (const Candidate &a, const Candidate &b) {
+                return a.priority > b.priority;
+            });
+    for (auto const &cand : candidates) {
+        if (tryPlace (cand.rect, cand.reserved))
+            cand.draw (pnt);
+    }
+    candidates.clear();
+}
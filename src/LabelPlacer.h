@@ -0,0 +1,80 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef LABELPLACER_H
+#define LABELPLACER_H
+
+#include <vector>
+#include <functional>
+
+#include <QRect>
+#include <QPainter>
+
+//===============================================================
+// Placement des étiquettes sur l'écran sans chevauchement.
+// Les rectangles occupés sont rangés dans une grille de cases
+// (hachage spatial) : un test ne regarde que les cases couvertes
+// par le rectangle, quel que soit le nombre d'étiquettes déjà placées.
+// Un même placeur est partagé par toutes les couches d'une image :
+// les candidats de toutes les familles d'étiquettes (extrema, isolignes,
+// données) sont placés ensemble, par priorité.
+//===============================================================
+class LabelPlacer
+{
+    public:
+        enum LabelPriority {
+            PriorityData       = -10,
+            PriorityNormal     = 0,
+            PriorityRoundValue = 10,
+            PriorityExtremum   = 100
+        };
+        typedef std::function <void (QPainter &)> LabelDrawer;
+
+        LabelPlacer (int W, int H, int cellSize=32);
+
+        bool isFree  (const QRect &rect) const;
+        void reserve (const QRect &rect);
+        // Place le rectangle s'il est libre, en occupant la zone reserved
+        bool tryPlace (const QRect &rect, const QRect &reserved);
+        bool tryPlace (const QRect &rect)  {return tryPlace (rect, rect);}
+
+        // Candidats placés ensuite par priorité décroissante
+        // (ordre d'ajout pour une même priorité).
+        void addCandidate (const QRect &rect, const QRect &reserved,
+                           int priority, const LabelDrawer &draw);
+        // Place les candidats et dessine ceux qui ont trouvé une place
+        void placeCandidates (QPainter &pnt);
+
+    private:
+        int W, H;
+        int cellSize;
+        int nbCellsX, nbCellsY;
+        std::vector <QRect> rects;                // zones occupées
+        std::vector < std::vector <int> > cells;  // indices dans rects
+
+        struct Candidate {
+            QRect rect, reserved;
+            int   priority;
+            LabelDrawer draw;
+        };
+        std::vector <Candidate> candidates;
+
+        void cellsRange (const QRect &rect, int *x0, int *y0, int *x1, int *y1) const;
+};
+
+#endif
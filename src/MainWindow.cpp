@@ -1238,7 +1238,8 @@ void MainWindow::slotCreateAnimation()
 	}
 	else
 	{
-		new GribAnimator (terre);
+		delete animator;
+		animator = new GribAnimator (terre);
 	}
 }
 
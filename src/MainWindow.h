@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QApplication>
 #include <QMainWindow>
+#include <QPointer>
 #include <QMouseEvent>
 
 #include "DialogGraphicsParams.h"
@@ -187,6 +188,8 @@ public slots:
         QStatusBar   *statusBar;
 		DateChooser  *dateChooser;
 		ColorScaleWidget *colorScaleWidget;
+		// only one animation: it draws with the plotter of the terrain
+		QPointer <GribAnimator> animator;
 
         QString errorMessage;
         QNetworkReply *reply;
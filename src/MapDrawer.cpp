@@ -17,12 +17,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 
 #include <iostream>
+#include <cmath>
+#include <cstdlib>
 #include <cassert>
 
 #include <QApplication>
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QPainter>
+#include <QDataStream>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
 
 #include "MapDrawer.h"
 #include "LonLatGrid.h"
@@ -34,6 +40,12 @@ MapDrawer::MapDrawer(std::shared_ptr<GshhsReader> gshhsReader)
 {
     imgEarth = nullptr;
     imgAll   = nullptr;
+    earthProj = nullptr;
+    colorMapProj = nullptr;
+    cancelFlag = nullptr;
+    interactive = false;
+    isMapMoved = false;
+    showWaveArrowsType = GRB_TYPE_NOT_DEFINED;
 
     gisReader = std::make_shared<GisReader>();
 
@@ -47,31 +59,86 @@ MapDrawer::MapDrawer(const MapDrawer &model)
 {
     imgEarth = nullptr;
     imgAll   = nullptr;
+    earthProj = nullptr;
+    colorMapProj = nullptr;
+    cancelFlag = nullptr;
+    interactive = false;
+    isMapMoved = false;
+	copySettings (model);
+}
+//---------------------------------------------------------------------
+void MapDrawer::copySettings (const MapDrawer &model)
+{
 	gisReader = model.gisReader;
-    
-	this->gshhsReader = model.gshhsReader;
-	
+	gshhsReader = model.gshhsReader;
+
+	showCitiesNamesLevel = model.showCitiesNamesLevel;
+	showCountriesNames = model.showCountriesNames;
+	showCountriesBorders = model.showCountriesBorders;
+	showRivers = model.showRivers;
+	showLonLatGrid = model.showLonLatGrid;
+
 	colorMapData = model.colorMapData;
 	colorMapSmooth = model.colorMapSmooth;
 	temperatureLabelsAlt = model.temperatureLabelsAlt;
-	windArrowsAltitude   = model.windArrowsAltitude;
-	currentArrowsAltitude   = model.currentArrowsAltitude;
-	//geopotentialData = model.geopotentialData;
-	//showGeopotential = model.showGeopotential;
-	//showGeopotentialLabels = model.showGeopotentialLabels;
-	//geopotentialStep = model.geopotentialStep;
-	//geopotentialMin = model.geopotentialMin;
-	//geopotentialMax = model.geopotentialMax;
+	showTemperatureLabels = model.showTemperatureLabels;
+
+	isobarsStep = model.isobarsStep;
+	showIsobars = model.showIsobars;
+	showIsobarsLabels = model.showIsobarsLabels;
+	showPressureMinMax = model.showPressureMinMax;
+
+	geopotentialData = model.geopotentialData;
+	showGeopotential = model.showGeopotential;
+	showGeopotentialLabels = model.showGeopotentialLabels;
+	geopotentialStep = model.geopotentialStep;
+	geopotentialMin = model.geopotentialMin;
+	geopotentialMax = model.geopotentialMax;
+
+	isotherms0Step = model.isotherms0Step;
+	showIsotherms0 = model.showIsotherms0;
+	showIsotherms0Labels = model.showIsotherms0Labels;
+
+	isotherms_Step = model.isotherms_Step;
+	showIsotherms = model.showIsotherms;
+	showIsotherms_Labels = model.showIsotherms_Labels;
+	isothermsAltitude = model.isothermsAltitude;
+
+	linesThetaE_Step = model.linesThetaE_Step;
+	showLinesThetaE = model.showLinesThetaE;
+	showLinesThetaE_Labels = model.showLinesThetaE_Labels;
+	linesThetaEAltitude = model.linesThetaEAltitude;
+
+	showWindArrows = model.showWindArrows;
+	windArrowsAltitude = model.windArrowsAltitude;
+	showGribGrid = model.showGribGrid;
+	showBarbules = model.showBarbules;
+	showCurrentArrows = model.showCurrentArrows;
+	currentArrowsAltitude = model.currentArrowsAltitude;
 	showWaveArrowsType = model.showWaveArrowsType;
-	
-	initGraphicsParameters();
-	updateGraphicsParameters();
+	showSatelliteImages = model.showSatelliteImages;
+
+	seaColor = model.seaColor;
+	landColor = model.landColor;
+	backgroundColor = model.backgroundColor;
+	windArrowsColor = model.windArrowsColor;
+	currentArrowsColor = model.currentArrowsColor;
+	isobarsPen = model.isobarsPen;
+	geopotentialsPen = model.geopotentialsPen;
+	isotherms0Pen = model.isotherms0Pen;
+	isotherms_Pen = model.isotherms_Pen;
+	linesThetaE_Pen = model.linesThetaE_Pen;
+	seaBordersPen = model.seaBordersPen;
+	boundariesPen = model.boundariesPen;
+	riversPen = model.riversPen;
 }
 //---------------------------------------------------------------------
 MapDrawer::~MapDrawer()
 {
     delete imgAll;
     delete imgEarth;
+    delete earthProj;
+    delete colorMapProj;
 }
 
 //===========================================================
@@ -213,50 +280,106 @@ void MapDrawer::draw_Map_Background(bool isEarthMapValid, Projection *proj)
 {
 
     delete imgAll;
-	imgAll = new QPixmap(proj->getW(), proj->getH());
+	imgAll = new QImage(proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
 	assert(imgAll);
 
 	QPainter pnt(imgAll);
 	pnt.setRenderHint(QPainter::Antialiasing, true);
 
-	if (!isEarthMapValid)
+	QPoint shift;
+	if (isMapMoved && imgEarth!=nullptr && getMapShift (earthProj, proj, &shift))
+	{
+		// only the uncovered parts of the moved map
+		QRegion strips = shiftImage (imgEarth, shift);
+        if (gshhsReader.get() != nullptr && !strips.isEmpty())
+		{
+			QPainter pnt1(imgEarth);
+			pnt1.setClipRegion(strips);
+			draw_Map_Earth(pnt1, proj);
+		}
+	}
+	else if (!isEarthMapValid || imgEarth==nullptr)
 	{
 
         delete imgEarth;
-		imgEarth = new QPixmap(proj->getW(), proj->getH());
+		imgEarth = new QImage(proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
 		assert(imgEarth);
+		imgEarth->fill(Qt::transparent);
 
         if (gshhsReader.get() != nullptr)
 		{
 			QPainter pnt1(imgEarth);
-			pnt1.setRenderHint(QPainter::Antialiasing, false);
-			gshhsReader.get()->drawBackground(pnt1, proj, seaColor, backgroundColor);
-			gshhsReader.get()->drawContinents(pnt1, proj, seaColor, landColor);
+			draw_Map_Earth(pnt1, proj);
 		}
 	}
-	pnt.drawPixmap(0,0, *imgEarth);
+	delete earthProj;
+	earthProj = proj->clone();
+	pnt.drawImage(0,0, *imgEarth);
+}
+//----------------------------------------------------------------------
+// Translation (integer number of pixels) from the map of oldProj to the
+// map of proj, if this is the only difference between the projections.
+bool MapDrawer::getMapShift (const Projection *oldProj, const Projection *proj,
+							 QPoint *shift)
+{
+	if (oldProj == nullptr
+			|| oldProj->getProjection() != proj->getProjection()
+			|| oldProj->getScale() != proj->getScale()
+			|| oldProj->getW() != proj->getW() || oldProj->getH() != proj->getH())
+		return false;
+	double x0,y0, x1,y1;
+	oldProj->getScreenOrigin (&x0, &y0);
+	proj->getScreenOrigin (&x1, &y1);
+	double dx = x0-x1;
+	double dy = y0-y1;
+	if (fabs(dx-qRound(dx)) > 1e-3 || fabs(dy-qRound(dy)) > 1e-3)
+		return false;
+	*shift = QPoint (qRound(dx), qRound(dy));
+	return abs(shift->x()) < proj->getW() && abs(shift->y()) < proj->getH();
+}
+//----------------------------------------------------------------------
+// Moves the content of the image; returns the uncovered region.
+QRegion MapDrawer::shiftImage (QImage *img, const QPoint &shift)
+{
+	QImage old = *img;
+	img->fill (Qt::transparent);
+	QPainter pnt (img);
+	pnt.setCompositionMode (QPainter::CompositionMode_Source);
+	pnt.drawImage (shift, old);
+	return QRegion (img->rect()) - QRegion (img->rect().translated(shift));
 }
 //----------------------------------------------------------------------
-void MapDrawer::draw_Map_Foreground(QPainter &pnt, Projection *proj)
+void MapDrawer::draw_Map_Earth(QPainter &pnt, Projection *proj)
+{
+	pnt.setRenderHint(QPainter::Antialiasing, false);
+	gshhsReader.get()->drawBackground(pnt, proj, seaColor, backgroundColor);
+	gshhsReader.get()->drawContinents(pnt, proj, seaColor, landColor, interactive ? 4 : 1);
+}
+//----------------------------------------------------------------------
+void MapDrawer::draw_Map_Foreground(QPainter &pnt, Projection *proj, bool withNames)
 {
     if (gshhsReader.get() != nullptr)
 	{
+		double lod = interactive ? 4 : 1;
 		pnt.setPen(seaBordersPen);
-		gshhsReader.get()->drawSeaBorders(pnt, proj);
+		gshhsReader.get()->drawSeaBorders(pnt, proj, lod);
 
 		if (showCountriesBorders) {
 			pnt.setPen(boundariesPen);
-			gshhsReader.get()->drawBoundaries(pnt, proj);
+			gshhsReader.get()->drawBoundaries(pnt, proj, lod);
 		}
 		if (showRivers) {
 			pnt.setPen(riversPen);
-			gshhsReader.get()->drawRivers(pnt, proj);
+			gshhsReader.get()->drawRivers(pnt, proj, lod);
 		}
 	}
 	if (showLonLatGrid) {
 		LonLatGrid gr;
 		gr.drawLonLatGrid(pnt, proj);
 	}
+	if (!withNames || interactive) {
+		return;
+	}
 	if (showCountriesNames) {
 		gisReader.get()->drawCountriesNames(pnt, proj);
 	}
@@ -280,17 +403,23 @@ void MapDrawer::draw_GSHHS (
 		// Dessin du fond de carte
 		//===================================================
 		draw_Map_Background (isEarthMapValid, proj);
+		if (isCanceled())
+			return;
+		for (int layer=0; layer<LAYER_FOREGROUND; layer++)
+			dropLayer (layer);		// no gridded data
 		QPainter pnt (imgAll);
 		pnt.setRenderHint (QPainter::Antialiasing, true);
 		if (showSatelliteImages)
 			drawSatelliteData(pnt, proj, SatellitePlotter);
+		if (isCanceled())
+			return;
 		//===================================================
 		// Dessin des bordures et frontières
 		//===================================================
-		draw_Map_Foreground (pnt, proj);
+		draw_ForegroundLayer (pnt, proj, isEarthMapValid);
     }
     // Recopie l'image complète
-    pntGlobal.drawPixmap (0,0, *imgAll);
+    pntGlobal.drawImage (0,0, *imgAll);
 }
 
 //=======================================================================
@@ -311,6 +440,8 @@ void MapDrawer::draw_GSHHS_and_GriddedData (
 		// Dessin du fond de carte
 		//===================================================
 		draw_Map_Background (isEarthMapValid, proj);
+		if (isCanceled())
+			return;
 		//===================================================
 		// Dessin des données Meteo
 		//===================================================
@@ -318,21 +449,25 @@ void MapDrawer::draw_GSHHS_and_GriddedData (
 		pnt.setRenderHint (QPainter::Antialiasing, true);
 		if (showSatelliteImages)
 			drawSatelliteData(pnt, proj, SatellitePlotter);
-		draw_MeteoData_Gridded (pnt, proj, plotter);
+		if (isCanceled())
+			return;
+		draw_MeteoData_Gridded (pnt, proj, plotter, true, true);
+		if (isCanceled())
+			return;
 
 		//===================================================
 		// Dessin des bordures et frontières
 		//===================================================
-		draw_Map_Foreground(pnt, proj);
+		draw_ForegroundLayer (pnt, proj, isEarthMapValid);
 
 		//===================================================
 		// Cartouche
 		//===================================================
-		if (drawCartouche)
+		if (drawCartouche && !interactive)
 			draw_Cartouche_Gridded (pnt, proj, plotter);
     }
     // Recopie l'image complète
-    pntGlobal.drawPixmap(0,0, *imgAll);
+    pntGlobal.drawImage(0,0, *imgAll);
 }
 //===================================================================
 void MapDrawer::addUsedDataCenterModel (const DataCode &dtc, GriddedPlotter *plotter)
@@ -349,14 +484,243 @@ void MapDrawer::addUsedDataCenterModel (const DataCode &dtc, GriddedPlotter *plo
 	}
 }
 //===================================================================
+// Layers of the complete map
+//===================================================================
+// Key of a layer: the values its image depends on.
+class LayerKey
+{
+	public:
+		LayerKey () : stream (&bytes, QIODevice::WriteOnly) {}
+		
+		LayerKey & operator<< (bool v)    {stream << v; return *this;}
+		LayerKey & operator<< (int v)     {stream << (qint32) v; return *this;}
+		LayerKey & operator<< (double v)  {stream << v; return *this;}
+		LayerKey & operator<< (const QColor &v)  {stream << v; return *this;}
+		LayerKey & operator<< (const QPen &v)    {stream << v; return *this;}
+		LayerKey & operator<< (const void *v)
+						{stream << (quint64) (quintptr) v; return *this;}
+		LayerKey & operator<< (const Altitude &alt)
+						{stream << (qint32) alt.levelType << (qint32) alt.levelValue; return *this;}
+		LayerKey & operator<< (const DataCode &dtc)
+						{return *this << dtc.dataType << dtc.getAltitude();}
+		
+		// Size and scale of the map
+		LayerKey & addProjection (const Projection *proj, bool withOrigin=true)
+		{
+			*this << proj->getProjection() << proj->getW() << proj->getH() << proj->getScale();
+			if (withOrigin) {
+				double x0, y0;
+				proj->getScreenOrigin (&x0, &y0);
+				*this << x0 << y0;
+			}
+			return *this;
+		}
+		// Data at the current date
+		LayerKey & addData (GriddedPlotter *plotter)
+		{
+			stream << (qint64) plotter->getCurrentDate();
+			return *this << plotter << plotter->getReader();
+		}
+		
+		const QByteArray & get () const   {return bytes;}
+		
+	private:
+		QByteArray  bytes;
+		QDataStream stream;
+};
+//-------------------------------------------------------------------
+// Draws the layer again if its key changed, then adds it to the map.
+void MapDrawer::drawLayer (QPainter &pnt, Projection *proj,
+						   int layer, const QByteArray &key,
+						   const std::function <void (QPainter &)> &draw)
+{
+	MapLayer &ml = layers [layer];
+	if (ml.key != key || ml.image.isNull())
+	{
+		ml.image = QImage (proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
+		ml.image.fill (Qt::transparent);
+		{
+			QPainter pnt1 (&ml.image);
+			pnt1.setRenderHint (QPainter::Antialiasing, true);
+			draw (pnt1);
+		}
+		ml.key = isCanceled() ? QByteArray() : key;	// incomplete image
+	}
+	pnt.drawImage (0,0, ml.image);
+}
+//-------------------------------------------------------------------
+void MapDrawer::dropLayer (int layer)
+{
+	layers [layer].key.clear ();
+	layers [layer].image = QImage ();
+}
+//-------------------------------------------------------------------
+void MapDrawer::clearLayers ()
+{
+	for (int layer=0; layer<NB_LAYERS; layer++)
+		dropLayer (layer);
+}
+//-------------------------------------------------------------------
+// Queues the layer if its key changed.
+void MapDrawer::queueLayer (Projection *proj, int layer, const QByteArray &key,
+							const LayerDrawer &draw)
+{
+	MapLayer &ml = layers [layer];
+	if (ml.key == key && !ml.image.isNull())
+		return;
+	ml.image = QImage (proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
+	ml.image.fill (Qt::transparent);
+	ml.key.clear ();		// until the job is done
+	layerJobs.push_back ({layer, key, QRegion(), draw});
+}
+//-------------------------------------------------------------------
+// Color map: when the map is only moved, the image is shifted
+// and only the uncovered strips are queued.
+void MapDrawer::queueColorMapLayer (Projection *proj,
+									GriddedPlotter *plotter, const QByteArray &key)
+{
+	MapLayer &ml = layers [LAYER_COLORMAP];
+	QPoint shift;
+	bool sameMap = ml.key == key && !ml.image.isNull()
+						&& getMapShift (colorMapProj, proj, &shift);
+	delete colorMapProj;
+	colorMapProj = proj->clone();
+	if (sameMap && shift.isNull())
+		return;
+	QRegion strips;
+	if (sameMap) {
+		strips = shiftImage (&ml.image, shift);
+	}
+	else {
+		ml.image = QImage (proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
+		ml.image.fill (Qt::transparent);
+	}
+	ml.key.clear ();
+	DataCode dtc = colorMapData;
+	bool smooth = colorMapSmooth;
+	layerJobs.push_back ({LAYER_COLORMAP, key, strips,
+		[plotter, dtc, smooth] (QPainter &p, const Projection *prj) {
+			p.setRenderHint (QPainter::Antialiasing, false);
+			plotter->draw_CoveredZone (p, prj);
+			plotter->draw_ColoredMapPlain (dtc, smooth, p, prj);
+		}});
+}
+//-------------------------------------------------------------------
+class LayerRunnable : public QRunnable
+{
+	public:
+		LayerRunnable (const MapDrawer *drawer,
+					   const std::function <void ()> &task, QSemaphore *done)
+			: drawer (drawer), task (task), done (done) {}
+		void run () override
+		{
+			// the job may wait in the pool after the cancellation
+			if (! drawer->isCanceled())
+				task ();
+			done->release ();
+		}
+	private:
+		const MapDrawer *drawer;
+		std::function <void ()> task;
+		QSemaphore *done;
+};
+//-------------------------------------------------------------------
+// Draws the queued layers: the first one in the calling thread,
+// the others in the global thread pool.
+// A PJ object of libproj can't be shared between threads:
+// each job of the pool uses its own clone of the projection.
+void MapDrawer::runLayerJobs (Projection *proj)
+{
+	auto drawJob = [this] (const LayerJob &job, const Projection *prj) {
+		QPainter pnt (&layers [job.layer].image);
+		pnt.setRenderHint (QPainter::Antialiasing, true);
+		if (! job.clip.isEmpty())
+			pnt.setClipRegion (job.clip);
+		job.draw (pnt, prj);
+	};
+	QSemaphore done;
+	std::vector <Projection *> projs;
+	for (size_t k=1; k<layerJobs.size(); k++)
+	{
+		const LayerJob *job = &layerJobs [k];
+		Projection *prj = proj->clone();
+		projs.push_back (prj);
+		QThreadPool::globalInstance()->start (new LayerRunnable (this,
+					[&drawJob, job, prj] { drawJob (*job, prj); }, &done));
+	}
+	if (! layerJobs.empty())
+		drawJob (layerJobs [0], proj);
+	done.acquire ((int) projs.size());
+	
+	for (Projection *prj : projs)
+		delete prj;
+	for (const LayerJob &job : layerJobs)
+		layers [job.layer].key = isCanceled() ? QByteArray() : job.key;
+	layerJobs.clear ();
+}
+//-------------------------------------------------------------------
+// While the color map is drawn entirely again, coarser maps are
+// shown first: color blocks of 8 pixels, then of 4 pixels.
+// The other layers are added when their image is still valid.
+void MapDrawer::drawColorMapPreviews (Projection *proj, GriddedPlotter *plotter)
+{
+	if (! previewFunction || interactive || layerJobs.empty()
+			|| layerJobs[0].layer != LAYER_COLORMAP || !layerJobs[0].clip.isEmpty())
+		return;
+	bool withForeground = layers [LAYER_FOREGROUND].key == getForegroundKey (proj)
+							&& !layers [LAYER_FOREGROUND].image.isNull();
+	for (int step : {8, 4})
+	{
+		if (isCanceled())
+			return;
+		QImage preview = imgAll->copy();		// earth and satellite
+		{
+			QPainter pnt (&preview);
+			plotter->setColorMapStep (step);
+			layerJobs[0].draw (pnt, proj);
+			plotter->setColorMapStep (0);
+			for (int id=LAYER_COLORMAP+1; id<NB_LAYERS; id++) {
+				if (id == LAYER_FOREGROUND && !withForeground)
+					continue;
+				if (! layers [id].image.isNull())		// empty when queued
+					pnt.drawImage (0,0, layers [id].image);
+			}
+		}
+		if (! isCanceled())
+			previewFunction (preview);
+	}
+}
+//-------------------------------------------------------------------
+QByteArray MapDrawer::getForegroundKey (const Projection *proj) const
+{
+	LayerKey key;
+	key.addProjection (proj) << interactive
+		<< showCountriesBorders << showRivers << showLonLatGrid
+		<< showCountriesNames << showCitiesNamesLevel
+		<< seaBordersPen << boundariesPen << riversPen;
+	return key.get();
+}
+//-------------------------------------------------------------------
+// Borders, rivers, grid and names
+void MapDrawer::draw_ForegroundLayer (QPainter &pnt, Projection *proj,
+									  bool isEarthMapValid)
+{
+	if (! isEarthMapValid)
+		layers [LAYER_FOREGROUND].key.clear ();		// GSHHS quality
+	drawLayer (pnt, proj, LAYER_FOREGROUND, getForegroundKey (proj),
+			   [&] (QPainter &p) { draw_Map_Foreground (p, proj); });
+}
+//===================================================================
 // Draw gridded data
 //===================================================================
 void MapDrawer::draw_MeteoData_Gridded 
 			( QPainter &pnt, Projection *proj,
-			GriddedPlotter   *plotter )
+			GriddedPlotter   *plotter,
+			bool withLabels,
+			bool useLayers )
 {
 	setUsedDataCenters.clear ();
-	plotter->draw_CoveredZone (pnt, proj);
+	plotter->setInteractiveRendering (interactive);
 	
 	Altitude mapAltitude =  colorMapData.getAltitude ();
 	
@@ -484,18 +848,46 @@ void MapDrawer::draw_MeteoData_Gridded
 			break;
 	}
 	
+	//-------------------------------------------------------
+	// Each layer is drawn in its own cached image (complete map),
+	// or directly (tiles, animation).
+	//-------------------------------------------------------
+	layerJobs.clear ();
+	auto layer = [&] (int id, const LayerKey &key, const LayerDrawer &draw) {
+		if (useLayers)
+			queueLayer (proj, id, key.get(), draw);
+		else
+			draw (pnt, proj);
+	};
+	auto noLayer = [&] (int id) {
+		if (useLayers)
+			dropLayer (id);
+	};
+	
 	//-------------------------------------------------------
 	// draw complete colored map
 	//-------------------------------------------------------
-	plotter->draw_ColoredMapPlain (colorMapData, colorMapSmooth,pnt,proj);
 	addUsedDataCenterModel (colorMapData, plotter);
+	if (useLayers) {
+		LayerKey key;
+		key.addProjection (proj, false).addData (plotter) << interactive
+			<< colorMapData << colorMapSmooth
+			<< plotter->getUseJetStreamColorMap() << plotter->getUseGustColorAbsolute();
+		queueColorMapLayer (proj, plotter, key.get());
+	}
+	else {
+		plotter->draw_CoveredZone (pnt, proj);
+		plotter->draw_ColoredMapPlain (colorMapData, colorMapSmooth,pnt,proj);
+	}
+	if (isCanceled())
+		return;
 	//-------------------------------------------------------
 
-	std::vector <IsoLine *> listIsobars;
-	std::vector <IsoLine *> listIsotherms0;
-	std::vector <IsoLine *> listGeopotential;
-	std::vector <IsoLine *> listIsotherms;
-	std::vector <IsoLine *> listLinesThetaE;
+	IsoLineList listIsobars;
+	IsoLineList listIsotherms0;
+	IsoLineList listGeopotential;
+	IsoLineList listIsotherms;
+	IsoLineList listLinesThetaE;
 
 	if (! plotter->hasData (GRB_PRESSURE_MSL,LV_MSL,0))
 		showIsobars = false;
@@ -508,131 +900,192 @@ void MapDrawer::draw_MeteoData_Gridded
 	if (! plotter->hasData (GRB_PRV_THETA_E,linesThetaEAltitude))
 		showLinesThetaE = false;
 
-	if (showIsobars) {
-		pnt.setPen (isobarsPen);
-		DataCode dtc (GRB_PRESSURE_MSL,LV_MSL,0);
-		addUsedDataCenterModel (dtc, plotter);
-		plotter->complete_listIsolines (&listIsobars, dtc,
-						   84000, 112000, isobarsStep*100, proj);
-        plotter->draw_listIsolines (listIsobars, pnt,proj);
-	}
-
-	if (showIsotherms0) {
-		pnt.setPen (isotherms0Pen);
-		DataCode dtc (GRB_GEOPOT_HGT,LV_ISOTHERM0,0);
-		addUsedDataCenterModel (dtc, plotter);
-		plotter->complete_listIsolines (&listIsotherms0, dtc,
-						   0, 15000, isotherms0Step, proj);
-        plotter->draw_listIsolines (listIsotherms0, pnt,proj);
-	}
-
-	if (showGeopotential) {
-        pnt.setPen (geopotentialsPen);
-        addUsedDataCenterModel(geopotentialData, plotter);
-		plotter->complete_listIsolines (&listGeopotential,
-						   geopotentialData,
-						   geopotentialMin, geopotentialMax, geopotentialStep, proj);
-        plotter->draw_listIsolines (listGeopotential, pnt,proj);
-	}
-	
-	if (showIsotherms) {
-		pnt.setPen (isotherms_Pen);
-		DataCode dtc (GRB_TEMP,isothermsAltitude);
-		addUsedDataCenterModel (dtc, plotter);
-		plotter->complete_listIsolines (&listIsotherms, dtc,
-						   -140+273.15, 80+273.15, isotherms_Step, proj);
-        plotter->draw_listIsolines (listIsotherms, pnt,proj);
-	}
-	
-	if (showLinesThetaE) {
-		pnt.setPen (linesThetaE_Pen);
-		DataCode dtc (GRB_PRV_THETA_E,linesThetaEAltitude);
+	// The lists are also used by the labels: they are always computed
+	// (cheap when the isolines are in the plotter cache).
+	auto isolinesLayer = [&] (int id, bool show, IsoLineList *list,
+							  const DataCode &dtc, double min, double max, double step,
+							  const QPen &pen) {
+		if (! show) {
+			noLayer (id);
+			return;
+		}
 		addUsedDataCenterModel (dtc, plotter);
-		plotter->complete_listIsolines (&listLinesThetaE, dtc,
-						   -80+273.15, 140+273.15, linesThetaE_Step, proj);
-        plotter->draw_listIsolines (listLinesThetaE, pnt,proj);
-	}
+		plotter->complete_listIsolines (list, dtc, min, max, step, proj);
+		LayerKey key;
+		key.addProjection (proj).addData (plotter) << interactive
+			<< dtc << min << max << step << pen;
+		layer (id, key, [plotter, list, pen] (QPainter &p, const Projection *prj) {
+			p.setPen (pen);
+			plotter->draw_listIsolines (*list, p, prj);
+		});
+	};
+	isolinesLayer (LAYER_ISOBARS, showIsobars, &listIsobars,
+				   DataCode (GRB_PRESSURE_MSL,LV_MSL,0),
+				   84000, 112000, isobarsStep*100, isobarsPen);
+	isolinesLayer (LAYER_ISOTHERMS0, showIsotherms0, &listIsotherms0,
+				   DataCode (GRB_GEOPOT_HGT,LV_ISOTHERM0,0),
+				   0, 15000, isotherms0Step, isotherms0Pen);
+	isolinesLayer (LAYER_GEOPOTENTIAL, showGeopotential, &listGeopotential,
+				   geopotentialData,
+				   geopotentialMin, geopotentialMax, geopotentialStep, geopotentialsPen);
+	isolinesLayer (LAYER_ISOTHERMS, showIsotherms, &listIsotherms,
+				   DataCode (GRB_TEMP,isothermsAltitude),
+				   -140+273.15, 80+273.15, isotherms_Step, isotherms_Pen);
+	isolinesLayer (LAYER_THETAE, showLinesThetaE, &listLinesThetaE,
+				   DataCode (GRB_PRV_THETA_E,linesThetaEAltitude),
+				   -80+273.15, 140+273.15, linesThetaE_Step, linesThetaE_Pen);
 
+	if (isCanceled())
+		return;
+	//===================================================
+	// Arrows
+	//===================================================
 	if (showWaveArrowsType != GRB_TYPE_NOT_DEFINED && hasWaveForArrows) {
-		plotter->draw_WAVES_Arrows (showWaveArrowsType, pnt, proj);
+		LayerKey key;
+		key.addProjection (proj).addData (plotter) << interactive
+			<< showWaveArrowsType;
+		layer (LAYER_WAVES_ARROWS, key, [=] (QPainter &p, const Projection *prj) {
+			plotter->draw_WAVES_Arrows (showWaveArrowsType, p, prj);
+		});
 	}
+	else
+		noLayer (LAYER_WAVES_ARROWS);
 	
 	if (showWindArrows && hasWindForArrows) {
-		plotter->draw_WIND_Arrows (windArrowsAltitude, showBarbules, windArrowsColor, pnt, proj);
+		LayerKey key;
+		key.addProjection (proj).addData (plotter) << interactive
+			<< windArrowsAltitude << showBarbules << windArrowsColor;
+		layer (LAYER_WIND_ARROWS, key, [=] (QPainter &p, const Projection *prj) {
+			plotter->draw_WIND_Arrows (windArrowsAltitude, showBarbules, windArrowsColor, p, prj);
+		});
 	}
+	else
+		noLayer (LAYER_WIND_ARROWS);
+	
 	if (showCurrentArrows && hasCurrentForArrows) {
-		plotter->draw_CURRENT_Arrows (currentArrowsAltitude, currentArrowsColor, pnt, proj);
+		LayerKey key;
+		key.addProjection (proj).addData (plotter) << interactive
+			<< currentArrowsAltitude << currentArrowsColor;
+		layer (LAYER_CURRENT_ARROWS, key, [=] (QPainter &p, const Projection *prj) {
+			plotter->draw_CURRENT_Arrows (currentArrowsAltitude, currentArrowsColor, p, prj);
+		});
 	}
+	else
+		noLayer (LAYER_CURRENT_ARROWS);
 
-	if (showIsobarsLabels && showIsobars) {
-		QColor color (40,40,40);
-        plotter->draw_listIsolines_labels (listIsobars, 0.01,0, color, pnt,proj);
-	}
-	if (showIsotherms0Labels && showIsotherms0) {
-		QColor color(200,80,80);
-		DataCode dtc (GRB_GEOPOT_HGT,LV_ISOTHERM0,0);
-		addUsedDataCenterModel (dtc, plotter);
-		double coef = Util::getDataCoef (dtc);
-        plotter->draw_listIsolines_labels (listIsotherms0, coef,0, color, pnt,proj);
-	}
-	if (showGeopotentialLabels && showGeopotential) {
-        QColor color(200,80,80);
-		addUsedDataCenterModel (geopotentialData, plotter);
-		double coef = Util::getDataCoef (geopotentialData);
-        plotter->draw_listIsolines_labels (listGeopotential, coef,0, color, pnt,proj);
-	}
-	if (showIsotherms_Labels && showIsotherms) {
-		QColor color(40,40,150); 
-        plotter->draw_listIsolines_labels (listIsotherms,
-										1.,-273.15,
-										color, pnt,proj, 
-										16	// TODO: labels density
-										);
-	} 
-	if (showLinesThetaE_Labels && showLinesThetaE) {
-		QColor color(40,40,150); 
-        plotter->draw_listIsolines_labels (listLinesThetaE,
-										1.,-273.15,
-										color, pnt,proj, 
-										16	// TODO: labels density
-										);
-	} 
-
-	if (showPressureMinMax) {
-		DataCode dtc (GRB_PRESSURE_MSL,LV_MSL,0);
-		addUsedDataCenterModel (dtc, plotter);
-		plotter->draw_DATA_MinMax ( 
-						dtc, 101200, "L", "H",
-						Font::getFont(FONT_GRIB_PressHL),
-						QColor(0,0,0), pnt, proj);
-	}
-	if (showTemperatureLabels ) {
+	if (isCanceled())
+		return;
+	//===================================================
+	// Labels : extrema first, then isolines, then data
+	// (one layer: all the labels are placed together)
+	//===================================================
+	if (withLabels && !interactive)
+	{
+		bool isobarsLabels = showIsobarsLabels && showIsobars;
+		bool isotherms0Labels = showIsotherms0Labels && showIsotherms0;
+		bool geopotentialLabels = showGeopotentialLabels && showGeopotential;
+		bool isothermsLabels = showIsotherms_Labels && showIsotherms;
+		bool linesThetaELabels = showLinesThetaE_Labels && showLinesThetaE;
 		auto dataType = colorMapData.dataType == GRB_WTMP?GRB_WTMP:GRB_TEMP;
-
-		DataCode dtc (dataType, temperatureLabelsAlt);
-		if (plotter->hasData (dtc)) {
-			addUsedDataCenterModel (dtc, plotter);
-			plotter->draw_DATA_Labels (
-					dtc, Font::getFont(FONT_GRIB_Temp),
-					QColor(0,0,0),
-					Util::formatTemperature_short, pnt, proj);
-		}
+		DataCode dtcTemp (dataType, temperatureLabelsAlt);
+		bool temperatureLabels = showTemperatureLabels && plotter->hasData (dtcTemp);
+		
+		if (showPressureMinMax)
+			addUsedDataCenterModel (DataCode (GRB_PRESSURE_MSL,LV_MSL,0), plotter);
+		if (isotherms0Labels)
+			addUsedDataCenterModel (DataCode (GRB_GEOPOT_HGT,LV_ISOTHERM0,0), plotter);
+		if (geopotentialLabels)
+			addUsedDataCenterModel (geopotentialData, plotter);
+		if (temperatureLabels)
+			addUsedDataCenterModel (dtcTemp, plotter);
+		
+		LayerKey key;
+		key.addProjection (proj).addData (plotter)
+			<< showPressureMinMax
+			<< isobarsLabels << isobarsStep
+			<< isotherms0Labels << isotherms0Step
+			<< geopotentialLabels << geopotentialData
+				<< geopotentialMin << geopotentialMax << geopotentialStep
+			<< isothermsLabels << isothermsAltitude << isotherms_Step
+			<< linesThetaELabels << linesThetaEAltitude << linesThetaE_Step
+			<< temperatureLabels << dtcTemp;
+		layer (LAYER_LABELS, key, [=, &listIsobars, &listIsotherms0, &listGeopotential,
+									&listIsotherms, &listLinesThetaE]
+									(QPainter &p, const Projection *prj) {
+			LabelPlacer placer (prj->getW(), prj->getH());
+		
+			if (showPressureMinMax) {
+				DataCode dtc (GRB_PRESSURE_MSL,LV_MSL,0);
+				plotter->draw_DATA_MinMax ( 
+								dtc, 101200, "L", "H",
+								Font::getFont(FONT_GRIB_PressHL),
+								QColor(0,0,0), prj, placer);
+			}
+			if (isobarsLabels) {
+				QColor color (40,40,40);
+				plotter->draw_listIsolines_labels (listIsobars, 0.01,0, color, prj, placer);
+			}
+			if (isotherms0Labels) {
+				QColor color(200,80,80);
+				DataCode dtc (GRB_GEOPOT_HGT,LV_ISOTHERM0,0);
+				double coef = Util::getDataCoef (dtc);
+				plotter->draw_listIsolines_labels (listIsotherms0, coef,0, color, prj, placer);
+			}
+			if (geopotentialLabels) {
+				QColor color(200,80,80);
+				double coef = Util::getDataCoef (geopotentialData);
+				plotter->draw_listIsolines_labels (listGeopotential, coef,0, color, prj, placer);
+			}
+			if (isothermsLabels) {
+				QColor color(40,40,150); 
+				plotter->draw_listIsolines_labels (listIsotherms,
+												1.,-273.15,
+												color, prj, placer,
+												16	// TODO: labels density
+												);
+			} 
+			if (linesThetaELabels) {
+				QColor color(40,40,150); 
+				plotter->draw_listIsolines_labels (listLinesThetaE,
+												1.,-273.15,
+												color, prj, placer,
+												16	// TODO: labels density
+												);
+			} 
+			if (temperatureLabels) {
+				plotter->draw_DATA_Labels (
+						dtcTemp, Font::getFont(FONT_GRIB_Temp),
+						QColor(0,0,0),
+						Util::formatTemperature_short, prj, placer);
+			}
+			// all the families together, by priority
+			placer.placeCandidates (p);
+		});
 	}
+	else
+		noLayer (LAYER_LABELS);
 
 	//===================================================
 	// Grille
 	//===================================================
 	if (showGribGrid) {
-		pnt.setPen(QColor (40,40,40));
-		plotter->draw_GridPoints (colorMapData, pnt, proj);
+		LayerKey key;
+		key.addProjection (proj).addData (plotter) << colorMapData;
+		layer (LAYER_GRID_POINTS, key, [=] (QPainter &p, const Projection *prj) {
+			p.setPen(QColor (40,40,40));
+			plotter->draw_GridPoints (colorMapData, p, prj);
+		});
+	}
+	else
+		noLayer (LAYER_GRID_POINTS);
+	
+	if (useLayers) {
+		drawColorMapPreviews (proj, plotter);
+		runLayerJobs (proj);
+		for (int id=0; id<LAYER_FOREGROUND; id++)
+			if (! layers [id].image.isNull())
+				pnt.drawImage (0,0, layers [id].image);
 	}
-
-	// cleanup
-	for (auto const &it :listIsobars) { delete it;}
-	for (auto const &it :listIsotherms0) { delete it;}
-	for (auto const &it :listGeopotential) { delete it;}
-	for (auto const &it :listIsotherms) { delete it;}
-	for (auto const &it :listLinesThetaE) { delete it;}
 }
 //-------------------------------------------------------------
 // Cartouche : dates de la prévision courante + infos générales
@@ -854,6 +1307,35 @@ QPixmap * MapDrawer::createPixmap_GriddedData (
 	return pixmap;
 }
 
+//===========================================================
+QImage MapDrawer::createImage_Tile ( 
+						int layer,
+						Projection *proj,
+						GriddedPlotter *plotter,
+						SatellitePlotter *satellitePlotter )
+{
+	QImage img (proj->getW(), proj->getH(), QImage::Format_ARGB32_Premultiplied);
+	
+	if (layer == MapTileCache::TILE_EARTH) {
+		img.fill (backgroundColor);
+		if (gshhsReader.get() != nullptr) {
+			QPainter pnt (&img);
+			draw_Map_Earth (pnt, proj);
+		}
+	}
+	else {
+		img.fill (Qt::transparent);
+		QPainter pnt (&img);
+		pnt.setRenderHint (QPainter::Antialiasing, true);
+		if (showSatelliteImages)
+			drawSatelliteData (pnt, proj, satellitePlotter);
+		if (plotter)
+			draw_MeteoData_Gridded (pnt, proj, plotter, false);
+		draw_Map_Foreground (pnt, proj, false);
+	}
+	return img;
+}
+
 //===========================================================
 void MapDrawer::drawSatelliteData (QPainter& pnt, Projection *proj, SatellitePlotter *plotter)
 {
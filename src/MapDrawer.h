@@ -22,7 +22,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QWidget>
 #include <QBitmap>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "GshhsReader.h"
 #include "GisReader.h"
@@ -32,6 +35,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "GribPlot.h"
 #include "IrregularGridded.h"
+#include "MapTileCache.h"
 
 
 //==============================================================================
@@ -82,11 +86,104 @@ friend class Terrain;	// TODO (or not) getters setters
 						Projection *proj,
 						const QList<POI*>& lspois );
 
+		// One tile of the map (see MapTileCache): proj is the view of the tile.
+		QImage createImage_Tile (
+						int layer,
+						Projection *proj,
+						GriddedPlotter *plotter,
+						SatellitePlotter *satellitePlotter );
+
         void	initGraphicsParameters  ();
+
+		// Settings of the drawing (what is shown, colors, pens),
+		// without the images: a copy may draw the map in another thread.
+		void	copySettings (const MapDrawer &model);
+
+		// The drawing stops as soon as possible when *flag becomes true
+		// (the image is then incomplete).
+		void setCancelFlag (const std::atomic<bool> *flag) {cancelFlag = flag;}
+		bool isCanceled () const {return cancelFlag!=nullptr && cancelFlag->load();}
+
+		// Fast drawing while the map is moving: simplified coastlines,
+		// coarse color maps, fewer arrows, no labels.
+		void setInteractive (bool b) {interactive = b;}
+		bool isInteractive () const  {return interactive;}
+
+		// The map only moved since the last drawing: the previous images
+		// are shifted and only the uncovered strips are drawn.
+		void setMapMoved (bool b)    {isMapMoved = b;}
+
+		// Called with coarse versions of the complete map while its
+		// color map is drawn again (empty function: no preview).
+		void setPreviewFunction (const std::function <void (const QImage &)> &f)
+									{previewFunction = f;}
+
+		// Must be called when the data or the settings of the plotter change
+		// (the layers only know the settings of the drawer).
+		void clearLayers ();
 					
 	private:
-		QPixmap     *imgEarth;   // images précalculées pour accélérer l'affichage
-		QPixmap     *imgAll;
+		QImage      *imgEarth;   // images précalculées pour accélérer l'affichage
+		QImage      *imgAll;     // (QImage: drawn in MapRenderThread)
+		Projection  *earthProj;      // projection of imgEarth
+		bool    isMapMoved;
+
+		//-----------------------------------------------------------
+		// Layers of the complete map. Each one is kept in its own image
+		// with a key made of what it depends on (projection, date, data,
+		// settings): only the layers whose key changed are drawn again.
+		enum MapLayerId {
+			LAYER_COLORMAP,
+			LAYER_ISOBARS,
+			LAYER_ISOTHERMS0,
+			LAYER_GEOPOTENTIAL,
+			LAYER_ISOTHERMS,
+			LAYER_THETAE,
+			LAYER_WAVES_ARROWS,
+			LAYER_WIND_ARROWS,
+			LAYER_CURRENT_ARROWS,
+			LAYER_LABELS,		// extrema, isolines labels, temperatures
+			LAYER_GRID_POINTS,
+			LAYER_FOREGROUND,	// borders, rivers, names
+			NB_LAYERS
+		};
+		struct MapLayer {
+			QByteArray  key;		// empty: no valid image
+			QImage      image;
+		};
+		MapLayer    layers [NB_LAYERS];
+		Projection  *colorMapProj;   // projection of the color map layer
+
+		void    drawLayer (QPainter &pnt, Projection *proj,
+						   int layer, const QByteArray &key,
+						   const std::function <void (QPainter &)> &draw);
+		void    dropLayer (int layer);
+		
+		// The gridded data layers don't depend on each other: the ones
+		// to draw again are queued, then drawn in parallel (each job
+		// has its own copy of the projection).
+		typedef std::function <void (QPainter &, const Projection *)> LayerDrawer;
+		struct LayerJob {
+			int         layer;
+			QByteArray  key;
+			QRegion     clip;		// empty: whole image
+			LayerDrawer draw;
+		};
+		std::vector <LayerJob> layerJobs;
+		void    queueLayer (Projection *proj, int layer, const QByteArray &key,
+							const LayerDrawer &draw);
+		void    queueColorMapLayer (Projection *proj, GriddedPlotter *plotter,
+									const QByteArray &key);
+		void    runLayerJobs (Projection *proj);
+		
+		std::function <void (const QImage &)> previewFunction;
+		void    drawColorMapPreviews (Projection *proj, GriddedPlotter *plotter);
+		QByteArray getForegroundKey (const Projection *proj) const;
+		void    draw_ForegroundLayer (QPainter &pnt, Projection *proj,
+									  bool isEarthMapValid);
+		
+		const std::atomic<bool> *cancelFlag;
+		bool    interactive;
 		
 		std::shared_ptr<GshhsReader> gshhsReader;
 		
@@ -164,10 +261,18 @@ friend class Terrain;	// TODO (or not) getters setters
 		
 		void    draw_MeteoData_Gridded 
 						( QPainter &pnt, Projection *proj,
-						GriddedPlotter   *plotter );
+						GriddedPlotter   *plotter,
+						bool withLabels = true,
+						bool useLayers = false );
+
+		static bool getMapShift (const Projection *oldProj, const Projection *proj,
+								 QPoint *shift);
+		static QRegion shiftImage (QImage *img, const QPoint &shift);
 
 		void	draw_Map_Background  (bool isEarthMapValid, Projection *proj);
-		void	draw_Map_Foreground  (QPainter &pnt, Projection *proj);
+		void	draw_Map_Earth       (QPainter &pnt, Projection *proj);
+		void	draw_Map_Foreground  (QPainter &pnt, Projection *proj,
+									  bool withNames = true);
 
 		void	drawSatelliteData (QPainter &pnt, Projection *proj, SatellitePlotter *plotter);
 };
@@ -0,0 +1,259 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include <QPainter>
+
+#include "MapRenderThread.h"
+#include "MapDrawer.h"
+
+//---------------------------------------------------------
+MapRenderThread::MapRenderThread (QObject *parent)
+	: QThread (parent)
+{
+	hasJob = false;
+	isDrawing = false;
+	mustQuit = false;
+	canceled = false;
+	generation = 0;
+	mustClearLayers = false;
+	drawer = nullptr;
+	isEarthMapDone = false;
+	isEarthMapInteractive = false;
+	hasFrame = false;
+	frameGeneration = 0;
+	frameProj = nullptr;
+	tilesDone = false;
+	pendingJob = Job ();
+	start ();
+}
+//---------------------------------------------------------
+MapRenderThread::~MapRenderThread ()
+{
+	mutex.lock ();
+	mustQuit = true;
+	canceled = true;
+	jobCondition.wakeAll ();
+	mutex.unlock ();
+	wait ();
+	clearPendingJob ();
+	delete frameProj;
+	delete drawer;
+}
+//---------------------------------------------------------
+void MapRenderThread::clearPendingJob ()
+{
+	if (hasJob) {
+		delete pendingJob.proj;     // never started
+		pendingJob = Job ();
+		hasJob = false;
+	}
+}
+//---------------------------------------------------------
+void MapRenderThread::render (const Job &job)
+{
+	QMutexLocker lock (&mutex);
+	clearPendingJob ();
+	pendingJob = job;
+	hasJob = true;
+	if (job.clearLayers)
+		mustClearLayers = true;		// even if the job is canceled
+	generation ++;
+	if (isDrawing)
+		canceled = true;
+	readyTiles.clear ();
+	tilesDone = false;
+	if (drawer == nullptr)
+		drawer = new MapDrawer (*job.settings);
+	jobCondition.wakeOne ();
+}
+//---------------------------------------------------------
+// The job isn't waited for: the drawing stops soon after, and its
+// maps (even a map already published) are dropped.
+void MapRenderThread::cancel ()
+{
+	QMutexLocker lock (&mutex);
+	clearPendingJob ();
+	generation ++;
+	if (isDrawing)
+		canceled = true;
+	hasFrame = false;
+	readyTiles.clear ();
+	tilesDone = false;
+}
+//---------------------------------------------------------
+void MapRenderThread::stop ()
+{
+	cancel ();
+	QMutexLocker lock (&mutex);
+	while (isDrawing)
+		idleCondition.wait (&mutex);
+}
+//---------------------------------------------------------
+bool MapRenderThread::takeFrame (QImage *image, Projection **proj)
+{
+	QMutexLocker lock (&mutex);
+	if (! hasFrame || frameGeneration != generation)
+		return false;
+	*image = frame;
+	*proj = frameProj;
+	frame = QImage ();
+	frameProj = nullptr;
+	hasFrame = false;
+	return true;
+}
+//---------------------------------------------------------
+void MapRenderThread::takeTiles (std::vector <Tile> *tiles, bool *done)
+{
+	QMutexLocker lock (&mutex);
+	tiles->clear ();
+	tiles->swap (readyTiles);
+	*done = tilesDone;
+	tilesDone = false;
+}
+//---------------------------------------------------------
+// Tiles of the view: the density of the data is computed on the view,
+// the same for all the tiles.
+void MapRenderThread::renderTiles (const Job &job, unsigned int gen)
+{
+	int T = MapTileCache::TileSize;
+	std::unique_ptr <Projection> tileProj (job.proj->clone());
+	tileProj->setScreenSize (T, T);
+	if (job.plotter)
+		job.plotter->setDensityView (job.proj);
+	bool complete = true;
+	for (const MapTileCache::TileKey &key : job.tiles) {
+		tileProj->setScreenOrigin (key.tx*T, key.ty*T);
+		QImage img = drawer->createImage_Tile (key.layer, tileProj.get(),
+								job.plotter.get(), job.satellitePlotter);
+		QMutexLocker lock (&mutex);
+		if (canceled || gen != generation) {
+			complete = false;
+			break;
+		}
+		readyTiles.push_back (Tile (key, img));
+		emit tilesReady ();
+	}
+	if (job.plotter)
+		job.plotter->setDensityView (nullptr);
+	QMutexLocker lock (&mutex);
+	if (complete && gen == generation) {
+		tilesDone = true;
+		emit tilesReady ();
+	}
+}
+//---------------------------------------------------------
+// Coarse map shown while the job is running
+void MapRenderThread::publishPreview (const QImage &preview, Projection *proj,
+									  unsigned int gen)
+{
+	QMutexLocker lock (&mutex);
+	if (canceled || gen != generation)
+		return;
+	frame = preview;
+	delete frameProj;
+	frameProj = proj->clone();
+	frameGeneration = gen;
+	hasFrame = true;
+	emit frameReady ();
+}
+//---------------------------------------------------------
+void MapRenderThread::run ()
+{
+	mutex.lock ();
+	while (true)
+	{
+		while (!hasJob && !mustQuit)
+			jobCondition.wait (&mutex);
+		if (mustQuit)
+			break;
+		Job job = pendingJob;
+		pendingJob = Job ();
+		hasJob = false;
+		bool clearLayers = mustClearLayers;
+		mustClearLayers = false;
+		isDrawing = true;
+		canceled = false;
+		unsigned int jobGeneration = generation;
+		bool drawTiles = ! job.tiles.empty();
+		// the earth map of a canceled job may be incomplete
+		bool isEarthMapValid = job.isEarthMapValid && isEarthMapDone
+							&& job.interactive == isEarthMapInteractive;
+		bool isMapMoved = job.isMapMoved && isEarthMapDone
+							&& job.interactive == isEarthMapInteractive;
+		if (! drawTiles)	// the tiles don't use the earth map
+			isEarthMapDone = false;
+		mutex.unlock ();
+
+		drawer->copySettings (*job.settings);
+		if (clearLayers)
+			drawer->clearLayers ();
+		drawer->setCancelFlag (&canceled);
+		drawer->setInteractive (job.interactive);
+		if (job.plotter)
+			job.plotter->setCurrentDate (job.date);
+		if (drawTiles) {
+			renderTiles (job, jobGeneration);
+			drawer->setCancelFlag (nullptr);
+			delete job.proj;
+			mutex.lock ();
+			isDrawing = false;
+			idleCondition.wakeAll ();
+			continue;
+		}
+
+		QImage image (job.proj->getW(), job.proj->getH(),
+					  QImage::Format_ARGB32_Premultiplied);
+		{
+			QPainter pnt (&image);
+			drawer->setMapMoved (isMapMoved);
+			if (job.previews)
+				drawer->setPreviewFunction ([this, &job, jobGeneration] (const QImage &preview) {
+					publishPreview (preview, job.proj, jobGeneration);
+				});
+			if (job.plotter) {
+				drawer->draw_GSHHS_and_GriddedData (pnt, true, isEarthMapValid,
+							job.proj, job.plotter.get(), job.satellitePlotter,
+							job.drawCartouche);
+			}
+			else
+				drawer->draw_GSHHS (pnt, true, isEarthMapValid,
+							job.proj, job.satellitePlotter);
+			drawer->setCancelFlag (nullptr);
+			drawer->setMapMoved (false);
+			drawer->setPreviewFunction (nullptr);
+		}
+
+		mutex.lock ();
+		isDrawing = false;
+		if (canceled || jobGeneration != generation) {
+			delete job.proj;
+		}
+		else {
+			frame = image;
+			delete frameProj;
+			frameProj = job.proj;
+			frameGeneration = jobGeneration;
+			hasFrame = true;
+			isEarthMapDone = true;
+			isEarthMapInteractive = job.interactive;
+			emit frameReady ();
+		}
+		idleCondition.wakeAll ();
+	}
+	mutex.unlock ();
+}
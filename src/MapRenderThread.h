@@ -0,0 +1,121 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef MAPRENDERTHREAD_H
+#define MAPRENDERTHREAD_H
+
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+
+#include "Projection.h"
+#include "MapTileCache.h"
+
+class MapDrawer;
+class GriddedPlotter;
+class SatellitePlotter;
+
+//===============================================================
+// Dessin de la carte complète dans un thread.
+// A new job cancels the current one: only the last requested map
+// is drawn. The thread draws with its own drawer, which gets the
+// settings of the job, and with a drawing copy of the plotter:
+// the settings of the map may change at any time. Only the data
+// (readers, satellite plotter) must not change: call stop() first.
+// Coarse previews of the map may be delivered before the complete map.
+// A job may also draw tiles of the view (while the map is dragged):
+// they are delivered one by one.
+//===============================================================
+class MapRenderThread : public QThread
+{ Q_OBJECT
+    public:
+        struct Job {
+            std::shared_ptr <const MapDrawer> settings;  // drawer of the map
+            Projection       *proj;          // owned by the thread
+            std::shared_ptr <GriddedPlotter> plotter;    // drawing copy, nullptr: map only
+            time_t            date;          // date of the gridded data
+            SatellitePlotter *satellitePlotter;
+            bool   isEarthMapValid;
+            bool   clearLayers;     // the data or the plotter changed
+            bool   drawCartouche;
+            bool   interactive;     // fast drawing while the map moves
+            bool   isMapMoved;      // only the projection origin changed
+            bool   previews;        // coarse maps before the complete one
+            // Tiles of the view proj to draw instead of the map
+            std::vector <MapTileCache::TileKey> tiles;
+        };
+        typedef std::pair <MapTileCache::TileKey, QImage> Tile;
+
+        MapRenderThread (QObject *parent=nullptr);
+        ~MapRenderThread ();
+
+        void render (const Job &job);
+
+        // Cancels the job without waiting: its maps are never delivered.
+        void cancel ();
+        // Cancels the job and waits for the end of the drawing.
+        void stop ();
+
+        // Last map of the last job and its projection (ownership is transferred)
+        bool takeFrame (QImage *image, Projection **proj);
+        // Tiles drawn by the last job since the last call.
+        // *done: all the tiles of the job are drawn.
+        void takeTiles (std::vector <Tile> *tiles, bool *done);
+
+    signals:
+        void frameReady ();
+        void tilesReady ();
+
+    protected:
+        void run ();
+
+    private:
+        void publishPreview (const QImage &preview, Projection *proj,
+                             unsigned int generation);
+        void clearPendingJob ();
+        void renderTiles (const Job &job, unsigned int generation);
+
+        QMutex         mutex;
+        QWaitCondition jobCondition;    // a job is waiting, or quit
+        QWaitCondition idleCondition;   // no job running
+        bool   hasJob, isDrawing, mustQuit;
+        Job    pendingJob;
+        std::atomic<bool> canceled;
+        // Incremented by each new job and each cancel: a map drawn
+        // for an older generation is stale and is dropped.
+        unsigned int generation;
+        bool   mustClearLayers;
+
+        MapDrawer *drawer;      // used only by the thread
+        bool   isEarthMapDone;  // the drawer has the earth map of the last job
+        bool   isEarthMapInteractive;
+        bool   hasFrame;
+        unsigned int frameGeneration;
+        QImage frame;
+        Projection *frameProj;
+        std::vector <Tile> readyTiles;
+        bool   tilesDone;
+};
+
+#endif
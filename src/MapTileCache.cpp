@@ -0,0 +1,103 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include <algorithm>
+#include <cmath>
+
+#include "MapTileCache.h"
+
+//---------------------------------------------------------------
+bool MapTileCache::TileKey::operator< (const TileKey &o) const
+{
+    if (layer != o.layer)           return layer < o.layer;
+    if (projection != o.projection) return projection < o.projection;
+    if (zoom != o.zoom)             return zoom < o.zoom;
+    if (date != o.date)             return date < o.date;
+    if (interactive != o.interactive) return interactive < o.interactive;
+    if (ty != o.ty)                 return ty < o.ty;
+    return tx < o.tx;
+}
+//---------------------------------------------------------------
+MapTileCache::TileKey MapTileCache::makeKey (int layer, const Projection *proj,
+                                             time_t date, int tx, int ty,
+                                             bool interactive)
+{
+    TileKey key;
+    key.layer = layer;
+    key.projection = proj->getProjection ();
+    key.zoom = llround (proj->getScale()*1e6);
+    key.date = (layer == TILE_EARTH) ? 0 : date;
+    key.tx = tx;
+    key.ty = ty;
+    key.interactive = interactive;
+    return key;
+}
+
+//===============================================================
+MapTileCache::MapTileCache (int maxSizeMB)
+{
+    bytes = 0;
+    setMaxSize (maxSizeMB);
+}
+//---------------------------------------------------------------
+void MapTileCache::setMaxSize (int maxSizeMB)
+{
+    maxBytes = (qint64) std::max (maxSizeMB, 1) * 1024*1024;
+    evict ();
+}
+//---------------------------------------------------------------
+const QImage *MapTileCache::find (const TileKey &key)
+{
+    auto it = index.find (key);
+    if (it == index.end())
+        return nullptr;
+    tiles.splice (tiles.begin(), tiles, it->second);
+    return & it->second->second;
+}
+//---------------------------------------------------------------
+void MapTileCache::insert (const TileKey &key, const QImage &img)
+{
+    auto it = index.find (key);
+    if (it != index.end()) {
+        bytes -= it->second->second.byteCount();
+        tiles.erase (it->second);
+        index.erase (it);
+    }
+    tiles.push_front (TileEntry(key, img));
+    index [key] = tiles.begin();
+    bytes += img.byteCount();
+    evict ();
+}
+//---------------------------------------------------------------
+void MapTileCache::evict ()
+{
+    // the most recent tile is always kept
+    while (bytes > maxBytes && tiles.size() > 1) {
+        TileEntry &last = tiles.back();
+        bytes -= last.second.byteCount();
+        index.erase (last.first);
+        tiles.pop_back ();
+    }
+}
+//---------------------------------------------------------------
+void MapTileCache::clear ()
+{
+    tiles.clear ();
+    index.clear ();
+    bytes = 0;
+}
@@ -0,0 +1,76 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef MAPTILECACHE_H
+#define MAPTILECACHE_H
+
+#include <ctime>
+#include <list>
+#include <map>
+
+#include <QImage>
+
+#include "Projection.h"
+
+//===============================================================
+// Tuiles de carte déjà dessinées (carrés de TileSize pixels).
+// Une tuile est repérée par sa couche, la projection, l'échelle,
+// la date (couche de données) et sa position dans la carte entière
+// à cette échelle (voir Projection::getScreenOrigin).
+// Cache LRU de taille mémoire limitée.
+//===============================================================
+class MapTileCache
+{
+    public:
+        enum TileLayer {
+            TILE_EARTH,      // fond de carte (mers, continents)
+            TILE_DATA        // données, satellite et bordures (transparent)
+        };
+        static const int TileSize = 256;
+
+        struct TileKey {
+            int    layer;
+            int    projection;
+            qint64 zoom;
+            time_t date;
+            int    tx, ty;
+            bool   interactive;     // drawn with the fast settings
+            bool operator< (const TileKey &o) const;
+        };
+        static TileKey makeKey (int layer, const Projection *proj,
+                                time_t date, int tx, int ty,
+                                bool interactive=false);
+
+        MapTileCache (int maxSizeMB=64);
+
+        // nullptr if the tile isn't in the cache
+        const QImage *find (const TileKey &key);
+        void insert (const TileKey &key, const QImage &img);
+        void clear ();
+        void setMaxSize (int maxSizeMB);
+
+    private:
+        typedef std::pair <TileKey, QImage> TileEntry;
+        std::list <TileEntry> tiles;      // most recently used first
+        std::map <TileKey, std::list<TileEntry>::iterator> index;
+        qint64 maxBytes, bytes;
+
+        void evict ();
+};
+
+#endif
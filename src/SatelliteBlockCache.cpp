@@ -0,0 +1,93 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include "SatelliteBlockCache.h"
+
+#include <algorithm>
+#include <tuple>
+
+bool SatelliteBlockCache::BlockKey::operator<(const BlockKey &other) const
+{
+    return std::tie(band, blockX, blockY) < std::tie(other.band, other.blockX, other.blockY);
+}
+
+SatelliteBlockCache::SatelliteBlockCache(int maxSizeMB)
+    : maxBytes(static_cast<size_t>(maxSizeMB) * 1024 * 1024), bytes(0),
+      cursorsCount(0), nextCursor(0)
+{
+}
+
+void SatelliteBlockCache::clear()
+{
+    blocks.clear();
+    lru.clear();
+    bytes = 0;
+    cursorsCount = 0;
+}
+
+const SatelliteBlockCache::Block *SatelliteBlockCache::loadBlock(const BlockKey &key, int count)
+{
+    auto it = blocks.find(key);
+    if (it != blocks.end())
+    {
+        lru.splice(lru.begin(), lru, it->second.itLru);
+        return &it->second;
+    }
+
+    Block &block = blocks[key];
+    block.values.resize(count);
+
+    GDALDataType type = key.band->GetRasterDataType();
+    int typeSize = GDALGetDataTypeSizeBytes(type);
+    std::vector<unsigned char> raw(static_cast<size_t>(count) * typeSize);
+    if (key.band->ReadBlock(key.blockX, key.blockY, raw.data()) == CE_None)
+    {
+        GDALCopyWords(raw.data(), type, typeSize,
+                      block.values.data(), GDT_Float32, sizeof(float), count);
+    }
+    else
+    {
+        // unreadable block: drawn as no data
+        int hasNoDataValue = false;
+        float noDataValue = key.band->GetNoDataValue(&hasNoDataValue);
+        std::fill(block.values.begin(), block.values.end(), hasNoDataValue ? noDataValue : 0);
+    }
+
+    lru.push_front(key);
+    block.itLru = lru.begin();
+    bytes += count * sizeof(float);
+    evict();
+    return &block;
+}
+
+void SatelliteBlockCache::evict()
+{
+    // the most recent block is always kept
+    while (bytes > maxBytes && lru.size() > 1)
+    {
+        auto it = blocks.find(lru.back());
+        for (int i = 0; i < cursorsCount; ++i)
+        {
+            if (cursors[i].block == &it->second)
+                cursors[i].block = nullptr;
+        }
+        bytes -= it->second.values.size() * sizeof(float);
+        blocks.erase(it);
+        lru.pop_back();
+    }
+}
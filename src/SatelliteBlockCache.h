@@ -0,0 +1,105 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef SATELLITEBLOCKCACHE_H
+#define SATELLITEBLOCKCACHE_H
+
+#include "gdal_priv.h"
+
+#include <list>
+#include <map>
+#include <vector>
+
+// Values of a raster band, read block by block (GDAL native blocks)
+// and kept as floats in a LRU cache limited in memory.
+class SatelliteBlockCache
+{
+public:
+    explicit SatelliteBlockCache(int maxSizeMB = 64);
+
+    void clear();
+
+    // The pixel (x, y) must be inside the band.
+    float getValue(GDALRasterBand *band, int x, int y);
+
+private:
+    struct BlockKey
+    {
+        GDALRasterBand *band;
+        int blockX, blockY;
+        bool operator<(const BlockKey &other) const;
+    };
+    struct Block
+    {
+        std::vector<float> values;
+        std::list<BlockKey>::iterator itLru;
+    };
+
+    const Block *loadBlock(const BlockKey &key, int count);
+    void evict();
+
+    std::map<BlockKey, Block> blocks;
+    std::list<BlockKey> lru;           // most recently used first
+    size_t maxBytes, bytes;
+
+    // Consecutive lookups in a band are mostly in the same block
+    // (one cursor per band: the 3 bands of a RGB image are read together)
+    struct Cursor
+    {
+        GDALRasterBand *band;
+        int blockXSize, blockYSize;
+        int blockX, blockY;
+        const Block *block;
+    };
+    static const int MaxCursors = 4;
+    Cursor cursors[MaxCursors];
+    int cursorsCount, nextCursor;
+
+    Cursor &getCursor(GDALRasterBand *band);
+};
+
+inline SatelliteBlockCache::Cursor &SatelliteBlockCache::getCursor(GDALRasterBand *band)
+{
+    for (int i = 0; i < cursorsCount; ++i)
+    {
+        if (cursors[i].band == band)
+            return cursors[i];
+    }
+    int i = (cursorsCount < MaxCursors) ? cursorsCount++ : (nextCursor++ % MaxCursors);
+    Cursor &cursor = cursors[i];
+    cursor.band = band;
+    band->GetBlockSize(&cursor.blockXSize, &cursor.blockYSize);
+    cursor.block = nullptr;
+    return cursor;
+}
+
+inline float SatelliteBlockCache::getValue(GDALRasterBand *band, int x, int y)
+{
+    Cursor &cursor = getCursor(band);
+    int blockX = x / cursor.blockXSize;
+    int blockY = y / cursor.blockYSize;
+    if (cursor.block == nullptr || blockX != cursor.blockX || blockY != cursor.blockY)
+    {
+        cursor.block = loadBlock({band, blockX, blockY}, cursor.blockXSize * cursor.blockYSize);
+        cursor.blockX = blockX;
+        cursor.blockY = blockY;
+    }
+    return cursor.block->values[(y % cursor.blockYSize) * cursor.blockXSize + (x % cursor.blockXSize)];
+}
+
+#endif // SATELLITEBLOCKCACHE_H
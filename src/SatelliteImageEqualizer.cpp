@@ -19,37 +19,44 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "SatelliteImageEqualizer.h"
 #include "gdal.h"
 #include "gdal_priv.h"
+#include <algorithm>
+#include <cmath>
 #include <numeric>
 
 SatelliteImageEqualizer::SatelliteImageEqualizer(GDALRasterBand *band)
 {
     double mean = 0, stdDev = 0;
-    band->ComputeStatistics(TRUE, &minValue, &maxValue, &mean, &stdDev, nullptr, nullptr);
-    GUIntBig anHistogram[HISTOGRAM_BINS_NUMBER];
-    band->GetHistogram(minValue, maxValue, HISTOGRAM_BINS_NUMBER, anHistogram, 
-        FALSE, TRUE, GDALDummyProgress, nullptr);
-    int valuesCount = std::accumulate(anHistogram, anHistogram + HISTOGRAM_BINS_NUMBER, 0);
-
+    minValue = maxValue = 0;
+    band->GetStatistics(TRUE, TRUE, &minValue, &maxValue, &mean, &stdDev);
+    binScale = (maxValue > minValue) ? HISTOGRAM_BINS_NUMBER / (maxValue - minValue) : 0;
+
+    GUIntBig anHistogram[HISTOGRAM_BINS_NUMBER] = {};
+    double histMin, histMax;
+    int bucketsCount = 0;
+    GUIntBig *defaultHistogram = nullptr;
+    if (band->GetDefaultHistogram(&histMin, &histMax, &bucketsCount, &defaultHistogram,
+                                  FALSE, GDALDummyProgress, nullptr) == CE_None
+        && bucketsCount == HISTOGRAM_BINS_NUMBER
+        && std::fabs(histMin - minValue) <= 1e-9 * std::fabs(maxValue - minValue)
+        && std::fabs(histMax - maxValue) <= 1e-9 * std::fabs(maxValue - minValue))
+    {
+        std::copy(defaultHistogram, defaultHistogram + HISTOGRAM_BINS_NUMBER, anHistogram);
+    }
+    else
+    {
+        band->GetHistogram(minValue, maxValue, HISTOGRAM_BINS_NUMBER, anHistogram,
+            FALSE, TRUE, GDALDummyProgress, nullptr);
+        band->SetDefaultHistogram(minValue, maxValue, HISTOGRAM_BINS_NUMBER, anHistogram);
+    }
+    CPLFree(defaultHistogram);
+
+    GUIntBig valuesCount = std::accumulate(anHistogram, anHistogram + HISTOGRAM_BINS_NUMBER, GUIntBig(0));
     double pHistogram[HISTOGRAM_BINS_NUMBER];
     for (int i = 0; i < HISTOGRAM_BINS_NUMBER; ++i)
-        pHistogram[i] = static_cast<double>(anHistogram[i]) / valuesCount;
-    
+        pHistogram[i] = valuesCount ? static_cast<double>(anHistogram[i]) / valuesCount : 0;
+
     std::partial_sum(pHistogram, pHistogram + HISTOGRAM_BINS_NUMBER, transformMap);
+    transformMap[HISTOGRAM_BINS_NUMBER] = 1;    // value == maxValue
     for (int i = 0; i <= HISTOGRAM_BINS_NUMBER; ++i)
         transformMap[i] *= 255;
 }
-
-int SatelliteImageEqualizer::getBin(float value)
-{
-    return static_cast<int>((value - minValue) / (maxValue - minValue) * HISTOGRAM_BINS_NUMBER);
-}
-
-float SatelliteImageEqualizer::transform(float value)
-{
-    int bin = getBin(value);
-    if (bin < 0)
-        return 0;
-    if (bin > HISTOGRAM_BINS_NUMBER)
-        return 255;
-    return transformMap[getBin(value)];
-}
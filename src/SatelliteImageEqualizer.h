@@ -23,18 +23,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 const int HISTOGRAM_BINS_NUMBER = 1000;
 
+// Histogram equalization of the values of a band, as a lookup table.
+// The statistics and the histogram are stored by GDAL in the .aux.xml
+// file of the image, and reused the next times it is opened.
 class SatelliteImageEqualizer
 {
 public:
     SatelliteImageEqualizer(GDALRasterBand* band);
-    float transform(float value);
+    float transform(float value) const;
 
 private:
-    int getBin(float value);
-
     double minValue;
     double maxValue;
+    double binScale;
     float transformMap[HISTOGRAM_BINS_NUMBER + 1];
 };
 
+inline float SatelliteImageEqualizer::transform(float value) const
+{
+    int bin = static_cast<int>((value - minValue) * binScale);
+    if (bin < 0)
+        return 0;
+    if (bin > HISTOGRAM_BINS_NUMBER)
+        return 255;
+    return transformMap[bin];
+}
+
 #endif // SATELLITEVALUELIMITER_H
\ No newline at end of file
@@ -18,29 +18,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "SatellitePlotter.h"
 #include "SatelliteImageEqualizer.h"
+#include "ScreenMapGrid.h"
 
 #include "gdal_priv.h"
 #include <QDebug>
+#include <QRect>
 
-SatellitePlotter::SatellitePlotter() : reader(nullptr), layer(0), subdataset(-1), rgb(false)
-{
-}
+#include <algorithm>
+#include <cmath>
+#include <memory>
 
-SatellitePlotter::SatellitePlotter(const SatellitePlotter &p) : reader(p.reader), layer(p.layer), subdataset(p.subdataset), rgb(p.rgb)
+SatellitePlotter::SatellitePlotter() : reader(nullptr), layer(0), subdataset(-1), rgb(false),
+    pixelsReader(nullptr), pixelsTransformGeneration(0)
 {
 }
 
-float getPixelValue(int pixelX, int pixelY, GDALRasterBand *pBand)
+SatellitePlotter::SatellitePlotter(const SatellitePlotter &p) : reader(p.reader), layer(p.layer), subdataset(p.subdataset), rgb(p.rgb),
+    pixelsReader(nullptr), pixelsTransformGeneration(0)
 {
-    float dfValue;
-    pBand->RasterIO(GF_Read, pixelX, pixelY, 1, 1, &dfValue, 1, 1, GDT_Float32, 0, 0);
-    return dfValue;
 }
 
-bool isPointInsideBounds(int x, int y, GDALRasterBand *pBand)
+// Band parameters fetched once per draw
+struct BandSampler
 {
-    return 0 <= x && x < pBand->GetXSize() && 0 <= y && y < pBand->GetYSize();
-}
+    GDALRasterBand *band;
+    float noDataValue;
+};
 
 float getNoDataValue(GDALRasterBand* band)
 {
@@ -51,10 +54,12 @@ float getNoDataValue(GDALRasterBand* band)
     return noDataValue;
 }
 
-void drawPixelGrayscale(QImage *image, int imageX, int imageY, int dataX, int dataY, GDALRasterBand *band, SatelliteImageEqualizer& equalizer)
+void drawPixelGrayscale(QImage *image, int imageX, int imageY, int dataX, int dataY,
+                        const BandSampler &sampler, SatelliteBlockCache &cache,
+                        const SatelliteImageEqualizer &equalizer)
 {
-    float value = getPixelValue(dataX, dataY, band);
-    if (value == getNoDataValue(band))
+    float value = cache.getValue(sampler.band, dataX, dataY);
+    if (value == sampler.noDataValue)
         return;
 
     value = equalizer.transform(value);
@@ -65,14 +70,15 @@ void drawPixelGrayscale(QImage *image, int imageX, int imageY, int dataX, int da
     image->setPixel(imageX + 1, imageY + 1, rgb);
 }
 
-void drawPixelRGB(QImage *image, int imageX, int imageY, int dataX, int dataY, GDALRasterBand *bands[3])
+void drawPixelRGB(QImage *image, int imageX, int imageY, int dataX, int dataY,
+                  const BandSampler samplers[3], SatelliteBlockCache &cache)
 {
     float colors[3] = {};
     int noValueBandsCount = 0;
     for (int i = 0; i < 3; ++i)
     {
-        colors[i] = getPixelValue(dataX, dataY, bands[i]);
-        if (colors[i] == getNoDataValue(bands[i]))
+        colors[i] = cache.getValue(samplers[i].band, dataX, dataY);
+        if (colors[i] == samplers[i].noDataValue)
             ++noValueBandsCount;
     }
     if (noValueBandsCount == 3)
@@ -85,15 +91,154 @@ void drawPixelRGB(QImage *image, int imageX, int imageY, int dataX, int dataY, G
     image->setPixel(imageX + 1, imageY + 1, rgb);
 }
 
-void screenToMap(const Projection* proj, int pixelX, int pixelY, double* lon, double *lat)
+void screenToMap(const ScreenMapGrid &grid, int a, int b, double* lon, double *lat)
 {
-    proj->screen2map(pixelX, pixelY, lon, lat);
+    grid.getMap(a, b, lon, lat);
     while (*lon > 180)
         *lon -= 360;
     while (*lon < -180)
         *lon += 360;
 }
 
+// Image coordinates of the samples a0..a1 x b0..b1 (with steps), exactly.
+// The samples are transformed row by row: on a cylindrical map, a row
+// is at a constant latitude, along which the approximation of the
+// thin-plate-spline transformation is the most efficient.
+void SatellitePlotter::transformPixels(int a0, int a1, int b0, int b1, int stepA, int stepB)
+{
+    int ny = pixelsGrid->getNy();
+    std::vector<int> columns;
+    for (int a = a0; a < a1; a += stepA)
+        columns.push_back(a);
+    columns.push_back(a1);
+    std::vector<double> x(columns.size()), y(columns.size());
+    for (int b = b0; b <= b1; b = (b == b1) ? b1 + 1 : std::min(b + stepB, b1))
+    {
+        for (size_t k = 0; k < columns.size(); ++k)
+            screenToMap(*pixelsGrid, columns[k], b, &x[k], &y[k]);
+        reader->transformMapToScreen(columns.size(), x.data(), y.data());
+        for (size_t k = 0; k < columns.size(); ++k)
+        {
+            pixelsX[columns[k] * ny + b] = x[k];
+            pixelsY[columns[k] * ny + b] = y[k];
+        }
+    }
+}
+
+// The corners of the cell are known: the cell may be interpolated if its
+// center, transformed exactly, is close to the bilinear interpolation.
+bool SatellitePlotter::isPixelsCellLinear(int a0, int a1, int b0, int b1)
+{
+    const double tolerance = 0.5;   // pixel of the image
+    int ny = pixelsGrid->getNy();
+    double sx = 0, sy = 0;
+    for (int k : {a0 * ny + b0, a1 * ny + b0, a0 * ny + b1, a1 * ny + b1})
+    {
+        if (pixelsX[k] < 0 || pixelsY[k] < 0)
+            return false;
+        sx += pixelsX[k];
+        sy += pixelsY[k];
+    }
+    int am = (a0 + a1) / 2;
+    int bm = (b0 + b1) / 2;
+    double x, y;
+    screenToMap(*pixelsGrid, am, bm, &x, &y);
+    reader->transformMapToScreen(1, &x, &y);
+    // center of the cell (a0+a1 and b0+b1 are even)
+    return x >= 0 && std::abs(x - sx / 4) < tolerance && std::abs(y - sy / 4) < tolerance;
+}
+
+void SatellitePlotter::interpolatePixelsCell(int a0, int a1, int b0, int b1)
+{
+    int ny = pixelsGrid->getNy();
+    int k00 = a0 * ny + b0, k10 = a1 * ny + b0, k01 = a0 * ny + b1, k11 = a1 * ny + b1;
+    for (int a = a0; a <= a1; ++a)
+    {
+        double u = static_cast<double>(a - a0) / (a1 - a0);
+        for (int b = b0; b <= b1; ++b)
+        {
+            double v = static_cast<double>(b - b0) / (b1 - b0);
+            double w00 = (1 - u) * (1 - v), w10 = u * (1 - v), w01 = (1 - u) * v, w11 = u * v;
+            pixelsX[a * ny + b] = w00 * pixelsX[k00] + w10 * pixelsX[k10] + w01 * pixelsX[k01] + w11 * pixelsX[k11];
+            pixelsY[a * ny + b] = w00 * pixelsY[k00] + w10 * pixelsY[k10] + w01 * pixelsY[k01] + w11 * pixelsY[k11];
+        }
+    }
+}
+
+// Image coordinates of the samples of the screen grid, kept while the
+// projection and the transformation of the image don't change.
+// The rows of a non cylindrical map are not at a constant latitude: the
+// samples are transformed exactly on a coarse grid only, and interpolated
+// in the cells where the bilinear interpolation is close enough.
+void SatellitePlotter::updatePixelsGrid(const Projection *proj,
+                                        const std::shared_ptr<const ScreenMapGrid> &grid)
+{
+    if (grid == pixelsGrid && reader.data() == pixelsReader
+            && reader->getTransformGeneration() == pixelsTransformGeneration)
+        return;
+    pixelsGrid = grid;
+    pixelsReader = reader.data();
+    pixelsTransformGeneration = reader->getTransformGeneration();
+
+    int nx = grid->getNx();
+    int ny = grid->getNy();
+    pixelsX.resize(nx * ny);
+    pixelsY.resize(nx * ny);
+    if (proj->isCylindrical() || nx < 2 || ny < 2)
+    {
+        transformPixels(0, nx - 1, 0, ny - 1);
+        return;
+    }
+    const int cellSize = 8;     // samples (even)
+    transformPixels(0, nx - 1, 0, ny - 1, cellSize, cellSize);
+    std::vector<QRect> exactCells;
+    for (int a0 = 0; a0 < nx - 1; a0 += cellSize)
+    {
+        int a1 = std::min(a0 + cellSize, nx - 1);
+        for (int b0 = 0; b0 < ny - 1; b0 += cellSize)
+        {
+            int b1 = std::min(b0 + cellSize, ny - 1);
+            if (a1 - a0 == cellSize && b1 - b0 == cellSize && isPixelsCellLinear(a0, a1, b0, b1))
+                interpolatePixelsCell(a0, a1, b0, b1);
+            else
+                exactCells.push_back(QRect(QPoint(a0, b0), QPoint(a1, b1)));
+        }
+    }
+    // after the interpolations: the shared edges are exact
+    for (const QRect &r : exactCells)
+        transformPixels(r.left(), r.right(), r.top(), r.bottom());
+}
+
+// Distance between consecutive samples of the grid, in pixels of the full
+// image (smallest value found in the view)
+double SatellitePlotter::getPixelsPerSample(int xSize, int ySize) const
+{
+    const int samplesNumber = 16;
+    double minSpacing = -1;
+    int nx = pixelsGrid->getNx();
+    int ny = pixelsGrid->getNy();
+    if (nx < 2 || ny < 2)
+        return 1;
+    for (int si = 0; si < samplesNumber; ++si)
+    {
+        int a = (nx - 2) * si / (samplesNumber - 1);
+        for (int sj = 0; sj < samplesNumber; ++sj)
+        {
+            int b = (ny - 2) * sj / (samplesNumber - 1);
+            int k0 = a * ny + b;
+            int k1 = k0 + ny;
+            int k2 = k0 + 1;
+            if (pixelsX[k0] < 0 || pixelsX[k0] >= xSize || pixelsY[k0] < 0 || pixelsY[k0] >= ySize)
+                continue;
+            double spacing = std::max(std::hypot(pixelsX[k1] - pixelsX[k0], pixelsY[k1] - pixelsY[k0]),
+                                      std::hypot(pixelsX[k2] - pixelsX[k0], pixelsY[k2] - pixelsY[k0]));
+            if (minSpacing < 0 || spacing < minSpacing)
+                minSpacing = spacing;
+        }
+    }
+    return (minSpacing < 0) ? 1 : minSpacing;
+}
+
 void SatellitePlotter::draw(QPainter &pnt, Projection *proj)
 {
     if (!isReaderOk())
@@ -107,22 +252,55 @@ void SatellitePlotter::draw(QPainter &pnt, Projection *proj)
     GDALRasterBand *bands[3];
     fillBands(bands);
 
-    SatelliteImageEqualizer equalizer(bands[0]);
-        
-    double lon, lat, pixelX, pixelY;
-    for (int i = 0; i < W - 1; i += 2)
+    int xSize = bands[0]->GetXSize();
+    int ySize = bands[0]->GetYSize();
+    SatelliteBlockCache &cache = reader->getBlockCache();
+    updatePixelsGrid(proj, ScreenMapGrid::get(proj, 2));
+
+    // Read the overview level matching the screen resolution
+    int bandsCount = rgb ? 3 : 1;
+    double pixelsPerSample = getPixelsPerSample(xSize, ySize);
+    BandSampler samplers[3] = {};
+    for (int k = 0; k < bandsCount; ++k)
+        samplers[k] = {reader->getOverview(bands[k], pixelsPerSample), getNoDataValue(bands[k])};
+    int dataXSize = samplers[0].band->GetXSize();
+    int dataYSize = samplers[0].band->GetYSize();
+    for (int k = 1; k < bandsCount; ++k)
+    {
+        if (samplers[k].band->GetXSize() != dataXSize || samplers[k].band->GetYSize() != dataYSize)
+        {
+            for (int n = 0; n < bandsCount; ++n)
+                samplers[n].band = bands[n];
+            dataXSize = xSize;
+            dataYSize = ySize;
+            break;
+        }
+    }
+    const SatelliteImageEqualizer *equalizer = rgb ? nullptr : &reader->getEqualizer(bands[0]);
+    double scaleX = static_cast<double>(dataXSize) / xSize;
+    double scaleY = static_cast<double>(dataYSize) / ySize;
+
+    int nx = pixelsGrid->getNx();
+    int ny = pixelsGrid->getNy();
+    for (int a = 0; a < nx; ++a)
     {
-        for (int j = 0; j < H - 1; j += 2)
+        int i = 2 * a;
+        const double *columnX = pixelsX.data() + a * ny;
+        const double *columnY = pixelsY.data() + a * ny;
+        for (int b = 0; b < ny; ++b)
         {
-            screenToMap(proj, i, j, &lon, &lat);
-            reader->transformMapToScreen(lon, lat, &pixelX, &pixelY);
-            if (!isPointInsideBounds(pixelX, pixelY, bands[0]))
+            int j = 2 * b;
+            double pixelX = columnX[b];
+            double pixelY = columnY[b];
+            if (pixelX < 0 || pixelX >= xSize || pixelY < 0 || pixelY >= ySize)
                 continue;
+            int x = std::min(static_cast<int>(pixelX * scaleX), dataXSize - 1);
+            int y = std::min(static_cast<int>(pixelY * scaleY), dataYSize - 1);
 
             if (rgb)
-                drawPixelRGB(image, i, j, pixelX, pixelY, bands);
+                drawPixelRGB(image, i, j, x, y, samplers, cache);
             else
-                drawPixelGrayscale(image, i, j, pixelX, pixelY, bands[0], equalizer);
+                drawPixelGrayscale(image, i, j, x, y, samplers[0], cache, *equalizer);
         }
     }
     pnt.drawImage(0, 0, *image);
@@ -155,6 +333,7 @@ void SatellitePlotter::fillBands(GDALRasterBand *bands[3])
 void SatellitePlotter::loadFile(const QString &fileName,
                                 LongTaskProgress *taskProgress)
 {
+    pixelsGrid.reset();
     reader = QSharedPointer<SatelliteReader>(new SatelliteReader());
     if (taskProgress != nullptr)
     {
@@ -22,11 +22,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "LongTaskProgress.h"
 #include "IsoLine.h"
 #include "SatelliteReader.h"
+#include "ScreenMapGrid.h"
  
 #include <QPainter>
 #include "gdal_priv.h"
 #include <QSharedPointer>
 
+#include <memory>
+#include <vector>
+
 class SatellitePlotter
 {
     public:
@@ -47,6 +51,12 @@ class SatellitePlotter
     
     private:
         void fillBands(GDALRasterBand *bands[3]);
+        void updatePixelsGrid(const Projection *proj,
+                              const std::shared_ptr<const ScreenMapGrid> &grid);
+        void transformPixels(int a0, int a1, int b0, int b1, int stepA = 1, int stepB = 1);
+        bool isPixelsCellLinear(int a0, int a1, int b0, int b1);
+        void interpolatePixelsCell(int a0, int a1, int b0, int b1);
+        double getPixelsPerSample(int xSize, int ySize) const;
 
         QSharedPointer<SatelliteReader> reader;
         QString fileName;
@@ -54,6 +64,12 @@ class SatellitePlotter
         int layer;
         int subdataset;
         bool rgb;
+
+        // Image coordinates of the screen samples (column major: a*ny+b)
+        std::shared_ptr<const ScreenMapGrid> pixelsGrid;
+        const SatelliteReader *pixelsReader;
+        unsigned int pixelsTransformGeneration;
+        std::vector<double> pixelsX, pixelsY;
 };
 
 #endif // SATELLITEPLOTTER_H
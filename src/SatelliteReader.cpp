@@ -22,10 +22,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "gdal_priv.h"
 #include <QDebug>
 
+#include <algorithm>
+#include <vector>
+
+// Overviews are built down to this size (pixels)
+static const int OVERVIEW_MIN_SIZE = 512;
+
 SatelliteReader::SatelliteReader()
-    : transformation(Transformation::None), dataset(nullptr), subdataset(nullptr), activeDataset(nullptr), openSubdatasetNumber(-1)
+    : transformation(Transformation::None), transformGeneration(0), dataset(nullptr), subdataset(nullptr), activeDataset(nullptr), openSubdatasetNumber(-1),
+    isBuildingOverviews(false), overviewsCanceled(false)
 {
     CPLSetConfigOption("L1B_HIGH_GCP_DENSITY", "NO");
+    CPLSetConfigOption("COMPRESS_OVERVIEW", "DEFLATE");
     GDALAllRegister();
 }
 
@@ -59,6 +67,7 @@ void SatelliteReader::openSubdataset(int subdatasetNumber)
     if (openSubdatasetNumber == subdatasetNumber)
         return;
     closeSubdataset();
+    clearBandsCaches();
     subdataset = static_cast<GDALDataset*>(GDALOpen(qPrintable(subdatasets[subdatasetNumber].path), GA_ReadOnly));
     activeDataset = subdataset;
     openSubdatasetNumber = subdatasetNumber;
@@ -71,6 +80,7 @@ void SatelliteReader::closeSubdataset()
     if (subdataset == nullptr)
         return;
 
+    clearBandsCaches();
     GDALClose(subdataset);
     subdataset = nullptr;
     activeDataset = dataset;
@@ -78,6 +88,192 @@ void SatelliteReader::closeSubdataset()
     initTransform();
 }
 
+static int CPL_STDCALL overviewsProgress(double, const char *, void *data)
+{
+    return !static_cast<std::atomic<bool>*>(data)->load();
+}
+
+// Downsampled copies of the image, used when the map is zoomed out.
+// They are kept on disk in a .ovr file: a GeoTIFF of the image at half
+// resolution, whose internal overviews are the next levels (as the .ovr
+// files of GDAL, which finds the file of an image the next times it is
+// opened). A subdataset isn't a file: its overviews are named after the
+// parent file and the number of the subdataset.
+QString SatelliteReader::getOverviewsPath(GDALDataset *ds) const
+{
+    if (ds == subdataset)
+        return QString("%1.sds%2.ovr").arg(dataset->GetDescription()).arg(openSubdatasetNumber + 1);
+    return QString("%1.ovr").arg(ds->GetDescription());
+}
+
+// Overviews built by the reader for the dataset; the first call
+// starts the build (one at a time, the next calls ask again).
+GDALDataset *SatelliteReader::getOverviewsFile(GDALDataset *ds)
+{
+    QString name = ds->GetDescription();
+    QMutexLocker lock(&overviewsMutex);
+    auto it = overviewsFiles.find(name);
+    if (it != overviewsFiles.end())
+        return it->second;
+    if (isBuildingOverviews)
+        return nullptr;
+
+    QString path = getOverviewsPath(ds);
+    VSIStatBufL stat;
+    if (VSIStatL(qPrintable(path), &stat) == 0)
+    {
+        // built before (GDAL doesn't find the files of the subdatasets)
+        GDALDataset *ovr = static_cast<GDALDataset*>(GDALOpen(qPrintable(path), GA_ReadOnly));
+        if (ovr != nullptr)
+        {
+            overviewsFiles[name] = ovr;
+            return ovr;
+        }
+    }
+    if (overviewsThread.joinable())
+        overviewsThread.join();     // previous build, finished
+    isBuildingOverviews = true;
+    overviewsCanceled = false;
+    overviewsThread = std::thread(&SatelliteReader::buildOverviewsFile, this, name, path);
+    return nullptr;
+}
+
+// In the thread of the build: the image is read with its own dataset,
+// the drawing uses the other one.
+void SatelliteReader::buildOverviewsFile(const QString &name, const QString &path)
+{
+    GDALDataset *ovr = nullptr;
+    GDALDataset *src = static_cast<GDALDataset*>(GDALOpen(qPrintable(name), GA_ReadOnly));
+    if (src != nullptr)
+    {
+        ovr = createOverviewsFile(src, path);
+        GDALClose(src);
+    }
+    {
+        QMutexLocker lock(&overviewsMutex);
+        overviewsFiles[name] = ovr;
+        isBuildingOverviews = false;
+    }
+    if (ovr != nullptr)
+        emit overviewsReady();
+}
+
+GDALDataset *SatelliteReader::createOverviewsFile(GDALDataset *src, const QString &path)
+{
+    int count = src->GetRasterCount();
+    int xSize = src->GetRasterXSize();
+    int ySize = src->GetRasterYSize();
+    // levels of the .ovr file, relative to its image at half resolution
+    std::vector<int> levels;
+    for (int factor = 2; std::max(xSize, ySize) / (2 * factor) >= OVERVIEW_MIN_SIZE; factor *= 2)
+        levels.push_back(factor);
+    GDALDriver *driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    if (count == 0 || std::max(xSize, ySize) / 2 < OVERVIEW_MIN_SIZE || driver == nullptr)
+        return nullptr;
+    for (int k = 1; k <= count; ++k)
+    {
+        GDALRasterBand *band = src->GetRasterBand(k);
+        if (band->GetXSize() != xSize || band->GetYSize() != ySize)
+            return nullptr;
+    }
+
+    // written under another name: an incomplete file is never used
+    QString tmpPath = path + ".tmp";
+    char **options = CSLSetNameValue(nullptr, "COMPRESS", "DEFLATE");
+    options = CSLSetNameValue(options, "TILED", "YES");
+    CPLPushErrorHandler(CPLQuietErrorHandler);
+    GDALDataset *dst = driver->Create(qPrintable(tmpPath), (xSize + 1) / 2, (ySize + 1) / 2, count,
+                                      src->GetRasterBand(1)->GetRasterDataType(), options);
+    CSLDestroy(options);
+    bool ok = dst != nullptr;
+    for (int k = 1; ok && k <= count; ++k)
+    {
+        GDALRasterBand *band = src->GetRasterBand(k);
+        GDALRasterBandH target = dst->GetRasterBand(k);
+        int hasNoData = FALSE;
+        double noData = band->GetNoDataValue(&hasNoData);
+        if (hasNoData)
+            dst->GetRasterBand(k)->SetNoDataValue(noData);
+        ok = GDALRegenerateOverviews(band, 1, &target, "AVERAGE",
+                                     overviewsProgress, &overviewsCanceled) == CE_None;
+    }
+    if (ok && !levels.empty())
+        ok = dst->BuildOverviews("AVERAGE", levels.size(), levels.data(), 0, nullptr,
+                                 overviewsProgress, &overviewsCanceled) == CE_None;
+    if (dst != nullptr)
+        GDALClose(dst);
+    CPLPopErrorHandler();
+    if (!ok || VSIRename(qPrintable(tmpPath), qPrintable(path)) != 0)
+    {
+        // read-only directory, canceled...: the full image is used
+        qDebug() << "Could not build overviews:" << path;
+        VSIUnlink(qPrintable(tmpPath));
+        return nullptr;
+    }
+    return static_cast<GDALDataset*>(GDALOpen(qPrintable(path), GA_ReadOnly));
+}
+
+void SatelliteReader::stopOverviewsBuild()
+{
+    overviewsCanceled = true;
+    if (overviewsThread.joinable())
+        overviewsThread.join();
+    overviewsCanceled = false;
+    isBuildingOverviews = false;
+    for (auto &file : overviewsFiles)
+    {
+        if (file.second != nullptr)
+            GDALClose(file.second);
+    }
+    overviewsFiles.clear();
+}
+
+const SatelliteImageEqualizer &SatelliteReader::getEqualizer(GDALRasterBand *band)
+{
+    std::unique_ptr<SatelliteImageEqualizer> &equalizer = equalizers[band];
+    if (!equalizer)
+        equalizer.reset(new SatelliteImageEqualizer(band));
+    return *equalizer;
+}
+
+// Must be called before the bands are destroyed
+void SatelliteReader::clearBandsCaches()
+{
+    blockCache.clear();
+    equalizers.clear();
+}
+
+GDALRasterBand *SatelliteReader::getOverview(GDALRasterBand *band, double pixelsPerSample)
+{
+    GDALRasterBand *best = band;
+    double bestFactor = 1;
+    auto consider = [&](GDALRasterBand *overview) {
+        if (overview == nullptr || overview->GetXSize() == 0)
+            return;
+        double factor = static_cast<double>(band->GetXSize()) / overview->GetXSize();
+        if (factor <= pixelsPerSample && factor > bestFactor)
+        {
+            best = overview;
+            bestFactor = factor;
+        }
+    };
+    for (int i = 0; i < band->GetOverviewCount(); ++i)
+        consider(band->GetOverview(i));
+
+    // no overviews in the file: those of the reader, once needed
+    if (band->GetOverviewCount() == 0 && pixelsPerSample >= 2 && band->GetDataset() != nullptr)
+    {
+        GDALDataset *ovr = getOverviewsFile(band->GetDataset());
+        if (ovr != nullptr && band->GetBand() <= ovr->GetRasterCount())
+        {
+            GDALRasterBand *level = ovr->GetRasterBand(band->GetBand());
+            consider(level);
+            for (int i = 0; i < level->GetOverviewCount(); ++i)
+                consider(level->GetOverview(i));
+        }
+    }
+    return best;
+}
 
 bool SatelliteReader::isOk() const
 {
@@ -86,7 +282,9 @@ bool SatelliteReader::isOk() const
 
 void SatelliteReader::closeCurrentFile()
 {
+    stopOverviewsBuild();
     closeSubdataset();
+    clearBandsCaches();
     if (dataset != nullptr)
     {
         GDALClose(dataset);
@@ -153,6 +351,26 @@ void SatelliteReader::transformMapToScreen(double lon, double lat, double *x, do
     }
 }
 
+void SatelliteReader::transformMapToScreen(int count, double *x, double *y)
+{
+    if (transformation == Transformation::TransofrmArray)
+    {
+        for (int i = 0; i < count; ++i)
+            GDALApplyGeoTransform(invTransform, x[i], y[i], &x[i], &y[i]);
+    }
+    else if (transformation == Transformation::GCPTransform)
+    {
+        std::vector<double> z(count, 0);
+        std::vector<int> success(count, FALSE);
+        GDALApproxTransform(approxTransformAlg.data(), TRUE, count, x, y, z.data(), success.data());
+        for (int i = 0; i < count; ++i)
+        {
+            if (!success[i])
+                x[i] = y[i] = -1;
+        }
+    }
+}
+
 void SatelliteReader::transformScreenToMap(double x, double y, double *lon, double *lat)
 {
     if (transformation == Transformation::TransofrmArray)
@@ -165,7 +383,7 @@ void SatelliteReader::transformScreenToMap(double x, double y, double *lon, doub
         *lat = y;
         double z = 0;
         int success;
-        GDALGCPTransform(transformAlg.data(), false, 1, lon, lat, &z, &success);
+        GDALTPSTransform(transformAlg.data(), false, 1, lon, lat, &z, &success);
     }
 }
 
@@ -180,6 +398,7 @@ void SatelliteReader::initSubdatasets()
 
 void SatelliteReader::initTransform()
 {
+    ++transformGeneration;
     if (activeDataset == nullptr)
     {
         transformation = Transformation::None;
@@ -216,11 +435,15 @@ bool SatelliteReader::setGCPTransform()
     QVector<GDAL_GCP> filteredGCPs = filterGCPS(GCPs, GCPCount);
     if (filteredGCPs.empty())
         return false;
+    approxTransformAlg.reset();
     transformAlg = QSharedPointer<char>((char*)GDALCreateTPSTransformer(filteredGCPs.count(), &filteredGCPs[0], false),
                                         GDALDestroyTPSTransformer);
 
     if (transformAlg != nullptr)
     {
+        approxTransformAlg = QSharedPointer<char>(
+                (char*)GDALCreateApproxTransformer(GDALTPSTransform, transformAlg.data(), 0.125),
+                GDALDestroyApproxTransformer);
         transformation = Transformation::GCPTransform;
         return true;
     }
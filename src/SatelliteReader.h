@@ -21,13 +21,22 @@
 
 #include "RegularGridded.h"
 #include "LongTaskMessage.h"
+#include "SatelliteBlockCache.h"
+#include "SatelliteImageEqualizer.h"
 
 #include "gdal_priv.h"
+#include <QMutex>
 #include <QString>
 #include <QSharedPointer>
 
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+
 class SatelliteReader : public LongTaskMessage
 {
+    Q_OBJECT
 public:
     struct Subdataset
     {
@@ -48,7 +57,27 @@ public:
     GDALRasterBand *getRecord(int subdatasetNumber, int bandNumber);
     GDALRasterBand* getSubdataset(int subdatasetNumber);
 
+    // Pixel values of the bands of the active dataset
+    SatelliteBlockCache &getBlockCache() { return blockCache; }
+    // Equalization table of a band, computed at the first call
+    const SatelliteImageEqualizer &getEqualizer(GDALRasterBand *band);
+
+    // Coarsest overview of the band (or the band itself) whose pixels
+    // are not larger than pixelsPerSample pixels of the full image.
+    // An image without overviews gets them the first time they are
+    // needed: they are built in the background (the full image is used
+    // meanwhile), then overviewsReady() is emitted.
+    GDALRasterBand *getOverview(GDALRasterBand *band, double pixelsPerSample);
+
     void transformMapToScreen(double lon, double lat, double *x, double *y);
+    // Same for arrays of points, in place (lon -> x, lat -> y); points
+    // which can't be transformed are set to -1. The thin-plate-spline
+    // transformation is approximated (error < 0.125 pixel) along the array:
+    // the points should follow a line, best at a constant latitude
+    // (a row of the screen of a cylindrical map).
+    void transformMapToScreen(int count, double *x, double *y);
+    // Changes each time the transformation is modified
+    unsigned int getTransformGeneration() const { return transformGeneration; }
     void transformScreenToMap(double x, double y, double *lon, double *lat);
 
     int getSubdatasetsNumber() const;
@@ -58,6 +87,9 @@ public:
     QString getBandDescription(int bandNumber) const;
     QString getSubdatasetBandDescriptiion(int subdatasetNumber, int bandNumber);
 
+signals:
+    void overviewsReady();
+
 private:
     void initTransform();
     bool setGCPTransform();
@@ -65,6 +97,15 @@ private:
     void initSubdatasets();
     void openSubdataset(int subdatasetNumber);
     void closeSubdataset();
+    void clearBandsCaches();
+
+    // Overviews built by the reader, kept on disk in a .ovr file
+    // (by name of the dataset; nullptr: the image has no overviews)
+    QString getOverviewsPath(GDALDataset *ds) const;
+    GDALDataset *getOverviewsFile(GDALDataset *ds);
+    void buildOverviewsFile(const QString &name, const QString &path);
+    GDALDataset *createOverviewsFile(GDALDataset *src, const QString &path);
+    void stopOverviewsBuild();
 
     enum class Transformation 
     {
@@ -74,6 +115,8 @@ private:
     } transformation;
 
     QSharedPointer<char> transformAlg;
+    QSharedPointer<char> approxTransformAlg;    // uses transformAlg
+    unsigned int transformGeneration;
     GDALDataset *dataset;
     GDALDataset* subdataset;
     GDALDataset* activeDataset;
@@ -81,5 +124,12 @@ private:
     double transform[6];
     double invTransform[6];
     QVector<Subdataset> subdatasets;
+    SatelliteBlockCache blockCache;
+    std::map<GDALRasterBand*, std::unique_ptr<SatelliteImageEqualizer>> equalizers;
+    QMutex overviewsMutex;
+    std::map<QString, GDALDataset*> overviewsFiles;
+    std::thread overviewsThread;    // one build at a time
+    bool isBuildingOverviews;
+    std::atomic<bool> overviewsCanceled;
 };
 #endif // SATTELLITEREADER_H
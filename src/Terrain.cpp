@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <cassert>
+#include <algorithm>
+#include <cmath>
 
 #include <QApplication>
 #include <QMouseEvent>
@@ -25,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QPainter>
 #include <QProgressDialog>
 #include <QMessageBox>
+#include <QElapsedTimer>
 
 #include "Terrain.h"
 #include "Orthodromie.h"
@@ -57,11 +60,32 @@ Terrain::Terrain (QWidget *parent, Projection *proj, std::shared_ptr<GshhsReader
     assert(timerZoomWheel);
     timerZoomWheel->setSingleShot(true);
     connect(timerZoomWheel, SIGNAL(timeout()), this, SLOT(slotTimerZoomWheel()));
-    deltaZoomWheel = 1.0;
+    isZoomingWheel = false;
+    
+    timerInteractive = new QTimer(this);
+    assert(timerInteractive);
+    timerInteractive->setSingleShot(true);
+    connect(timerInteractive, SIGNAL(timeout()), this, SLOT(slotTimerInteractive()));
+    interactiveRendering = false;
+    
+    timerTiles = new QTimer(this);
+    assert(timerTiles);
+    timerTiles->setSingleShot(true);
+    connect(timerTiles, SIGNAL(timeout()), this, SLOT(slotTimerTiles()));
+    isDrawingTiles = false;
+    dragOriginX = dragOriginY = 0;
+    tileCache.setMaxSize (Util::getSetting("mapTilesCacheSize", 128).toInt());
     
 	//---------------------------------------------------
 	drawer = new MapDrawer(gshhsReader);
 	assert(drawer);
+	renderThread = new MapRenderThread ();
+	assert(renderThread);
+	connect(renderThread, SIGNAL(frameReady()), this, SLOT(slotFrameReady()));
+	connect(renderThread, SIGNAL(tilesReady()), this, SLOT(slotTilesReady()));
+	frameProj = nullptr;
+	isMapMoved = false;
+	mustClearLayers = false;
 	currentFileType = DATATYPE_NONE;
     
     //----------------------------------------------------------------------------
@@ -99,15 +123,20 @@ Terrain::Terrain (QWidget *parent, Projection *proj, std::shared_ptr<GshhsReader
 
     setMouseLeftSelect(true);
 }
+//---------------------------------------------------------
+Terrain::~Terrain ()
+{
+	emit stoppingMapRendering ();	// animations
+	delete renderThread;	// stops the drawing
+	delete frameProj;
+}
 //-------------------------------------------
 void Terrain::updateGraphicsParameters()
 {            
     drawer->updateGraphicsParameters();
 	if (griddedPlot)
 		griddedPlot->updateGraphicsParameters();
-	isEarthMapValid = false;
-	mustRedraw = true;
-    update();
+	invalidateMap (MAP_PLOTTER | MAP_EARTH);
 }
 //-------------------------------------------------------
 void Terrain::createCrossCursor ()
@@ -247,8 +276,7 @@ void Terrain::setDrawRivers(bool b) {
     if (drawer->showRivers != b) {
         drawer->showRivers = b;
         Util::setSetting("showRivers", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -256,8 +284,7 @@ void Terrain::setDrawLonLatGrid(bool b) {
     if (drawer->showLonLatGrid != b) {
         drawer->showLonLatGrid = b;
         Util::setSetting("showLonLatGrid", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -265,8 +292,7 @@ void Terrain::slotTemperatureLabels(bool b) {
     if (drawer->showTemperatureLabels != b) {
         drawer->showTemperatureLabels = b;
         Util::setSetting("showTemperatureLabels", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -283,8 +309,7 @@ void Terrain::setDrawCountriesBorders(bool b) {
     if (drawer->showCountriesBorders != b) {
         drawer->showCountriesBorders = b;
         Util::setSetting("showCountriesBorders", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -292,8 +317,7 @@ void Terrain::setCountriesNames(bool b) {
     if (drawer->showCountriesNames != b) {
         drawer->showCountriesNames = b;
         Util::setSetting("showCountriesNames", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -301,8 +325,7 @@ void Terrain::setCitiesNamesLevel  (int level) {
     if (drawer->showCitiesNamesLevel != level) {
         drawer->showCitiesNamesLevel = level;
         Util::setSetting("showCitiesNamesLevel", level);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -310,12 +333,12 @@ void Terrain::setWaveArrowsType  (int type) {
     if (drawer->showWaveArrowsType != type) {
         drawer->showWaveArrowsType = type;
         Util::setSetting("waveArrowsType", type);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
 void Terrain::setMapQuality (int q) {
+    stopMapRendering();
     indicateWaitingMap();
     if (quality != q) {
         if (drawer->gshhsReader.get() == nullptr)
@@ -326,40 +349,39 @@ void Terrain::setMapQuality (int q) {
         QCursor oldcursor = cursor();
         setCursor(Qt::WaitCursor);
             drawer->gshhsReader.get()->setUserPreferredQuality(q);
-            isEarthMapValid = false;
-            update();
+            invalidateMap (MAP_EARTH);
         setCursor(oldcursor);
         pleaseWait = false;
     }
 }
 //-------------------------------------------------------
 void Terrain::setDuplicateMissingWaveRecords (bool b) {
+    stopMapRendering();
     if (duplicateMissingWaveRecords != b) {
         duplicateMissingWaveRecords = b;
         Util::setSetting("duplicateMissingWaveRecords", b);
 	    griddedPlot->duplicateMissingWaveRecords (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
 void Terrain::setDuplicateFirstCumulativeRecord (bool b) {
+    stopMapRendering();
     if (duplicateFirstCumulativeRecord != b) {
         duplicateFirstCumulativeRecord = b;
         Util::setSetting("duplicateFirstCumulativeRecord", b);
 	    griddedPlot->duplicateFirstCumulativeRecord (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
 void Terrain::setInterpolateMissingRecords (bool b) {
+    stopMapRendering();
     if (interpolateMissingRecords != b) {
         interpolateMissingRecords = b;
         Util::setSetting("interpolateMissingRecords", b);
 	    griddedPlot->interpolateMissingRecords (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
@@ -368,8 +390,7 @@ void Terrain::setInterpolateValues (bool b) {
         interpolateValues = b;
         Util::setSetting("interpolateValues", b);
 	    griddedPlot->setInterpolateValues (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
@@ -378,8 +399,7 @@ void Terrain::setWindArrowsOnGribGrid (bool b) {
         windArrowsOnGribGrid = b;
         Util::setSetting("windArrowsOnGribGrid", b);
 	    griddedPlot->setWindArrowsOnGrid (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
@@ -390,14 +410,18 @@ void Terrain::setColorMapData (const DataCode &dtc)
     {
 		Util::setSetting ("colorMapData", DataCodeStr::serialize(dtc));
         drawer->setColorMapData (dtc);
+        int changes = MAP_OVERLAYS;
         if (griddedPlot!=nullptr && griddedPlot->isReaderOk()) {
-			griddedPlot->setUseJetStreamColorMap (
-						Util::getSetting("useJetStreamColorMap", false).toBool());
-			griddedPlot->setUseGustColorAbsolute (
-						Util::getSetting("useAbsoluteGustSpeed", false).toBool());
+			bool jet = Util::getSetting("useJetStreamColorMap", false).toBool();
+			bool gust = Util::getSetting("useAbsoluteGustSpeed", false).toBool();
+			if (griddedPlot->getUseJetStreamColorMap() != jet
+					|| griddedPlot->getUseGustColorAbsolute() != gust) {
+				griddedPlot->setUseJetStreamColorMap (jet);
+				griddedPlot->setUseGustColorAbsolute (gust);
+				changes = MAP_PLOTTER;
+			}
 		}
-        mustRedraw = true;
-        update();
+        invalidateMap (changes);
     }
 }
 //-------------------------------------------------------
@@ -406,8 +430,7 @@ void Terrain::setCurrentArrowsOnGribGrid (bool b) {
         currentArrowsOnGribGrid = b;
         Util::setSetting("currentArrowsOnGribGrid", b);
 	    griddedPlot->setCurrentArrowsOnGrid (b);
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
@@ -415,8 +438,7 @@ void Terrain::setColorMapSmooth (bool b) {
     if (drawer->colorMapSmooth != b) {
         drawer->colorMapSmooth = b;
         Util::setSetting("colorMapSmooth", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -424,8 +446,7 @@ void Terrain::setDrawCurrentArrows (bool b) {
     if (drawer->showCurrentArrows != b) {
         drawer->showCurrentArrows = b;
         Util::setSetting("showCurrentArrows", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -433,8 +454,7 @@ void Terrain::setDrawWindArrows (bool b) {
     if (drawer->showWindArrows != b) {
         drawer->showWindArrows = b;
         Util::setSetting("showWindArrows", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -442,8 +462,7 @@ void Terrain::setBarbules (bool b) {
     if (drawer->showBarbules != b) {
         drawer->showBarbules = b;
         Util::setSetting("showBarbules", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -454,8 +473,7 @@ void Terrain::setThinArrows (bool b) {
 		if (griddedPlot) {
 			griddedPlot->updateGraphicsParameters ();
 		}
-        mustRedraw = true;
-        update();
+        invalidateMap (MAP_PLOTTER);
     }
 }
 //-------------------------------------------------------
@@ -463,8 +481,7 @@ void Terrain::setGribGrid (bool b) {
     if (drawer->showGribGrid != b) {
         drawer->showGribGrid = b;
         Util::setSetting("showGribGrid", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -472,8 +489,7 @@ void Terrain::setPressureMinMax (bool b) {
     if (drawer->showPressureMinMax != b) {
         drawer->showPressureMinMax = b;
         Util::setSetting("showPressureMinMax", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 
@@ -482,8 +498,7 @@ void Terrain::setDrawIsobars (bool b) {
     if (drawer->showIsobars != b) {
         drawer->showIsobars = b;
         Util::setSetting("showIsobars", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -492,8 +507,7 @@ void Terrain::setIsobarsStep (double step)
     if (drawer->isobarsStep != step) {
         Util::setSetting("isobarsStep", step);
         drawer->isobarsStep = step;
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -501,8 +515,7 @@ void Terrain::setDrawIsobarsLabels (bool b) {
     if (drawer->showIsobarsLabels != b) {
         drawer->showIsobarsLabels = b;
         Util::setSetting("showIsobarsLabels", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //=============================================================
@@ -510,8 +523,7 @@ void Terrain::setDrawIsotherms0 (bool b) {
     if (drawer->showIsotherms0 != b) {
         drawer->showIsotherms0 = b;
         Util::setSetting("showIsotherms0", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -520,8 +532,7 @@ void Terrain::setIsotherms0Step (double step)
     if (drawer->isotherms0Step != step) {
         Util::setSetting("isotherms0Step", step);
         drawer->isotherms0Step = step;
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -529,8 +540,7 @@ void Terrain::setDrawIsotherms0Labels (bool b) {
     if (drawer->showIsotherms0Labels != b) {
         drawer->showIsotherms0Labels = b;
         Util::setSetting("showIsotherms0Labels", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //=================================================================
@@ -540,8 +550,7 @@ void Terrain::setIsotherms_Altitude (Altitude alt)
         drawer->isothermsAltitude = alt;
 		//DBGQS (AltitudeStr::toString (alt));
         Util::setSetting ("isothermsAltitude", AltitudeStr::serialize(alt));
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -549,8 +558,7 @@ void Terrain::setDrawIsotherms (bool b) {
     if (drawer->showIsotherms != b) {
         drawer->showIsotherms = b;
         Util::setSetting("showIsotherms", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -559,8 +567,7 @@ void Terrain::setIsotherms_Step (double step)
     if (drawer->isotherms_Step != step) {
 		Util::setSetting("isotherms_Step", step);
 		drawer->isotherms_Step = step;
-		mustRedraw = true;
-		update();
+		invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -568,8 +575,7 @@ void Terrain::setDrawIsotherms_Labels (bool b) {
     if (drawer->showIsotherms_Labels != b) {
         drawer->showIsotherms_Labels = b;
         Util::setSetting("showIsotherms_Labels", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //=================================================================
@@ -579,8 +585,7 @@ void Terrain::setLinesThetaE_Altitude (Altitude alt)
         drawer->linesThetaEAltitude = alt;
 		DBGQS (AltitudeStr::toString (alt));
         Util::setSetting ("linesThetaEAltitude", AltitudeStr::serialize(alt));
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //=================================================================
@@ -589,8 +594,7 @@ void Terrain::setDrawSatelliteData(bool b)
     if (drawer->showSatelliteImages != b) {
         drawer->showSatelliteImages = b;
         Util::setSetting("showSatelliteImages", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -598,8 +602,7 @@ void Terrain::setDrawLinesThetaE (bool b) {
     if (drawer->showLinesThetaE != b) {
         drawer->showLinesThetaE = b;
         Util::setSetting("showLinesThetaE", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -607,8 +610,7 @@ void Terrain::setLinesThetaE_Step (double step) {
     if (drawer->linesThetaE_Step != step) {
 		Util::setSetting("linesThetaE_Step", step);
 		drawer->linesThetaE_Step = step;
-		mustRedraw = true;
-		update();
+		invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -616,8 +618,7 @@ void Terrain::setDrawLinesThetaE_Labels (bool b) {
     if (drawer->showLinesThetaE_Labels != b) {
         drawer->showLinesThetaE_Labels = b;
         Util::setSetting("showLinesThetaE_Labels", b);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 
@@ -673,6 +674,7 @@ bool  Terrain::getGribFileRectangle(double *x0, double *y0, double *x1, double *
 //---------------------------------------------------------
 FileDataType Terrain::loadMeteoDataFile (const QString& fileName, bool zoom)
 {
+    stopMapRendering();
     indicateWaitingMap();
 	currentFileType = DATATYPE_NONE;
 	bool ok = false;
@@ -681,6 +683,7 @@ FileDataType Terrain::loadMeteoDataFile (const QString& fileName, bool zoom)
 	assert (taskProgress);
 	taskProgress->continueDownload = true;
 	
+    drawingPlotter.reset ();	// shares the reader of griddedPlot
     if (griddedPlot != nullptr) {
 		delete griddedPlot;
         griddedPlot = nullptr;
@@ -756,15 +759,13 @@ FileDataType Terrain::loadMeteoDataFile (const QString& fileName, bool zoom)
 	isDraggingMapEnCours = false;
     selX0 = selY0 = 0;
     selX1 = selY1 = 0;
-    isEarthMapValid = false;
-	mustRedraw = true;
     if (zoom) {
         zoomOnFileZone();    // Zoom sur la zone couverte par le fichier GRIB
     }
 
     drawer -> initGraphicsParameters(); // reset the map drawer to app settings
 
-    update();
+	invalidateMap (MAP_PLOTTER | MAP_EARTH);
 
 	bool cancelled = ! taskProgress->continueDownload;
 	delete taskProgress;
@@ -794,6 +795,7 @@ SatellitePlotter *Terrain::getSatellitePlotter()
 //---------------------------------------------------------
 void Terrain::loadSatelliteDataFile(const QString &fileName)
 {
+    stopMapRendering();
     indicateWaitingMap();
 	bool ok = false;
 	
@@ -822,9 +824,12 @@ void Terrain::loadSatelliteDataFile(const QString &fileName)
 
 	taskProgress->setVisible (false);
 	satellitePlotter = satellitePlotterTemp;
+	if (satellitePlotter != nullptr)
+		connect (satellitePlotter->getReader(), SIGNAL(overviewsReady()),
+				 this, SLOT(slotMustRedraw()));
 
     drawer -> initGraphicsParameters(); // reset the map drawer to app settings
-    update();
+	invalidateMap ();
 
 	delete taskProgress;
     taskProgress = nullptr;
@@ -833,35 +838,36 @@ void Terrain::loadSatelliteDataFile(const QString &fileName)
 //-------------------------------------------------------
 void Terrain::setSatelliteLayer(int layer)
 {
+    stopMapRendering();
     if (satellitePlotter != nullptr)
     {
         satellitePlotter->setLayer(layer);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 
 //-------------------------------------------------------
 void Terrain::setSatelliteLayer(int subdataset, int layer)
 {
+    stopMapRendering();
     if (satellitePlotter != nullptr)
     {
         satellitePlotter->setLayer(subdataset, layer);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 
 //---------------------------------------------------------
 void   Terrain::closeMeteoDataFile()
 {
+    stopMapRendering();
+    drawingPlotter.reset ();
     if (griddedPlot != nullptr) {
 		delete griddedPlot;
         griddedPlot = nullptr;
 	}
 	currentFileType = DATATYPE_NONE;
-	mustRedraw = true;
-    update();
+	invalidateMap (MAP_PLOTTER);
 }
 
 //---------------------------------------------------------
@@ -923,9 +929,7 @@ void Terrain::zoomOnZone (double x0, double y0, double x1, double y1)
 void Terrain::slotMustRedraw()
 {
     indicateWaitingMap();
-    isEarthMapValid = false;
-	mustRedraw = true;
-    update();
+	invalidateMap (MAP_LAYERS | MAP_EARTH);
 }
 //---------------------------------------------------------
 void Terrain::setCurrentDate(time_t t)
@@ -933,9 +937,8 @@ void Terrain::setCurrentDate(time_t t)
     if (griddedPlot->getCurrentDate() != t)
     {
         indicateWaitingMap();
-        griddedPlot->setCurrentDate(t);
-		mustRedraw = true;
-        update();
+        griddedPlot->setCurrentDate(t);	// date of the next job
+        invalidateMap ();
     }
 }
 
@@ -992,25 +995,44 @@ void  Terrain::wheelEvent(QWheelEvent * e)
 //printf("wheelEvent\n");
     double k = 1 + .002 * e->delta();
 	
-    if (e->delta() != 0)
-		deltaZoomWheel *= k;
-    else {
+    if (e->delta() == 0) {
         e->ignore();
         return;
     }
+	// Zoom about the mouse: the last map is scaled at once (drawMapFrame),
+	// the new one is drawn when the wheel stops.
+	double lon, lat;
+	proj->screen2map(e->x(), e->y(), &lon, &lat);
+	proj->zoom(k);
+	proj->setMapPointInScreen(lon, lat, e->x(), e->y());
+	for (auto poi : getListPOIs()) {
+		poi->setProjection(proj);
+	}
+	isZoomingWheel = true;
+	update();
 
-	// Le timer évite les multiples update() pendant les changements de taille
-    timerZoomWheel->stop();	 // pas d'update() tout de suite
-    timerZoomWheel->start(10); // update() seulement après une petite inactivité
+	// Le timer évite les multiples dessins pendant les changements d'échelle
+    timerZoomWheel->stop();	 // pas de dessin tout de suite
+    timerZoomWheel->start(150); // seulement après une petite inactivité
 }
 //---------------------------------------------------------
 void Terrain::slotTimerZoomWheel () {
-    if (deltaZoomWheel != 1) {
+    if (isZoomingWheel) {
 		//printf("slotTimerZoomWheel\n");
-		proj->zoom(deltaZoomWheel);
-		deltaZoomWheel = 1;
+		isZoomingWheel = false;
+		interactiveRendering = true;
 		setProjection(proj);
 		//DBGN(proj->getScale());
+		timerInteractive->start(400);
+    }
+}
+//---------------------------------------------------------
+void Terrain::slotTimerInteractive () {
+    if (interactiveRendering) {
+		interactiveRendering = false;
+		isEarthMapValid = false;
+		mustRedraw = true;
+		update();
     }
 }
 
@@ -1022,7 +1044,6 @@ void Terrain::mousePressEvent (QMouseEvent * e) {
     {
         // Début de sélection de zone rectangulaire
 		if (e->modifiers() == Qt::ControlModifier) {
-		// TODO use  tiles to drag map
             setCursor(controlCursorClick);
 
             if (isMouseLeftSelect) {
@@ -1071,9 +1092,11 @@ void Terrain::mouseReleaseEvent (QMouseEvent * e) {
 	
     if (isDraggingMapEnCours)
     {
-		// TODO use  tiles to drag map
         isDraggingMapEnCours = false;
+        timerTiles->stop();
 		setProjection (proj);
+		// the previous map is shifted, only the uncovered parts are drawn
+		isMapMoved = true;
     }
     if (isSelectionZoneEnCours)
     {
@@ -1101,14 +1124,20 @@ void Terrain::mouseMoveEvent (QMouseEvent * e)
 {
     if (isDraggingMapEnCours)
     {
-		// TODO use  tiles to drag map
+		// Exact translation of the map, drawn from the tiles (see paintEvent).
+		// The complete map is drawn again when the mouse is released.
 		double x0, y0, x1, y1;
-		int mx = lastMouseX-e->x();
-		int my = lastMouseY-e->y();
-		proj->screen2map (mx, my,  &x0, &y0);
-		proj->screen2map (mx+width(), my+height(),  &x1, &y1);
-		proj->setVisibleArea (x0,y0, x1,y1);
-		setProjection (proj);
+		proj->getScreenOrigin (&x0, &y0);
+		x1 = x0 + lastMouseX-e->x();
+		y1 = y0 + lastMouseY-e->y();
+		proj->setScreenOrigin (x1, y1);
+		// the longitudes may have been shifted by 360°
+		proj->getScreenOrigin (&x0, &y0);
+		dragOriginX += x0-x1;
+		dragOriginY += y0-y1;
+		update();
+		if (! timerTiles->isActive())
+			timerTiles->start(0);
     }
     else if (isSelectionZoneEnCours)
     {
@@ -1171,6 +1200,121 @@ void Terrain::slotTimerResize () {
     }
 }
 
+//---------------------------------------------------------
+// Map rendering in MapRenderThread
+//---------------------------------------------------------
+void Terrain::startMapRendering ()
+{
+	MapRenderThread::Job job;
+	job.settings = std::make_shared <MapDrawer> (*drawer);
+	job.proj = proj->clone();
+	job.plotter = (currentFileType == DATATYPE_GRIB) ? drawingPlotter : nullptr;
+	job.date = getCurrentDate ();
+	job.satellitePlotter = satellitePlotter;
+	job.isEarthMapValid = isEarthMapValid;
+	job.clearLayers = mustClearLayers;
+	job.drawCartouche = drawCartouche;
+	job.interactive = interactiveRendering;
+	job.isMapMoved = isMapMoved;
+	job.previews = true;
+	isMapMoved = false;
+	mustClearLayers = false;
+	isDrawingTiles = false;		// canceled by the new job
+	renderThread->render (job);
+	isEarthMapValid = true;
+	mustRedraw = false;
+}
+//---------------------------------------------------------
+void Terrain::stopMapRendering ()
+{
+	isMapMoved = false;		// something else may change
+	emit stoppingMapRendering ();
+	renderThread->stop ();
+	isDrawingTiles = false;
+	mustRedraw = true;			// ask again for the map
+	update();
+}
+//---------------------------------------------------------
+void Terrain::invalidateMap (int changes)
+{
+	renderThread->cancel ();
+	isMapMoved = false;
+	isDrawingTiles = false;
+	if (changes & MAP_PLOTTER)
+		copyPlotter ();
+	if (changes & MAP_LAYERS)
+		mustClearLayers = true;
+	if (changes & MAP_EARTH)
+		isEarthMapValid = false;
+	mustRedraw = true;
+	tileCache.clear();
+	update();
+}
+//---------------------------------------------------------
+// The thread draws with a copy of griddedPlot: its settings
+// may change while the map is drawn.
+void Terrain::copyPlotter ()
+{
+	if (griddedPlot != nullptr && griddedPlot->isReaderOk())
+		drawingPlotter.reset (griddedPlot->createDrawingCopy());
+	else
+		drawingPlotter.reset ();
+	mustClearLayers = true;
+}
+//---------------------------------------------------------
+void Terrain::slotFrameReady ()
+{
+	QImage img;
+	Projection *p;
+	if (renderThread->takeFrame (&img, &p)) {
+		frame = img;
+		delete frameProj;
+		frameProj = p;
+		frameProj->getScreenOrigin (&dragOriginX, &dragOriginY);
+		pleaseWait = false;
+		update();
+	}
+}
+//---------------------------------------------------------
+// The last map drawn has the scale of the current projection:
+// it can be moved and completed with the tiles.
+bool Terrain::isFrameAtCurrentScale ()
+{
+	return frameProj != nullptr
+			&& frameProj->getProjection() == proj->getProjection()
+			&& frameProj->getScale() == proj->getScale();
+}
+//---------------------------------------------------------
+// Last map drawn, moved and scaled to the current view
+void Terrain::drawMapFrame (QPainter &pnt)
+{
+	if (frameProj == nullptr) {
+		pnt.fillRect (rect(), drawer->backgroundColor);
+		return;
+	}
+	double ox, oy;
+	proj->getScreenOrigin (&ox, &oy);
+	if (isFrameAtCurrentScale()) {
+		QPoint pos (qRound(dragOriginX-ox), qRound(dragOriginY-oy));
+		if (pos != QPoint(0,0) || frame.size() != size())
+			pnt.fillRect (rect(), drawer->backgroundColor);
+		pnt.drawImage (pos, frame);
+	}
+	else {
+		// position of the corners of the old map in the current view
+		double x0,y0, x1,y1;
+		int i0,j0, i1,j1;
+		frameProj->screen2map (0, 0, &x0, &y0);
+		frameProj->screen2map (frame.width(), frame.height(), &x1, &y1);
+		proj->map2screen (x0, y0, &i0, &j0);
+		proj->map2screen (x1, y1, &i1, &j1);
+		pnt.fillRect (rect(), drawer->backgroundColor);
+		if (i1 > i0 && j1 > j0) {
+			pnt.setRenderHint (QPainter::SmoothPixmapTransform, true);
+			pnt.drawImage (QRect(i0, j0, i1-i0, j1-j0), frame);
+		}
+	}
+}
 //---------------------------------------------------------
 // paintEvent
 //---------------------------------------------------------
@@ -1179,27 +1323,25 @@ void Terrain::paintEvent(QPaintEvent *)
     QPainter pnt (this);
     QColor transp;
     int r = 100;
-    if (!isResizing || !firstDrawingIsDone)
+    if (isDraggingMapEnCours && firstDrawingIsDone
+    			&& !isResizing && isFrameAtCurrentScale())
     {
-		firstDrawingIsDone = true;
-        // Draw the map and the GRIB data
-        QCursor oldcursor = cursor();
-        setCursor(Qt::WaitCursor);
-        
-        switch (currentFileType) {
-			case DATATYPE_GRIB :
-				drawer->draw_GSHHS_and_GriddedData 
-					(pnt, mustRedraw, isEarthMapValid, proj, griddedPlot, satellitePlotter, drawCartouche);
-				break;
-			default :
-				drawer->draw_GSHHS (pnt, mustRedraw, isEarthMapValid, proj, satellitePlotter);
-        }
-		
-        setCursor(oldcursor);
-		isEarthMapValid = true;
-		mustRedraw = false;
-		pleaseWait = false;
-        
+		drawMapTiles (pnt);
+    }
+    else
+    {
+		// The map is drawn by the thread: the last map is shown
+		// until the new one is ready (slotFrameReady).
+		if (!isResizing && !isDraggingMapEnCours && !isZoomingWheel
+				&& (mustRedraw || !isEarthMapValid || !firstDrawingIsDone))
+		{
+			firstDrawingIsDone = true;
+			startMapRendering ();
+		}
+		drawMapFrame (pnt);
+	}
+	
+	if (!isResizing) {
         if (selX0!=selX1 && selY0!=selY1) {
             // Draw the rectangle of the selected zone
             pnt.setPen(selectColor);
@@ -1219,16 +1361,6 @@ void Terrain::paintEvent(QPaintEvent *)
             }
         }
     }
-    else {
-        switch (currentFileType) {
-			case DATATYPE_GRIB :
-				drawer->draw_GSHHS_and_GriddedData 
-						(pnt, false, true, proj, griddedPlot, satellitePlotter);
-				break;
-			default :
-				drawer->draw_GSHHS (pnt, mustRedraw, isEarthMapValid, proj, satellitePlotter);
-        }
-	}
     
     if (mustShowSpecialZone) {
 		if (specialZoneX0!=specialZoneX1 && specialZoneY0!=specialZoneY1) {
@@ -1261,6 +1393,125 @@ void Terrain::paintEvent(QPaintEvent *)
     }
 }
 //------------------------------------------------------------------
+// Map tiles
+//------------------------------------------------------------------
+time_t Terrain::getTilesDate ()
+{
+	if (currentFileType == DATATYPE_GRIB && griddedPlot != nullptr)
+		return griddedPlot->getCurrentDate();
+	return 0;
+}
+//------------------------------------------------------------------
+// Tiles covering the screen (and margin tiles around it),
+// except those entirely inside the moved image.
+void Terrain::listMapTiles (std::vector <QPoint> &tiles, int margin)
+{
+	int T = MapTileCache::TileSize;
+	double ox, oy;
+	proj->getScreenOrigin (&ox, &oy);
+	QRect frameRect;
+	if (isFrameAtCurrentScale())
+		frameRect = QRect (qRound(dragOriginX-ox), qRound(dragOriginY-oy),
+						frame.width(), frame.height());
+	int tx0 = (int) floor (ox/T) - margin;
+	int ty0 = (int) floor (oy/T) - margin;
+	int tx1 = (int) floor ((ox+width()-1)/T) + margin;
+	int ty1 = (int) floor ((oy+height()-1)/T) + margin;
+	tiles.clear();
+	for (int ty=ty0; ty<=ty1; ty++) {
+		for (int tx=tx0; tx<=tx1; tx++) {
+			QRect r (qRound(tx*T-ox), qRound(ty*T-oy), T, T);
+			if (! frameRect.contains (r))
+				tiles.push_back (QPoint(tx,ty));
+		}
+	}
+}
+//------------------------------------------------------------------
+void Terrain::drawMapTiles (QPainter &pnt)
+{
+	int T = MapTileCache::TileSize;
+	double ox, oy;
+	proj->getScreenOrigin (&ox, &oy);
+	time_t date = getTilesDate ();
+	std::vector <QPoint> tiles;
+	listMapTiles (tiles, 0);
+	
+	pnt.fillRect (rect(), drawer->backgroundColor);
+	for (const QPoint &t : tiles) {
+		int x = qRound (t.x()*T-ox);
+		int y = qRound (t.y()*T-oy);
+		for (int layer : {MapTileCache::TILE_EARTH, MapTileCache::TILE_DATA}) {
+			const QImage *img = tileCache.find (
+						MapTileCache::makeKey (layer, proj, date, t.x(), t.y(), true));
+			if (img != nullptr)
+				pnt.drawImage (x, y, *img);
+		}
+	}
+	pnt.drawImage (qRound(dragOriginX-ox), qRound(dragOriginY-oy), frame);
+}
+//------------------------------------------------------------------
+// Ask the thread for the missing tiles, visible ones first, then the
+// next ones. The map moves smoothly: the GUI never waits for them.
+void Terrain::slotTimerTiles ()
+{
+	if (!isDraggingMapEnCours || isDrawingTiles)
+		return;		// called again when the tiles are drawn
+	int T = MapTileCache::TileSize;
+	time_t date = getTilesDate ();
+	double ox, oy;
+	proj->getScreenOrigin (&ox, &oy);
+	std::vector <QPoint> tiles;
+	listMapTiles (tiles, 1);
+	QRect screen = rect();
+	std::stable_partition (tiles.begin(), tiles.end(),
+				[&] (const QPoint &t) {
+					return screen.intersects (
+							QRect (qRound(t.x()*T-ox), qRound(t.y()*T-oy), T, T));
+				});
+	
+	MapRenderThread::Job job;
+	for (const QPoint &t : tiles) {
+		for (int layer : {MapTileCache::TILE_EARTH, MapTileCache::TILE_DATA}) {
+			MapTileCache::TileKey key = MapTileCache::makeKey (layer, proj, date, t.x(), t.y(), true);
+			if (tileCache.find (key) == nullptr)
+				job.tiles.push_back (key);
+		}
+	}
+	if (job.tiles.empty())
+		return;
+	// the tiles are only shown while the map moves: fast drawing
+	job.settings = std::make_shared <MapDrawer> (*drawer);
+	job.proj = proj->clone();
+	job.plotter = (currentFileType == DATATYPE_GRIB) ? drawingPlotter : nullptr;
+	job.date = date;
+	job.satellitePlotter = satellitePlotter;
+	job.isEarthMapValid = false;
+	job.clearLayers = mustClearLayers;
+	job.drawCartouche = false;
+	job.interactive = true;
+	job.isMapMoved = false;
+	job.previews = false;
+	mustClearLayers = false;
+	isDrawingTiles = true;
+	renderThread->render (job);
+}
+//------------------------------------------------------------------
+void Terrain::slotTilesReady ()
+{
+	std::vector <MapRenderThread::Tile> tiles;
+	bool done;
+	renderThread->takeTiles (&tiles, &done);
+	for (const MapRenderThread::Tile &t : tiles)
+		tileCache.insert (t.first, t.second);
+	if (! tiles.empty())
+		update();
+	if (done) {
+		isDrawingTiles = false;
+		if (isDraggingMapEnCours)
+			timerTiles->start(0);	// tiles of the new position
+	}
+}
+//------------------------------------------------------------------
 time_t Terrain::getCurrentDate()
 {
 	switch (currentFileType) {
@@ -1276,6 +1527,7 @@ time_t Terrain::getCurrentDate()
 //------------------------------------------------------------------------
 QPixmap * Terrain::createPixmap (time_t date, int width, int height)
 {
+    stopMapRendering();
 	Projection *scaledproj = proj->clone(); 
 	MapDrawer  *scaleddrawer = new MapDrawer (*drawer);
     QPixmap *pixmap = nullptr;
@@ -1290,13 +1542,16 @@ QPixmap * Terrain::createPixmap (time_t date, int width, int height)
 			case DATATYPE_GRIB :
 				if (griddedPlot && griddedPlot->isReaderOk() )
 				{
+					// drawn at the date, the date of the map doesn't change
+					GriddedPlotter *plotter = griddedPlot->createDrawingCopy();
 					pixmap = scaleddrawer->createPixmap_GriddedData ( 
 										date, 
 										false, 
-										griddedPlot,
+										plotter,
                                         satellitePlotter, 
 										scaledproj, 
 										getListPOIs() );
+					delete plotter;
 				}
 				break;
 			default :	// draw only map
@@ -1402,8 +1657,7 @@ void Terrain::setGeopotentialData (const DataCode &dtc)
     if (drawer->getGeopotentialData() != dtc) {
 		Util::setSetting ("geopotentialLinesData", DataCodeStr::serialize(dtc));
         drawer->setGeopotentialData (dtc);
-        mustRedraw = true;
-        update();
+        invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -1412,8 +1666,7 @@ void Terrain::setDrawGeopotential (bool b)
     if (drawer->showGeopotential != b) {
 		drawer->showGeopotential = b;
 		Util::setSetting ("drawGeopotentialLines", b);
-		mustRedraw = true;
-		update();
+		invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -1422,8 +1675,7 @@ void Terrain::setDrawGeopotentialLabels (bool b)
     if (drawer->showGeopotentialLabels != b) {
 		drawer->showGeopotentialLabels = b;
 		Util::setSetting ("drawGeopotentialLinesLabels", b);
-		mustRedraw = true;
-		update(); 
+		invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -1432,8 +1684,7 @@ void Terrain::setGeopotentialStep (int step)
     if (drawer->geopotentialStep != step)  {
 		drawer->geopotentialStep = step;
 		Util::setSetting ("drawGeopotentialLinesStep", step);
-		mustRedraw = true;
-		update();
+		invalidateMap ();
     }
 }
 //-------------------------------------------------------
@@ -32,6 +32,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "POI.h"
 
 #include "MapDrawer.h"
+#include "MapRenderThread.h"
+#include "MapTileCache.h"
 #include "GribPlot.h"
 #include "LongTaskProgress.h"
 
@@ -43,6 +45,7 @@ class Terrain : public QWidget
 
 public:
     Terrain (QWidget *parent, Projection *proj, std::shared_ptr<GshhsReader> gshhsReader);
+    ~Terrain ();
 
 	void    setCurrentDate (time_t t);
 	time_t  getCurrentDate ();
@@ -88,6 +91,11 @@ public:
 	DataCode getColorMapData ();
 					
 	QPixmap * createPixmap (time_t date, int width, int height);
+	
+	// The map is drawn in a thread, with copies of the drawer settings
+	// and of the plotter, but with the same data: must be called
+	// before modifying the data of the plotters (waits for the thread).
+	void  stopMapRendering ();
     
 public slots :
     // Map
@@ -156,13 +164,20 @@ public slots :
 	
     void slotTimerResize();
     void slotTimerZoomWheel();
+    void slotTimerInteractive();
+    void slotTimerTiles();
     void slotMustRedraw();
+    void slotFrameReady();
+    void slotTilesReady();
     
 signals:
     void selectionOK  (double x0, double y0, double x1, double y1);
     void mouseClicked (QMouseEvent * e);
     void mouseMoved   (QMouseEvent * e);
     void mouseLeave   (QEvent * e);
+    // The plotters will change: other drawings with them must be
+    // stopped before returning (direct connection).
+    void stoppingMapRendering ();
 
 
 private:
@@ -196,7 +211,49 @@ private:
     QCursor     shiftCursor;
     QCursor     shiftCursorClick;
 
-	double 		deltaZoomWheel;
+	bool 		isZoomingWheel;     // the last map is scaled, no drawing
+
+    // Fast maps while zooming with the wheel; the full map is drawn
+    // again after a short inactivity.
+    bool        interactiveRendering;
+    QTimer      *timerInteractive;
+
+    //-----------------------------------------------
+    // The map is drawn in a thread; the last complete map is shown
+    // (moved or scaled) until the new one is ready.
+    MapRenderThread *renderThread;
+    QImage       frame;             // last complete map
+    Projection  *frameProj;         // its projection
+    bool         isMapMoved;        // only moved since the last rendering
+    std::shared_ptr <GriddedPlotter> drawingPlotter;   // copy of griddedPlot
+    bool         mustClearLayers;   // for the next job of the thread
+    
+    // What changed since the last map (flags). The current drawing
+    // is canceled without waiting and the map is asked again.
+    enum MapChange {
+        MAP_OVERLAYS = 0,   // settings of the drawer only
+        MAP_LAYERS   = 1,   // the cached layers must be drawn again
+        MAP_PLOTTER  = 2,   // settings of griddedPlot (new copy, layers)
+        MAP_EARTH    = 4    // the earth map must be drawn again
+    };
+    void    invalidateMap (int changes = MAP_OVERLAYS);
+    void    copyPlotter ();
+    void    startMapRendering ();
+    bool    isFrameAtCurrentScale ();
+    void    drawMapFrame (QPainter &pnt);
+
+    //-----------------------------------------------
+    // Map dragging with tiles: the image at the start of the drag
+    // is moved, the uncovered parts are taken from the tiles cache.
+    // Missing tiles are drawn by the thread, visible ones first.
+    MapTileCache tileCache;
+    QTimer      *timerTiles;
+    bool         isDrawingTiles;    // a job of the thread draws tiles
+    double       dragOriginX, dragOriginY;  // screen origin of the last map
+
+    time_t  getTilesDate ();
+    void    listMapTiles (std::vector <QPoint> &tiles, int margin);
+    void    drawMapTiles (QPainter &pnt);
         
     void  draw_OrthodromieSegment
             (QPainter &pnt, double x0,double y0, double x1,double y1, int recurs=0);
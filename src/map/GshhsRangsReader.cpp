@@ -18,157 +18,192 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "GshhsRangsReader.h"
 
+//========================================================================
+// GshhsRangsFiles
+//========================================================================
+GshhsRangsFiles::GshhsRangsFiles (const QString &path, int qual)
+{
+    char txtn[16];
+    snprintf(txtn, 10, "%d", qual);
+    cat = mapFile (fcat, path+"rangs_"+txtn+".cat", &catSize);
+    cel = mapFile (fcel, path+"rangs_"+txtn+".cel", &celSize);
+    rim = mapFile (frim, path+"gshhs_"+txtn+".rim", &rimSize);
+}
+//------------------------------------------------------------------------
+GshhsRangsFiles::~GshhsRangsFiles ()
+{
+    // QFile unmaps the files
+}
 //------------------------------------------------------------------------
-GshhsRangsCell::GshhsRangsCell(FILE *fcat_, FILE *fcel_, FILE *frim_, int x0_, int y0_)
+const uchar *GshhsRangsFiles::mapFile (QFile &file, const QString &fname, qint64 *size)
+{
+    *size = 0;
+    file.setFileName (fname);
+    if (! file.open (QIODevice::ReadOnly))
+        return nullptr;
+    const uchar *data = file.map (0, file.size());
+    if (data != nullptr)
+        *size = file.size();
+    return data;
+}
+
+//========================================================================
+// GshhsRangsCell
+//========================================================================
+GshhsRangsCell::GshhsRangsCell(const GshhsRangsFiles &files, int x0_, int y0_)
 {
-    fcat = fcat_;
-    fcel = fcel_;
-    frim = frim_;    
    	x0cell = x0_;
     y0cell = y0_;
-   	nbpoints = 0;
 	poligonSizeMax = 0;
 	
-	//x0debug=8;  y0debug=39;
-	
     // adresse de la cellule lue dans le fichier .cat
-    int offset = 4*((89 - y0cell) * 360 + x0cell);
-    
-    fseek(fcat, offset, SEEK_SET);
-    int adrcel = readInt4(fcat)-1;
-    fseek(fcel, adrcel, SEEK_SET);
-	//if ((x0cell==x0debug && y0cell==y0debug)) printf("\n===== START CELL =========\n");
-
-    readPolygonList();
+    GshhsRangsBuffer cat (files.cat, files.catSize, 4*((89 - y0cell) * 360 + x0cell));
+    int adrcel = cat.readInt4()-1;
+    GshhsRangsBuffer cel (files.cel, files.celSize, adrcel);
+
+    // Liste des polygones. Version itérative de l'ancienne lecture récursive :
+    // un octet nul termine le niveau courant, la lecture reprend au niveau
+    // précédent et s'arrête quand on revient au premier niveau.
+    int depth = 1;
+    while (depth > 0)
+    {
+        if (cel.readInt1() != 0) {
+            readSegmentLoop (cel, files);
+            computeSignificance (polygons.back());
+            uint size = polygons.back().count;
+            if (poligonSizeMax < size)
+                poligonSizeMax = size;
+            depth ++;
+        }
+        else {
+            depth = (depth <= 2) ? 0 : depth-1;
+        }
+    }
 }
-
 //------------------------------------------------------------------------
-bool GshhsRangsCell::readPolygonList()
+void GshhsRangsCell::addPoint (int x, int y, bool border)
 {
-	// if ((x0cell==x0debug && y0cell==y0debug)) printf("\n--- START POLYGON ---\n");
-    
-    int PolygonByte;
-    int size;
-    
-    PolygonByte = readInt1(fcel);
-    //printf("CEL %ld %d PolygonByte\n", ftell(fcel), PolygonByte);
-
-    if (PolygonByte == 0) {
-        // printf("*** End_PolygonList ***\n");
-        return false;         // Fin de récursion
+    xs.push_back (x/1.e6);
+    ys.push_back (y/1.e6);
+    isCellBorder.push_back (border);
+}
+//------------------------------------------------------------------------
+void GshhsRangsCell::computeSignificance (const Polygon &poly)
+{
+    significance.resize (xs.size());
+    LineSimplifier::computeSignificance (xs.data()+poly.first, ys.data()+poly.first,
+                                         poly.count, significance.data()+poly.first);
+    // les points des bords relient les cellules voisines
+    for (int k=poly.first; k<poly.first+poly.count; k++) {
+        if (isCellBorder[k])
+            significance[k] = LineSimplifier::maxSignificance();
     }
-
-    size = readSegmentLoop();
-    if (poligonSizeMax <size)
-        poligonSizeMax = size;
-
-    while (readPolygonList())
-    {};        // Appel récursif
-    return true;
 }
-    
 //------------------------------------------------------------------------
-int GshhsRangsCell::readSegmentLoop()
+void GshhsRangsCell::readSegmentLoop (GshhsRangsBuffer &cel, const GshhsRangsFiles &files)
 {
-    //printf("============  readSegmentLoop ==========\n");
-    int i,x, y, SegmentByte, PolygonId;
-    int DataType, Clockwise, Interior;
+    int i,x, y, SegmentByte;
+    int DataType, Interior;
     int RimAddress, RimLength;
     
-    GshhsRangsPolygon * newPolygon;
-    GshhsRangsPoint * newPoint;
-
-    newPolygon = new GshhsRangsPolygon();
-    assert(newPolygon);
-    lsPolygons.push_back(newPolygon);
+    Polygon poly;
+    poly.first = xs.size();
+    poly.interior = 0;
+    poly.dataType = 0;
     
-    PolygonId = readInt4(fcel);
+    cel.readInt4();    // PolygonId
     DataType = 1;
     
-    // if ((x0cell==x0debug && y0cell==y0debug)) printf("\n");
     while (DataType != 0)
     {
-        SegmentByte = readInt1(fcel);
+        SegmentByte = cel.readInt1();
         DataType  =  SegmentByte & 7;
-        Clockwise =  (SegmentByte>>3) & 1;
         Interior  =  (SegmentByte>>4) & 7;
-        // if ((x0cell==x0debug && y0cell==y0debug)) printf("CEL DataType=%d Clockwise=%d Interior=%d\n", DataType,Clockwise, Interior);
         if (DataType != 0) {
-            newPolygon->interior = Interior;
-            newPolygon->dataType = DataType;
+            poly.interior = Interior;
+            poly.dataType = DataType;
 		}
         if (DataType>=1 && DataType<=6)
         {
             for (i=0; i<DataType; i++) {
-                nbpoints ++;
-                x = readInt4(fcel);
-                y = readInt4(fcel);
-                //if ((x0cell==x0debug && y0cell==y0debug)) printf("CEL X vertex %d : (%8.4f %8.4f) %d\n", i+1, x/1e6, y/1e6, nbpoints);
-                newPoint = new GshhsRangsPoint(x/1.e6, y/1.e6, true);
-                assert(newPoint);
-                newPolygon->lsPoints.push_back(newPoint);
+                x = cel.readInt4();
+                y = cel.readInt4();
+                addPoint (x, y, true);
             }
         }
         else if (DataType == 7)
         {
-            RimAddress = readInt4(fcel) - 1;
-            RimLength = readInt4(fcel);
-            //if ((x0cell==x0debug && y0cell==y0debug)) printf("CEL  RimAddress=%d  RimLength=%d\n", RimAddress, RimLength);
-            readSegmentRim(RimAddress, RimLength, newPolygon);
+            RimAddress = cel.readInt4() - 1;
+            RimLength = cel.readInt4();
+            readSegmentRim (files, RimAddress, RimLength);
         }
     }
-
-	//if ((x0cell==x0debug && y0cell==y0debug)) printf("*** END POLY size=%d\n", newPolygon->lsPoints.size());
-	return newPolygon->lsPoints.size();
+    poly.count = xs.size() - poly.first;
+    polygons.push_back (poly);
 }
 
 //------------------------------------------------------------------------
-void GshhsRangsCell::readSegmentRim(
-        int RimAddress, int RimLength, GshhsRangsPolygon *polygon)
+void GshhsRangsCell::readSegmentRim (
+        const GshhsRangsFiles &files, int RimAddress, int RimLength)
 {
     int i, x, y;
-    GshhsRangsPoint * newPoint;
+    GshhsRangsBuffer rim (files.rim, files.rimSize, RimAddress);
     
-    fseek(frim, RimAddress, SEEK_SET);
+    // a corrupted length can't be longer than the file
+    RimLength = std::min ((qint64) RimLength, files.rimSize/8);
+    xs.reserve (xs.size()+RimLength);
+    ys.reserve (ys.size()+RimLength);
+    isCellBorder.reserve (isCellBorder.size()+RimLength);
     for (i=0; i<RimLength; i++)
     {
-        nbpoints ++;
-        x = readInt4(frim);
-        y = readInt4(frim);         
-        //if ((x0cell==x0debug && y0cell==y0debug)) printf("++++ RIM vertex %d : (%8.4f %8.4f) %d\n", i+1, x/1e6, y/1e6, nbpoints);
-        newPoint = new GshhsRangsPoint(x/1.e6, y/1.e6, false);
-        assert(newPoint);
-        polygon->lsPoints.push_back(newPoint);
+        x = rim.readInt4();
+        y = rim.readInt4();         
+        addPoint (x, y, false);
     }
 }
 
 
 //=======================================================================================
 //=======================================================================================
+// Projette en une fois les points conservés pour la tolérance
+// (index : numéros des points, dans l'ordre)
+void GshhsRangsCell::projectPoints (double dx, Projection *proj, float tolerance,
+            std::vector <int> &index, std::vector <int> &pi, std::vector <int> &pj)
+{
+    std::vector <double> x, y;
+    index.clear();
+    x.reserve (xs.size());
+    y.reserve (xs.size());
+    for (size_t k=0; k<xs.size(); k++) {
+        if (significance[k] >= tolerance) {
+            index.push_back (k);
+            x.push_back (xs[k]+dx);
+            y.push_back (ys[k]);
+        }
+    }
+    pi.resize (index.size());
+    pj.resize (index.size());
+    proj->map2screenBatch (x.data(), y.data(), index.size(), pi.data(), pj.data());
+}
+//------------------------------------------------------------------------
 void GshhsRangsCell::drawMapPlain(QPainter &pnt, double dx, QPoint *pts, Projection *proj,
-            const QColor& seaColor, const QColor& landColor )
+            const QColor& seaColor, const QColor& landColor,
+            float tolerance )
 {
-// if (!(x0cell==x0debug && y0cell==y0debug))
-// return;
-
-
-    GshhsRangsPolygon *poly;
     int xx, yy, oxx=0, oyy=0, nbpts;
-    
-    QPen landPen(landColor);
-    landPen.setWidthF(1.4);
+    std::vector <int> index, pi, pj;
+    projectPoints (dx, proj, tolerance, index, pi, pj);
+    int p = 0, nk = index.size();
 	
 	pnt.setRenderHint(QPainter::Antialiasing, true);
         
-    for (auto & lsPolygon : lsPolygons)
+    for (const Polygon &poly : polygons)
     {
-        poly = lsPolygon;
-        std::vector <GshhsRangsPoint *> lsPts = poly->lsPoints;
-        
         int j = 0;
-        for (auto pt : lsPts)
+        for ( ; p<nk && index[p]<poly.first+poly.count; p++)
         {
-            proj->map2screen(pt->x+dx, pt->y, &xx, &yy);
+            xx = pi[p];
+            yy = pj[p];
             if (j==0 || (oxx!=xx || oyy!=yy))  // élimine les points trop proches
             {
                 oxx = xx;
@@ -180,9 +215,8 @@ void GshhsRangsCell::drawMapPlain(QPainter &pnt, double dx, QPoint *pts, Project
         }
         nbpts = j;
 
-        if (poly->interior==1 || poly->interior==3) {
+        if (poly.interior==1 || poly.interior==3) {
             pnt.setBrush(landColor);
-			//pnt.setPen(landPen);
 			pnt.setPen(Qt::transparent);
 		}
         else {
@@ -194,51 +228,56 @@ void GshhsRangsCell::drawMapPlain(QPainter &pnt, double dx, QPoint *pts, Project
 }
 
 //------------------------------------------------------------------------
-void GshhsRangsCell::drawSeaBorderLines(QPainter &pnt, double dx, Projection *proj)
+void GshhsRangsCell::drawSeaBorderLines(QPainter &pnt, double dx, Projection *proj,
+            float tolerance)
 {
-    std::vector <GshhsRangsPoint *>::iterator iterPoints;
-    GshhsRangsPolygon *poly;
     int xx, yy;
+    std::vector <int> index, pi, pj;
+    projectPoints (dx, proj, tolerance, index, pi, pj);
+    int p = 0, nk = index.size();
 
-    for (auto & lsPolygon : lsPolygons)
+    for (const Polygon &poly : polygons)
     {
-        poly = lsPolygon;
-        std::vector <GshhsRangsPoint *> lsPts = poly->lsPoints;
-		
-		GshhsRangsPoint *pt;
 		QPoint  pstart, p0, p1;		// points on screen
 		double	xstart, ystart, x0,y0,  x1,y1;    // world coordinate
 		bool	p0_isCellBorder=true, p1_isCellBorder=true;
 		bool	pstart_isCellBorder;
         
-        if (lsPts.size() > 1) {
-        	iterPoints=lsPts.begin();
-			pt = *iterPoints;
-			proj->map2screen(pt->x+dx, pt->y, &xx, &yy);
+        int end = poly.first+poly.count;
+        if (poly.count <= 1) {
+            while (p<nk && index[p]<end)
+                p ++;
+        }
+        else {
+        	// the first point of a polygon is always kept
+        	int k = index[p];
+        	xx = pi[p];
+        	yy = pj[p];
+        	p ++;
 			pstart = QPoint(xx, yy);
-			xstart = pt->x;
-			ystart = pt->y;
-			pstart_isCellBorder = pt->isCellBorder;
+			xstart = xs[k];
+			ystart = ys[k];
+			pstart_isCellBorder = isCellBorder[k];
 			p0 = QPoint(xx, yy);
-			x0 = pt->x;
-			y0 = pt->y;
-			p0_isCellBorder = pt->isCellBorder;
+			x0 = xs[k];
+			y0 = ys[k];
+			p0_isCellBorder = isCellBorder[k];
 			x1 = x0;
 			y1 = y0;
 			
-			++iterPoints;
-			for ( ; iterPoints!=lsPts.end(); ++iterPoints)
+			for ( ; p<nk && index[p]<end; p++)
 			{
-				pt = *iterPoints;
-				proj->map2screen(pt->x+dx, pt->y, &xx, &yy);
+				k = index[p];
+				xx = pi[p];
+				yy = pj[p];
 				p1 = QPoint(xx, yy);
-				x1 = pt->x;
-				y1 = pt->y;
-				p1_isCellBorder = pt->isCellBorder;
+				x1 = xs[k];
+				y1 = ys[k];
+				p1_isCellBorder = isCellBorder[k];
 				
 				if (p0.x()!=xx || p0.y()!=yy)  // élimine les points trop proches
 				{
-					if (pt->isCellBorder)
+					if (p1_isCellBorder)
 					{
 						if (! p0_isCellBorder)   // ne trace pas les bords des cellules
 						{
@@ -286,22 +325,23 @@ GshhsRangsReader::GshhsRangsReader(const QString &rangspath)
 {
     path = rangspath+"/";
 	currentQuality = -1;
+	cachedPoints = 0;
+	generation = 0;
+	prefetchAbort = false;
+	prefetchThread = nullptr;
     setQuality(1);
 }
 //-------------------------------------------------------------------------
 GshhsRangsReader::~GshhsRangsReader()
 {
-	for (auto & allCell : allCells) {
-		for (auto & j : allCell) {
-            delete j;
-		}
+	if (prefetchThread != nullptr) {
+		mutex.lock();
+		prefetchAbort = true;
+		prefetchCondition.wakeAll();
+		mutex.unlock();
+		prefetchThread->wait();
+		delete prefetchThread;
 	}
-	if (fcat)
-		fclose(fcat);
-	if (fcel)
-		fclose(fcel);
-	if (frim)
-		fclose(frim);
 }
 
 //-------------------------------------------------------------------------
@@ -311,41 +351,145 @@ void GshhsRangsReader::setQuality(int quality)  // 5 levels: 0=low ... 4=full
 	{
 		currentQuality = quality;
 		
-		char txtn[16];
 		int qual = 4-quality;   // Fichier .rim : 0=meilleure ... 4=grossière
 		if (qual < 0)   qual = 0;
 		if (qual > 4)   qual = 4;
 		
-		snprintf(txtn, 10, "%d", qual);
+		// the prefetch thread keeps the old files while it uses them
+		std::shared_ptr <GshhsRangsFiles> newFiles
+						= std::make_shared <GshhsRangsFiles> (path, qual);
+		QMutexLocker lock (&mutex);
+		files = newFiles;
+		generation ++;
+		prefetchQueue.clear();
+		clearCells();
+	}
+}
 
-		if (fcat)
-			fclose(fcat);
-		if (fcel)
-			fclose(fcel);
-		if (frim)
-			fclose(frim);
-		
-		fcat = fopen( qPrintable(path+"rangs_"+txtn+".cat"), "rb");
-		fcel = fopen( qPrintable(path+"rangs_"+txtn+".cel"), "rb");
-		frim = fopen( qPrintable(path+"gshhs_"+txtn+".rim"), "rb");
-		
-		for (auto & allCell : allCells) {
-			for (auto & j : allCell) {
-                if (j != nullptr)
-				{
-					delete j;
-                    j = nullptr;
-				}
+//-------------------------------------------------------------------------
+// Cells cache (the mutex must be locked)
+//-------------------------------------------------------------------------
+void GshhsRangsReader::clearCells()
+{
+	cellsCache.clear();
+	cellsLru.clear();
+	cachedPoints = 0;
+}
+//-------------------------------------------------------------------------
+void GshhsRangsReader::insertCell (int key, int gen, std::shared_ptr <GshhsRangsCell> cell)
+{
+	if (gen != generation || cellsCache.find(key) != cellsCache.end())
+		return;
+	cellsLru.push_front (key);
+	CachedCell &cc = cellsCache [key];
+	cc.cell = cell;
+	cc.itLru = cellsLru.begin();
+	cachedPoints += cell->getNbPoints()+1;
+	
+	while (cachedPoints > maxCachedPoints && cellsLru.size() > 1) {
+		auto it = cellsCache.find (cellsLru.back());
+		cachedPoints -= it->second.cell->getNbPoints()+1;
+		cellsCache.erase (it);
+		cellsLru.pop_back();
+	}
+}
+//-------------------------------------------------------------------------
+std::shared_ptr <GshhsRangsCell> GshhsRangsReader::getCell (int cx, int cy)
+{
+	int key = cx*180 + cy+90;
+	int gen;
+	std::shared_ptr <GshhsRangsFiles> f;
+	{
+		QMutexLocker lock (&mutex);
+		auto it = cellsCache.find (key);
+		if (it != cellsCache.end()) {
+			cellsLru.splice (cellsLru.begin(), cellsLru, it->second.itLru);
+			return it->second.cell;
+		}
+		gen = generation;
+		f = files;
+	}
+	// not prefetched: decode it now
+	std::shared_ptr <GshhsRangsCell> cell = std::make_shared <GshhsRangsCell> (*f, cx, cy);
+	QMutexLocker lock (&mutex);
+	insertCell (key, gen, cell);
+	return cell;
+}
+
+//-------------------------------------------------------------------------
+// Prefetch
+//-------------------------------------------------------------------------
+void GshhsRangsReader::prefetchCells (int cxmin, int cxmax, int cymin, int cymax)
+{
+	// ring around the visible cells
+	int margin = std::max (1, std::max (cxmax-cxmin, cymax-cymin)/4);
+	std::vector <int> keys;
+	{
+		QMutexLocker lock (&mutex);
+		for (int cx=cxmin-margin; cx<cxmax+margin; cx++) {
+			int cxx = cx;
+			while (cxx < 0)
+				cxx += 360;
+			while (cxx >= 360)
+				cxx -= 360;
+			for (int cy=cymin-margin; cy<cymax+margin; cy++) {
+				if (cy<-90 || cy>89)
+					continue;
+				if (cx>=cxmin && cx<cxmax && cy>=cymin && cy<cymax)
+					continue;	// visible: already decoded
+				int key = cxx*180 + cy+90;
+				if (cellsCache.find(key) == cellsCache.end())
+					keys.push_back (key);
 			}
 		}
+		prefetchQueue = keys;	// the last view only
+		if (keys.empty())
+			return;
+		prefetchCondition.wakeAll();
+	}
+	if (prefetchThread == nullptr) {
+		prefetchThread = new GshhsRangsPrefetchThread (this);
+		assert(prefetchThread);
+		prefetchThread->start (QThread::LowPriority);
+	}
+}
+//-------------------------------------------------------------------------
+void GshhsRangsPrefetchThread::run()
+{
+	reader->prefetchLoop();
+}
+//-------------------------------------------------------------------------
+void GshhsRangsReader::prefetchLoop()
+{
+	QMutexLocker lock (&mutex);
+	while (! prefetchAbort)
+	{
+		if (prefetchQueue.empty()) {
+			prefetchCondition.wait (&mutex);
+			continue;
+		}
+		int key = prefetchQueue.back();
+		prefetchQueue.pop_back();
+		if (cellsCache.find(key) != cellsCache.end())
+			continue;
+		int gen = generation;
+		std::shared_ptr <GshhsRangsFiles> f = files;
+		
+		lock.unlock();
+		std::shared_ptr <GshhsRangsCell> cell
+				= std::make_shared <GshhsRangsCell> (*f, key/180, key%180-90);
+		lock.relock();
+		
+		insertCell (key, gen, cell);
 	}
 }
 
 //-------------------------------------------------------------------------
 void GshhsRangsReader::drawGshhsRangsMapPlain( QPainter &pnt, Projection *proj,
-                    const QColor& seaColor, const QColor& landColor )
+                    const QColor& seaColor, const QColor& landColor,
+                    double tolerance )
 {
-    if (!fcat || !fcel || !frim)
+    if (! files || ! files->isOk())
         return;
         
     QPoint *pts;
@@ -359,7 +503,6 @@ void GshhsRangsReader::drawGshhsRangsMapPlain( QPainter &pnt, Projection *proj,
     cymin = (int) floor (proj->getYmin());
     cymax = (int) ceil  (proj->getYmax());
     int dx, cx, cxx, cy;
-	GshhsRangsCell *cel;
 
 //printf("cxmin=%d cxmax=%d    cymin=%d cymax=%d\n", cxmin,cxmax, cymin,cymax);
     for (cx=cxmin; cx<cxmax; cx++) {
@@ -373,14 +516,7 @@ void GshhsRangsReader::drawGshhsRangsMapPlain( QPainter &pnt, Projection *proj,
             assert(cxx>=0 && cxx<=359);
             if (cy>=-90 && cy<=89)
             {
-                if (allCells[cxx][cy+90] == nullptr) {
-					cel = new GshhsRangsCell(fcat, fcel, frim, cxx, cy);
-					assert(cel);
-					allCells[cxx][cy+90] = cel;
-				}
-				else {
-					cel = allCells[cxx][cy+90];
-				}
+                std::shared_ptr <GshhsRangsCell> cel = getCell (cxx, cy);
                 if (ptsSize <= cel->getPoligonSizeMax()) {
     				delete [] pts;
                 	ptsSize = cel->getPoligonSizeMax()+1000;
@@ -388,18 +524,20 @@ void GshhsRangsReader::drawGshhsRangsMapPlain( QPainter &pnt, Projection *proj,
 					assert(pts);
                 }
                 dx = cx-cxx;
-                cel -> drawMapPlain(pnt, dx, pts, proj, seaColor, landColor);
+                cel -> drawMapPlain(pnt, dx, pts, proj, seaColor, landColor, tolerance);
             }
         }
     }
-
     delete [] pts;
+    
+    prefetchCells (cxmin, cxmax, cymin, cymax);
 }
 
 //-------------------------------------------------------------------------
-void GshhsRangsReader::drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *proj)
+void GshhsRangsReader::drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *proj,
+                    double tolerance )
 {
-    if (!fcat || !fcel || !frim)
+    if (! files || ! files->isOk())
         return;
 
     int cxmin, cxmax, cymax, cymin;  // cellules visibles
@@ -408,7 +546,6 @@ void GshhsRangsReader::drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *p
     cymin = (int) floor (proj->getYmin());
     cymax = (int) ceil  (proj->getYmax());
     int dx, cx, cxx, cy;
-	GshhsRangsCell *cel;
 
     for (cx=cxmin; cx<cxmax; cx++) {
         cxx = cx;
@@ -421,18 +558,10 @@ void GshhsRangsReader::drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *p
             assert(cxx>=0 && cxx<=359);
             if (cy>=-90 && cy<=89)
             {
-                if (allCells[cxx][cy+90] == nullptr) {
-					cel = new GshhsRangsCell(fcat, fcel, frim, cxx, cy);
-					assert(cel);
-					allCells[cxx][cy+90] = cel;
-				}
-				else {
-					cel = allCells[cxx][cy+90];
-				}
+                std::shared_ptr <GshhsRangsCell> cel = getCell (cxx, cy);
                 dx = cx-cxx;
-                cel->drawSeaBorderLines(pnt, dx, proj);
+                cel->drawSeaBorderLines(pnt, dx, proj, tolerance);
             }
         }
     }
 }
-
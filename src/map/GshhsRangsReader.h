@@ -24,78 +24,118 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <math.h>
 #include <assert.h>
 #include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <algorithm>
 
 #include <QPainter>
+#include <QFile>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "Projection.h"
 #include "Util.h"
+#include "LineSimplifier.h"
 
 //-------------------------------------------------------------------------
-class GshhsRangsPoint 
+// Fichiers RANGS d'un niveau de qualité, projetés en mémoire (lecture seule).
+// Partagés entre le lecteur et le thread de préchargement.
+//-------------------------------------------------------------------------
+class GshhsRangsFiles
 {
-    public :
-        GshhsRangsPoint(double x=0, double y=0, bool isCellBorder=false) {
-            this->x = x;
-            this->y = y;
-            this->isCellBorder = isCellBorder;
-        }
+    public:
+        GshhsRangsFiles (const QString &path, int qual);
+        ~GshhsRangsFiles ();
+        
+        bool isOk () const   {return cat && cel && rim;}
         
-        double x, y;
-        bool  isCellBorder;
+        const uchar *cat, *cel, *rim;
+        qint64  catSize, celSize, rimSize;
+        
+    private:
+        QFile fcat, fcel, frim;
+        const uchar *mapFile (QFile &file, const QString &fname, qint64 *size);
 };
 
 //-------------------------------------------------------------------------
-class GshhsRangsPolygon 
+// Lecture séquentielle dans un fichier projeté en mémoire
+// (0 en dehors du fichier, comme un fread qui échoue).
+//-------------------------------------------------------------------------
+class GshhsRangsBuffer
 {
-    public :
-        ~GshhsRangsPolygon() {
-                Util::cleanVectorPointers(lsPoints);
-            }
-   
-        std::vector <GshhsRangsPoint *> lsPoints;
-        int interior;
-        int dataType;
-/*            Interior =  0 inside is ocean
-                        1 inside is land
-                        2 inside is lake on land
-                        3 inside is island in lake
-                        4 inside is pond on island*/
+    public:
+        GshhsRangsBuffer (const uchar *data, qint64 size, qint64 pos=0)
+                    : data(data), size(size), pos(pos) {}
+        
+        void seek (qint64 p)   {pos = p;}
+        inline int readInt1 ();
+        inline int readInt4 ();
+        
+    private:
+        const uchar *data;
+        qint64 size, pos;
 };
 
+//==========================================================================
+// Cellule de 1°x1° décodée : les points de tous les polygones
+// sont rangés dans des tableaux contigus.
 //==========================================================================
 class GshhsRangsCell
 {
     public:
-
-         GshhsRangsCell(FILE *fcat, FILE *fcel, FILE *frim, int x0, int y0);
-        ~GshhsRangsCell() {
-                Util::cleanVectorPointers(lsPolygons);
-            }
+        GshhsRangsCell (const GshhsRangsFiles &files, int x0, int y0);
         
+        // tolerance: points less significant than this (degrees) are skipped
         void  drawMapPlain(QPainter &pnt, double dx, QPoint *pts, Projection *proj,
-                    const QColor& seaColor, const QColor& landColor );
+                    const QColor& seaColor, const QColor& landColor,
+                    float tolerance );
 
-        void  drawSeaBorderLines(QPainter &pnt, double dx, Projection *proj);
+        void  drawSeaBorderLines(QPainter &pnt, double dx, Projection *proj,
+                    float tolerance);
 		
 		uint  getPoligonSizeMax() {return poligonSizeMax;}
+		int   getNbPoints() const {return (int) xs.size();}
     
     private:
-        int nbpoints;
+        struct Polygon {
+            int first, count;   // points xs[first] ... xs[first+count-1]
+            int interior;
+            int dataType;
+/*            Interior =  0 inside is ocean
+                        1 inside is land
+                        2 inside is lake on land
+                        3 inside is island in lake
+                        4 inside is pond on island*/
+        };
         int x0cell, y0cell;
-        // int x0debug, y0debug;
-        int poligonSizeMax;
+        uint poligonSizeMax;
         
-        FILE *fcat, *fcel, *frim;
-        std::vector <GshhsRangsPolygon *> lsPolygons;
-
-        inline int readInt1(FILE *f);
-        inline int readInt2(FILE *f);
-        inline int readInt4(FILE *f);
+        std::vector <Polygon> polygons;
+        std::vector <double>  xs, ys;
+        std::vector <uchar>   isCellBorder;
+        std::vector <float>   significance;   // points on the cell border are always kept
+
+        void readSegmentLoop (GshhsRangsBuffer &cel, const GshhsRangsFiles &files);
+        void readSegmentRim  (const GshhsRangsFiles &files, int RimAddress, int RimLength);
+        void addPoint (int x, int y, bool border);
+        void computeSignificance (const Polygon &poly);
+        void projectPoints (double dx, Projection *proj, float tolerance,
+                    std::vector <int> &index, std::vector <int> &pi, std::vector <int> &pj);
+};
 
-        bool readPolygonList();
-        int  readSegmentLoop();
-        void readSegmentRim(int RimAddress, int RimLength, GshhsRangsPolygon *polygon);
+//==========================================================================
+class GshhsRangsReader;
 
+class GshhsRangsPrefetchThread : public QThread
+{
+	public:
+        GshhsRangsPrefetchThread (GshhsRangsReader *reader)
+                    : reader(reader) {}
+        void run();
+    private:
+        GshhsRangsReader *reader;
 };
 
 //==========================================================================
@@ -105,18 +145,50 @@ class GshhsRangsReader
         GshhsRangsReader(const QString &path_);
         ~GshhsRangsReader();
 
+        // tolerance: size of the smallest detail drawn (degrees)
         void drawGshhsRangsMapPlain( QPainter &pnt, Projection *proj,
-                    const QColor& seaColor, const QColor& landColor );
+                    const QColor& seaColor, const QColor& landColor,
+                    double tolerance = 0 );
         
-        void drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *proj);
+        void drawGshhsRangsMapSeaBorders( QPainter &pnt, Projection *proj,
+                    double tolerance = 0 );
         
         void setQuality(int quality); // 5 levels: 0=low ... 4=full
 
     private:
+    	friend class GshhsRangsPrefetchThread;
+    	
     	int currentQuality;
         QString path;
-        FILE *fcat{}, *fcel{}, *frim{};
-        GshhsRangsCell * allCells[360][180]{};
+        std::shared_ptr <GshhsRangsFiles> files;
+        
+        //----------------------------------------------------
+        // Decoded cells: LRU cache limited by the number of points.
+        // The cells are shared: a cell removed from the cache while
+        // it is drawn stays valid.
+        //----------------------------------------------------
+        struct CachedCell {
+            std::shared_ptr <GshhsRangsCell> cell;
+            std::list <int>::iterator  itLru;
+        };
+        std::map <int, CachedCell> cellsCache;    // key = x*180 + y+90
+        std::list <int> cellsLru;                 // most recently used first
+        qint64 cachedPoints;
+        static const qint64 maxCachedPoints = 4000000;
+        int    generation;      // incremented when the files change
+        
+        QMutex         mutex;
+        QWaitCondition prefetchCondition;
+        std::vector <int>  prefetchQueue;
+        bool           prefetchAbort;
+        GshhsRangsPrefetchThread *prefetchThread;
+        
+        std::shared_ptr <GshhsRangsCell> getCell (int cx, int cy);
+        void  insertCell (int key, int gen, std::shared_ptr <GshhsRangsCell> cell);
+        void  clearCells ();
+        // Ask the thread to decode the cells around the visible zone
+        void  prefetchCells (int cxmin, int cxmax, int cymin, int cymax);
+        void  prefetchLoop ();
 };
 
 
@@ -124,31 +196,24 @@ class GshhsRangsReader
 
 //======================================================================
 //======================================================================
-inline int GshhsRangsCell::readInt1(FILE *f)
-{
-    unsigned char  buf;
-    if (fread(&buf, 1, 1, f) == 1)
-    	return buf;
-	else
-		return 0;
-}
-//--------------------------------------------------------
-inline int GshhsRangsCell::readInt2(FILE *f)
+inline int GshhsRangsBuffer::readInt1()
 {
-    unsigned char buf[2];
-    if (fread(buf, 1, 2, f) == 2)
-    	return (buf[1]<<8) + (buf[0]);
-	else
-		return 0;
+    if (pos < 0 || pos+1 > size) {
+        pos = size;
+        return 0;
+    }
+    return data[pos++];
 }
 //--------------------------------------------------------
-inline int GshhsRangsCell::readInt4(FILE *f)
+inline int GshhsRangsBuffer::readInt4()
 {
-    unsigned char buf[4];
-    if (fread(buf, 1, 4, f) == 4)
-    	return (buf[3]<<24) + (buf[2]<<16) + (buf[1]<<8) + (buf[0]);
-	else
-		return 0;
+    if (pos < 0 || pos+4 > size) {
+        pos = size;
+        return 0;
+    }
+    const uchar *buf = data+pos;
+    pos += 4;
+    return (buf[3]<<24) + (buf[2]<<16) + (buf[1]<<8) + (buf[0]);
 }
 
 
@@ -16,6 +16,9 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ***********************************************************************/
 
+#include <algorithm>
+#include <cmath>
+
 #include "GshhsReader.h"
 
 //==========================================================
@@ -41,24 +44,56 @@ GshhsPolygon::GshhsPolygon(ZUFILE *file_)
 	    antarctic = (west==0 && east==360);
 		double x, y=-90;
         
+        lons.reserve(antarctic ? n+3 : n);
+        lats.reserve(antarctic ? n+3 : n);
+    	// force l'Antarctic à être un "rectangle" qui passe par le pôle
+        if (antarctic) {
+            lons.push_back(360);  lats.push_back(-90);
+            lons.push_back(360);  lats.push_back(0);    // lat of the last point, set below
+        }
         for (int i=0; i<n; i++) {
             x = GshhsPolygon::readInt4() * 1e-6;
             if (greenwich && x > 270)
                 x -= 360;
             y = GshhsPolygon::readInt4() * 1e-6;
-            lsPoints.push_back(new GshhsPoint(x,y));
+            lons.push_back(x);
+            lats.push_back(y);
         }
-        
-    	// force l'Antarctic à être un "rectangle" qui passe par le pôle
         if (antarctic) {
-            lsPoints.insert (lsPoints.begin(), 2, nullptr);
-        	lsPoints [1] = new GshhsPoint(360, y);
-        	lsPoints [0] = new GshhsPoint(360,-90);
-            lsPoints.push_back(new GshhsPoint(0,-90));
+            lats[1] = y;
+            lons.push_back(0);  lats.push_back(-90);
+        }
+        computeBoundingBox();
+        computeSignificance();
+        if (antarctic) {
+            // garde les bords artificiels qui rejoignent le pôle
+            significance[1] = LineSimplifier::maxSignificance();
+            significance[n+1] = LineSimplifier::maxSignificance();
         }
-    
     }
 }
+//--------------------------------------------------------
+void GshhsPolygon::computeBoundingBox()
+{
+    if (lons.empty())
+        return;
+    west = east = lons[0];
+    south = north = lats[0];
+    for (size_t i=1; i<lons.size(); i++) {
+        if (lons[i] < west)  west = lons[i];
+        if (lons[i] > east)  east = lons[i];
+        if (lats[i] < south) south = lats[i];
+        if (lats[i] > north) north = lats[i];
+    }
+}
+//--------------------------------------------------------
+// Computed once when the polygon is loaded
+void GshhsPolygon::computeSignificance()
+{
+    significance.resize(lons.size());
+    LineSimplifier::computeSignificance(lons.data(), lats.data(),
+                                        (int) lons.size(), significance.data());
+}
 
 //==========================================================
 // GshhsPolygon_WDB     (entete de type GSHHS récent)
@@ -79,14 +114,19 @@ GshhsPolygon_WDB::GshhsPolygon_WDB(ZUFILE *file_)
     greenwich = false;
     antarctic = false;
     if (ok) {
+        lons.reserve(n);
+        lats.reserve(n);
         for (int i=0; i<n; i++) {
             double x, y;
             x = GshhsPolygon_WDB::readInt4() * 1e-6;
             if (greenwich && x > 270)
                 x -= 360;
             y = GshhsPolygon_WDB::readInt4() * 1e-6;
-            lsPoints.push_back(new GshhsPoint(x,y));
+            lons.push_back(x);
+            lats.push_back(y);
         }
+        computeBoundingBox();
+        computeSignificance();
     }
 }
 
@@ -94,10 +134,81 @@ GshhsPolygon_WDB::GshhsPolygon_WDB(ZUFILE *file_)
 //--------------------------------------------------------
 // Destructeur
 GshhsPolygon::~GshhsPolygon() {
-    for (auto & lsPoint : lsPoints) {
-        delete lsPoint;
+}
+
+
+//==========================================================
+// GshhsPolygonList
+//==========================================================
+static const int GSHHS_INDEX_CELL = 10;		// degrés
+static const int GSHHS_INDEX_NX = 720/GSHHS_INDEX_CELL;	// longitudes -360..360
+static const int GSHHS_INDEX_NY = 180/GSHHS_INDEX_CELL;
+
+GshhsPolygonList::GshhsPolygonList()
+{
+    cells.resize(GSHHS_INDEX_NX*GSHHS_INDEX_NY);
+}
+//--------------------------------------------------------
+GshhsPolygonList::~GshhsPolygonList()
+{
+    clear();
+}
+//--------------------------------------------------------
+void GshhsPolygonList::clear()
+{
+    Util::cleanVectorPointers(polygons);
+    for (auto &cell : cells)
+        cell.clear();
+}
+//--------------------------------------------------------
+// Cases recouvertes par la zone (les zones qui sortent de la grille
+// sont rangées dans les cases du bord)
+void GshhsPolygonList::cellsRange (double west, double east, double south, double north,
+                                   int *x0, int *y0, int *x1, int *y1) const
+{
+    *x0 = (int) floor((west +360)/GSHHS_INDEX_CELL);
+    *x1 = (int) floor((east +360)/GSHHS_INDEX_CELL);
+    *y0 = (int) floor((south+ 90)/GSHHS_INDEX_CELL);
+    *y1 = (int) floor((north+ 90)/GSHHS_INDEX_CELL);
+    *x0 = std::min(std::max(*x0, 0), GSHHS_INDEX_NX-1);
+    *x1 = std::min(std::max(*x1, 0), GSHHS_INDEX_NX-1);
+    *y0 = std::min(std::max(*y0, 0), GSHHS_INDEX_NY-1);
+    *y1 = std::min(std::max(*y1, 0), GSHHS_INDEX_NY-1);
+}
+//--------------------------------------------------------
+void GshhsPolygonList::add (GshhsPolygon *poly)
+{
+    int num = polygons.size();
+    polygons.push_back(poly);
+    int x0, y0, x1, y1;
+    cellsRange(poly->west, poly->east, poly->south, poly->north, &x0, &y0, &x1, &y1);
+    for (int cy=y0; cy<=y1; cy++)
+        for (int cx=x0; cx<=x1; cx++)
+            cells[cy*GSHHS_INDEX_NX+cx].push_back(num);
+}
+//--------------------------------------------------------
+void GshhsPolygonList::findPolygons (double west, double east, double south, double north,
+                                     std::vector <GshhsPolygon*> &result) const
+{
+    result.clear();
+    int x0, y0, x1, y1;
+    cellsRange(west, east, south, north, &x0, &y0, &x1, &y1);
+    std::vector <int> found;
+    for (int cy=y0; cy<=y1; cy++) {
+        for (int cx=x0; cx<=x1; cx++) {
+            for (int num : cells[cy*GSHHS_INDEX_NX+cx]) {
+                GshhsPolygon *pol = polygons[num];
+                if (! (pol->west>east || pol->east<west || pol->south>north || pol->north<south))
+                    found.push_back(num);
+            }
+        }
     }
-    lsPoints.clear();
+    // a polygon may be in several cells
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    result.reserve(found.size());
+    for (int num : found)
+        result.push_back(polygons[num]);
 }
 
 
@@ -116,14 +227,16 @@ GshhsReader::GshhsReader (const QString& fpath, int quality)
 	isListCreator = true;
     for (int qual=0; qual<5; qual++)
     {
-        lsPoly_level1[qual] = new std::vector <GshhsPolygon*>;
-        lsPoly_level2[qual] = new std::vector <GshhsPolygon*>;
-        lsPoly_level3[qual] = new std::vector <GshhsPolygon*>;
-        lsPoly_level4[qual] = new std::vector <GshhsPolygon*>;
-        lsPoly_boundaries[qual] = new std::vector <GshhsPolygon*>;
-        lsPoly_rivers[qual] = new std::vector <GshhsPolygon*>;
+        lsPoly_level1[qual] = new GshhsPolygonList;
+        lsPoly_level2[qual] = new GshhsPolygonList;
+        lsPoly_level3[qual] = new GshhsPolygonList;
+        lsPoly_level4[qual] = new GshhsPolygonList;
+        lsPoly_boundaries[qual] = new GshhsPolygonList;
+        lsPoly_rivers[qual] = new GshhsPolygonList;
     }
     userPreferredQuality = quality;
+    clippedView.projection = -1;
+    lodFactor = 1;
     setQuality(quality);
 }
 
@@ -146,6 +259,8 @@ GshhsReader::GshhsReader (const GshhsReader &model)
         lsPoly_rivers[qual] = model.lsPoly_rivers[qual];
     }
     userPreferredQuality = model.userPreferredQuality;
+    clippedView.projection = -1;
+    lodFactor = 1;
     quality = model.quality;
     setQuality(quality);
 }
@@ -162,33 +277,8 @@ GshhsReader::~GshhsReader ()
 //-----------------------------------------------------------------------
 void GshhsReader::clearLists () 
 {
-    std::vector <GshhsPolygon*>::iterator itp;
     for (int qual=0; qual<5; qual++)
     {
-        for (itp=lsPoly_level1[qual]->begin(); itp != lsPoly_level1[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
-        for (itp=lsPoly_level2[qual]->begin(); itp != lsPoly_level2[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
-        for (itp=lsPoly_level3[qual]->begin(); itp != lsPoly_level3[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
-        for (itp=lsPoly_level4[qual]->begin(); itp != lsPoly_level4[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
-        for (itp=lsPoly_boundaries[qual]->begin(); itp != lsPoly_boundaries[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
-        for (itp=lsPoly_rivers[qual]->begin(); itp != lsPoly_rivers[qual]->end(); ++itp) {
-            delete *itp;
-            *itp = nullptr;
-        }
         lsPoly_level1[qual]->clear();
         lsPoly_level2[qual]->clear();
         lsPoly_level3[qual]->clear();
@@ -267,10 +357,10 @@ void GshhsReader::readGshhsFiles()
 				ok = poly->isOk();
 				if (ok) {
 					switch (poly->getLevel()) { /* 0..255 */
-						case 1: lsPoly_level1[quality]->push_back(poly); break;
-						case 2: lsPoly_level2[quality]->push_back(poly); break;
-						case 3: lsPoly_level3[quality]->push_back(poly); break;
-						case 4: lsPoly_level4[quality]->push_back(poly); break;
+						case 1: lsPoly_level1[quality]->add(poly); break;
+						case 2: lsPoly_level2[quality]->add(poly); break;
+						case 3: lsPoly_level3[quality]->add(poly); break;
+						case 4: lsPoly_level4[quality]->add(poly); break;
 						default: delete poly; break;
 					}
 				}
@@ -286,6 +376,7 @@ void GshhsReader::readGshhsFiles()
 //-----------------------------------------------------------------------
 void GshhsReader::setUserPreferredQuality(int quality_) // 5 levels: 0=low ... 4=full
 {
+	QMutexLocker lock(&mutex);
 	userPreferredQuality = quality_;
 }
 
@@ -316,7 +407,7 @@ void GshhsReader::setQuality(int quality_) // 5 levels: 0=low ... 4=full
                 GshhsPolygon *poly = new GshhsPolygon_WDB(file);
                 ok = poly->isOk();
                 if (ok && poly->getLevel() < 2) {
-                    lsPoly_boundaries[quality]->push_back(poly);
+                    lsPoly_boundaries[quality]->add(poly);
                 }
                 else
                     delete poly;
@@ -335,7 +426,7 @@ void GshhsReader::setQuality(int quality_) // 5 levels: 0=low ... 4=full
                 GshhsPolygon *poly = new GshhsPolygon_WDB(file);
                 ok = poly->isOk();
                 if (ok) {
-                    lsPoly_rivers[quality]->push_back(poly);
+                    lsPoly_rivers[quality]->add(poly);
                 }
                 else
                     delete poly;
@@ -347,7 +438,7 @@ void GshhsReader::setQuality(int quality_) // 5 levels: 0=low ... 4=full
 }
 
 //-----------------------------------------------------------------------
-std::vector <GshhsPolygon*> & GshhsReader::getList_level(int level) {
+GshhsPolygonList & GshhsReader::getList_level(int level) {
     switch (level) {
         case 1: return * lsPoly_level1[quality];
         case 2: return * lsPoly_level2[quality];
@@ -357,20 +448,26 @@ std::vector <GshhsPolygon*> & GshhsReader::getList_level(int level) {
     }
 }
 //-----------------------------------------------------------------------
-std::vector <GshhsPolygon*> & GshhsReader::getList_boundaries() {
+GshhsPolygonList & GshhsReader::getList_boundaries() {
     return * lsPoly_boundaries[quality];
 }
 //-----------------------------------------------------------------------
-std::vector <GshhsPolygon*> & GshhsReader::getList_rivers() {
+GshhsPolygonList & GshhsReader::getList_rivers() {
     return * lsPoly_rivers[quality];
 }
         
 //=====================================================================
 // Dessin de la carte
 //=====================================================================
+double GshhsReader::getLodTolerance(Projection *proj)
+{
+    // coefremp = 10000 * (surface in degrees²) / (surface in pixels)
+    return lodFactor * 0.5 * sqrt(proj->getCoefremp() / 10000.0);
+}
+//-----------------------------------------------------------------------
 int GshhsReader::GSHHS_scaledPoints(
             GshhsPolygon *pol, QPoint *pts, double decx,
-            Projection *proj
+            Projection *proj, float tolerance
         )
 {
     // Elimine les polygones en dehors de la zone visible
@@ -388,16 +485,32 @@ int GshhsReader::GSHHS_scaledPoints(
         return 0;
     }
     
-    double x, y;
     int xx, yy, oxx=0, oyy=0;
     int j = 0;
+    const float *lons = pol->lons.data();
+    const float *lats = pol->lats.data();
+    const float *sig = pol->significance.data();
+    int nbpts = pol->getNbPoints();
+    
+    batchX.clear();
+    batchY.clear();
+    for  (int i=0; i<nbpts; i++)
+    {
+        if (sig[i] < tolerance)     // détail plus petit qu'un pixel
+            continue;
+        batchX.push_back(lons[i]+decx);
+        batchY.push_back(lats[i]);
+    }
+    // Ajustement d'échelle
+    int nb = batchX.size();
+    batchI.resize(nb);
+    batchJ.resize(nb);
+    proj->map2screenBatch(batchX.data(), batchY.data(), nb, batchI.data(), batchJ.data());
     
-    for  (auto & lsPoint : pol->lsPoints)
+    for  (int i=0; i<nb; i++)
     {
-        x = lsPoint->lon+decx;
-        y = lsPoint->lat;
-        // Ajustement d'échelle
-        proj->map2screen(x, y, &xx, &yy);
+        xx = batchI[i];
+        yy = batchJ[i];
         if (j==0 || (oxx!=xx || oyy!=yy))  // élimine les ponts trop proches
         {
             oxx = xx;
@@ -412,40 +525,169 @@ int GshhsReader::GSHHS_scaledPoints(
 }
 
 //-----------------------------------------------------------------------
-void GshhsReader::GsshDrawPolygons(QPainter &pnt, std::vector <GshhsPolygon*> &lst,
-                                Projection *proj
+void GshhsReader::findVisiblePolygons(const GshhsPolygonList &lst, double decx,
+                                Projection *proj, std::vector <GshhsPolygon*> &visible
         )
 {
-    int nbp;
-    
-    int nbmax = 10000;
-    QPoint *pts = new QPoint[nbmax];
-    assert(pts);
+    lst.findPolygons(proj->getXmin()-decx, proj->getXmax()-decx,
+                     proj->getYmin(), proj->getYmax(), visible);
+}
+
+//-----------------------------------------------------------------------
+// Sutherland-Hodgman : découpe un polygone par un demi-plan
+// (x >= limit si side=0, x <= limit si side=1, idem pour y avec side=2,3)
+static void clipPolygonSide (const std::vector <double> &xs, const std::vector <double> &ys,
+                             int side, double limit,
+                             std::vector <double> &outx, std::vector <double> &outy)
+{
+    outx.clear();
+    outy.clear();
+    int n = xs.size();
+    if (n == 0)
+        return;
+    auto value  = [side](double x, double y) { return (side<2) ? x : y; };
+    auto inside = [side,limit](double v) { return (side%2==0) ? v>=limit : v<=limit; };
     
-    for  (auto pol : lst) {
-        assert(pol->isOk());
-        
-        if (nbmax < pol->n+2) {
-            nbmax = pol->n+2;
-            delete [] pts;
-            pts = new QPoint[nbmax];
-            assert(pts);
+    double px = xs[n-1], py = ys[n-1];
+    bool   pin = inside(value(px,py));
+    for (int i=0; i<n; i++)
+    {
+        double x = xs[i], y = ys[i];
+        bool in = inside(value(x,y));
+        if (in != pin) {
+            // intersection with the limit
+            double t = (limit - value(px,py)) / (value(x,y) - value(px,py));
+            if (side < 2) {
+                outx.push_back(limit);
+                outy.push_back(py + t*(y-py));
+            }
+            else {
+                outx.push_back(px + t*(x-px));
+                outy.push_back(limit);
+            }
         }
-        
-        nbp = GSHHS_scaledPoints(pol, pts, 0, proj);
-        if (nbp > 3)
-            pnt.drawPolygon(pts, nbp);
+        if (in) {
+            outx.push_back(x);
+            outy.push_back(y);
+        }
+        px = x;  py = y;  pin = in;
+    }
+}
+//-----------------------------------------------------------------------
+const GshhsReader::ClippedPolygons & GshhsReader::getClippedPolygons (
+                                const GshhsPolygonList &lst, Projection *proj)
+{
+    if (   clippedView.projection != proj->getProjection()
+        || clippedView.W != proj->getW() || clippedView.H != proj->getH()
+        || clippedView.xmin != proj->getXmin() || clippedView.xmax != proj->getXmax()
+        || clippedView.ymin != proj->getYmin() || clippedView.ymax != proj->getYmax()
+        || clippedView.lodFactor != lodFactor )
+    {
+        // new view
+        clippedView.projection = proj->getProjection();
+        clippedView.W = proj->getW();
+        clippedView.H = proj->getH();
+        clippedView.xmin = proj->getXmin();
+        clippedView.xmax = proj->getXmax();
+        clippedView.ymin = proj->getYmin();
+        clippedView.ymax = proj->getYmax();
+        clippedView.lodFactor = lodFactor;
+        clippedCache.clear();
+    }
+    for (const ClippedPolygons &cp : clippedCache) {
+        if (cp.lst == &lst)
+            return cp;
+    }
+    
+    clippedCache.push_back(ClippedPolygons());
+    ClippedPolygons &cp = clippedCache.back();
+    cp.lst = &lst;
+    
+    float tolerance = getLodTolerance(proj);
+    // marge de quelques pixels : les bords ajoutés par le découpage restent invisibles
+    double margin = 20*tolerance;
+    std::vector <GshhsPolygon*> visible;
+    std::vector <double> xs, ys, tmpx, tmpy;
+    
+    for (double decx : {0.0, -360.0})
+    {
+        findVisiblePolygons(lst, decx, proj, visible);
+        double x0 = proj->getXmin()-decx - margin;
+        double x1 = proj->getXmax()-decx + margin;
+        double y0 = proj->getYmin() - margin;
+        double y1 = proj->getYmax() + margin;
+        for  (auto pol : visible)
+        {
+            assert(pol->isOk());
+            // Elimine les polygones trop petits
+            int a1, b1, a2, b2;
+            proj->map2screen(pol->west+decx, pol->north, &a1, &b1);
+            proj->map2screen(pol->east+decx, pol->south, &a2, &b2);
+            if (a1==a2 && b1==b2)
+                continue;
+            
+            xs.clear();
+            ys.clear();
+            int nbpts = pol->getNbPoints();
+            for (int i=0; i<nbpts; i++) {
+                if (pol->significance[i] >= tolerance) {
+                    xs.push_back(pol->lons[i]);
+                    ys.push_back(pol->lats[i]);
+                }
+            }
+            // Découpe seulement les polygones qui débordent de la zone
+            if (pol->west<x0 || pol->east>x1 || pol->south<y0 || pol->north>y1)
+            {
+                clipPolygonSide(xs, ys, 0, x0, tmpx, tmpy);
+                clipPolygonSide(tmpx, tmpy, 1, x1, xs, ys);
+                clipPolygonSide(xs, ys, 2, y0, tmpx, tmpy);
+                clipPolygonSide(tmpx, tmpy, 3, y1, xs, ys);
+            }
+            
+            int nb = xs.size();
+            for (int i=0; i<nb; i++)
+                xs[i] += decx;
+            batchI.resize(nb);
+            batchJ.resize(nb);
+            proj->map2screenBatch(xs.data(), ys.data(), nb, batchI.data(), batchJ.data());
             
-        nbp = GSHHS_scaledPoints(pol, pts, -360, proj);
-        if (nbp > 3)
-            pnt.drawPolygon(pts, nbp);
+            int xx, yy, oxx=0, oyy=0;
+            int first = cp.pts.size();
+            for (int i=0; i<nb; i++) {
+                xx = batchI[i];
+                yy = batchJ[i];
+                if (i==0 || (oxx!=xx || oyy!=yy)) {  // élimine les points trop proches
+                    oxx = xx;
+                    oyy = yy;
+                    cp.pts.push_back(QPoint(xx, yy));
+                }
+            }
+            int nbp = cp.pts.size() - first;
+            if (nbp > 3)
+                cp.sizes.push_back(nbp);
+            else
+                cp.pts.resize(first);
+        }
     }
+    return cp;
+}
 
-    delete [] pts;
+//-----------------------------------------------------------------------
+void GshhsReader::GsshDrawPolygons(QPainter &pnt, GshhsPolygonList &lst,
+                                Projection *proj
+        )
+{
+    // Polygons of a level don't overlap: the drawing order doesn't matter
+    const ClippedPolygons &cp = getClippedPolygons(lst, proj);
+    int pos = 0;
+    for (int nbp : cp.sizes) {
+        pnt.drawPolygon(cp.pts.data()+pos, nbp);
+        pos += nbp;
+    }
 }
 
 //-----------------------------------------------------------------------
-void GshhsReader::GsshDrawLines(QPainter &pnt, std::vector <GshhsPolygon*> &lst,
+void GshhsReader::GsshDrawLines(QPainter &pnt, GshhsPolygonList &lst,
                                 Projection *proj, bool isClosed
         )
 {
@@ -454,53 +696,39 @@ void GshhsReader::GsshDrawLines(QPainter &pnt, std::vector <GshhsPolygon*> &lst,
     int nbmax = 10000;
     QPoint *pts = new QPoint[nbmax];
     assert(pts);
+    std::vector <GshhsPolygon*> visible;
+    float tolerance = getLodTolerance(proj);
     
-    for  (auto pol : lst) {
-        assert(pol->isOk());
-        
-        if (nbmax < pol->n+2) {
-            nbmax = pol->n+2;
-            delete [] pts;
-            pts = new QPoint[nbmax];
-            assert(pts);
+    for (double decx : {0.0, -360.0})
+    {
+        findVisiblePolygons(lst, decx, proj, visible);
+        for  (auto pol : visible) {
+            assert(pol->isOk());
+            
+            if (nbmax < pol->getNbPoints()) {
+                nbmax = pol->getNbPoints();
+                delete [] pts;
+                pts = new QPoint[nbmax];
+                assert(pts);
+            }
+            
+            nbp = GSHHS_scaledPoints(pol, pts, decx, proj, tolerance);
+            if (nbp > 1) {
+                if (pol->isAntarctic()) {
+                    // Ne pas tracer les bords artificiels qui rejoignent le pôle
+                    // ajoutés lors de la création des polygones (2 au début, 1 à la fin).
+                    pts ++;
+                    nbp -= 2;
+                    pnt.drawPolyline(pts, nbp);
+                    pts --;
+                }
+                else {
+                    pnt.drawPolyline(pts, nbp);
+                    if (isClosed)
+                        pnt.drawLine(pts[0], pts[nbp-1]);
+                }
+            }
         }
-        
-		
-		//--------------------------------------------------------------
-        nbp = GSHHS_scaledPoints(pol, pts, 0, proj);
-		if (nbp > 1) {
-			if (pol->isAntarctic()) {
-				// Ne pas tracer les bords artificiels qui rejoignent le pôle
-				// ajoutés lors de la création des polygones (2 au début, 1 à la fin).
-				pts ++;
-				nbp -= 2;
-				pnt.drawPolyline(pts, nbp);
-				pts --;
-			}
-			else {
-				pnt.drawPolyline(pts, nbp);
-				if (isClosed)
-					pnt.drawLine(pts[0], pts[nbp-1]);
-			}
-		}
-        
-		//--------------------------------------------------------------
-        nbp = GSHHS_scaledPoints(pol, pts, -360, proj);
-		if (nbp > 1) {
-			if (pol->isAntarctic()) {
-				// Ne pas tracer les bords artificiels qui rejoignent le pôle
-				// ajoutés lors de la création des polygones (2 au début, 1 à la fin).
-				pts ++;
-				nbp -= 2;
-				pnt.drawPolyline(pts, nbp);
-				pts --;
-			}
-			else {
-				pnt.drawPolyline(pts, nbp);
-				if (isClosed)
-					pnt.drawLine(pts[0], pts[nbp-1]);
-			}
-		}
     }
     delete [] pts;
 }
@@ -530,15 +758,18 @@ void GshhsReader::drawBackground( QPainter &pnt, Projection *proj,
 
 //-----------------------------------------------------------------------
 void GshhsReader::drawContinents( QPainter &pnt, Projection *proj,
-            const QColor& seaColor, const QColor& landColor
+            const QColor& seaColor, const QColor& landColor, double lod
         )
 {
+	QMutexLocker lock(&mutex);
+	lodFactor = lod;
 	selectBestQuality(proj);
 	
     pnt.setPen(Qt::transparent);
 
     if (isUsingRangsReader) {
-        gshhsRangsReader->drawGshhsRangsMapPlain(pnt, proj, seaColor, landColor);
+        gshhsRangsReader->drawGshhsRangsMapPlain(pnt, proj, seaColor, landColor,
+                                                 getLodTolerance(proj));
         return;
     }
     
@@ -559,14 +790,16 @@ void GshhsReader::drawContinents( QPainter &pnt, Projection *proj,
 }
 
 //-----------------------------------------------------------------------
-void GshhsReader::drawSeaBorders( QPainter &pnt, Projection *proj)
+void GshhsReader::drawSeaBorders( QPainter &pnt, Projection *proj, double lod)
 {
+	QMutexLocker lock(&mutex);
+	lodFactor = lod;
 	selectBestQuality(proj);
 
     pnt.setBrush(Qt::transparent);
     
     if (isUsingRangsReader) {
-       gshhsRangsReader->drawGshhsRangsMapSeaBorders(pnt, proj);
+       gshhsRangsReader->drawGshhsRangsMapSeaBorders(pnt, proj, getLodTolerance(proj));
        return;
     }
     
@@ -583,15 +816,21 @@ void GshhsReader::drawSeaBorders( QPainter &pnt, Projection *proj)
 }
 
 //-----------------------------------------------------------------------
-void GshhsReader::drawBoundaries( QPainter &pnt, Projection *proj)
+void GshhsReader::drawBoundaries( QPainter &pnt, Projection *proj, double lod)
 {
+	QMutexLocker lock(&mutex);
+	lodFactor = lod;
+	selectBestQuality(proj);
     // Frontières
     GsshDrawLines(pnt, getList_boundaries(), proj, false);
 }
 
 //-----------------------------------------------------------------------
-void GshhsReader::drawRivers( QPainter &pnt, Projection *proj)
+void GshhsReader::drawRivers( QPainter &pnt, Projection *proj, double lod)
 {
+	QMutexLocker lock(&mutex);
+	lodFactor = lod;
+	selectBestQuality(proj);
     // Rivières
     GsshDrawLines(pnt, getList_rivers(), proj, false);
 }
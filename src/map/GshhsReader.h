@@ -22,14 +22,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cassert>
 #include <iostream>
 #include <vector>
+#include <list>
 
 #include <QImage>
+#include <QMutex>
 #include <QPainter>
 
 
 #include "zuFile.h"
 #include "Projection.h"
 #include "GshhsRangsReader.h"
+#include "LineSimplifier.h"
 
 // GSHHS file format:
 //
@@ -45,16 +48,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // greenwich:	1 if Greenwich is crossed
 // source:	0 = CIA WDBII, 1 = WVS
 
-//==========================================================
-class GshhsPoint {
-    public:
-        double lon, lat;    // longitude, latitude
-        GshhsPoint(double lo, double la) {
-            lon = lo;
-            lat = la;
-        }
-};
-
 //==========================================================
 // GshhsPolygon  (compatible avec le format .rim de RANGS)
 //==========================================================
@@ -69,14 +62,19 @@ class GshhsPolygon
         bool  isGreenwich()  {return greenwich;}
         bool isAntarctic()  {return antarctic;}
         bool isOk()         {return ok;}
+        int  getNbPoints() const  {return (int) lons.size();}
         //----------------------
         int id;				/* Unique polygon id number, starting at 0 */
-        int n;				/* Number of points in this polygon */
+        int n;				/* Number of points in this polygon (in the file) */
         int flag;			/* level + version << 8 + greenwich << 16 + source << 24 */
-        double west, east, south, north;	/* min/max extent in DEGREES */
+        double west, east, south, north;	/* min/max extent in DEGREES (of the points) */
         int area;			/* Area of polygon in 1/10 km^2 */
         //----------------------
-        std::vector <GshhsPoint *> lsPoints;
+        // Points in contiguous arrays (one block per polygon)
+        std::vector <float> lons, lats;
+        // Level of detail: a point is drawn if its significance (degrees)
+        // is greater than the tolerance of the zoom level.
+        std::vector <float> significance;
 
     protected:
         ZUFILE *file;
@@ -84,6 +82,8 @@ class GshhsPolygon
         bool greenwich, antarctic;
         inline virtual int readInt4();
         inline virtual int readInt2();
+        void computeBoundingBox();
+        void computeSignificance();
 };
 
 //==========================================================
@@ -99,6 +99,40 @@ class GshhsPolygon_WDB : public GshhsPolygon
 };
 
 //==========================================================
+// GshhsPolygonList : polygones et index spatial
+// (grille de cases de 10 degrés, chaque case contient les polygones
+// dont la boîte englobante la recouvre).
+//==========================================================
+class GshhsPolygonList
+{
+    public:
+        GshhsPolygonList();
+        ~GshhsPolygonList();	// détruit les polygones
+
+        void add (GshhsPolygon *poly);
+        void clear ();
+        bool empty () const   {return polygons.empty();}
+        
+        const std::vector <GshhsPolygon*> & getPolygons () const
+                                {return polygons;}
+        
+        // Polygones dont la boîte englobante intersecte la zone
+        // (dans l'ordre de la liste)
+        void findPolygons (double west, double east, double south, double north,
+                           std::vector <GshhsPolygon*> &result) const;
+
+    private:
+        std::vector <GshhsPolygon*> polygons;
+        std::vector < std::vector <int> > cells;
+
+        void cellsRange (double west, double east, double south, double north,
+                         int *x0, int *y0, int *x1, int *y1) const;
+};
+
+//==========================================================
+// The reader is shared by the drawers of the map, of its tiles and of
+// the animation, in several threads: each drawing locks the reader
+// (quality, cache of the clipped polygons, buffers).
 class GshhsReader
 {
     public:
@@ -108,18 +142,21 @@ class GshhsReader
         
         void setUserPreferredQuality (int quality); // 5 levels: 0=low ... 4=full
         
+        // lod: details smaller than lod pixels are not drawn (default 1).
+        // Greater values give coarser but faster maps.
         void drawBackground (QPainter &pnt, Projection *proj,
                 const QColor& seaColor, const QColor& backgroundColor);
         void drawContinents (QPainter &pnt, Projection *proj,
-                const QColor& seaColor, const QColor& landColor);
+                const QColor& seaColor, const QColor& landColor, double lod=1);
                 
-        void drawSeaBorders (QPainter &pnt, Projection *proj);
-        void drawBoundaries (QPainter &pnt, Projection *proj);
-        void drawRivers (QPainter &pnt, Projection *proj);
+        void drawSeaBorders (QPainter &pnt, Projection *proj, double lod=1);
+        void drawBoundaries (QPainter &pnt, Projection *proj, double lod=1);
+        void drawRivers (QPainter &pnt, Projection *proj, double lod=1);
         
         bool gshhsFilesExists(int quality);
         
     private:
+        QMutex mutex;
         int quality, userPreferredQuality;  // 5 levels: 0=low ... 4=full
         int  getQuality()   {return quality;}
         void setQuality (int quality);
@@ -141,25 +178,55 @@ class GshhsReader
         // Pour chaque type, une liste par niveau de qualité,
         // pour éviter les relectures de fichier (pb mémoire ?)
 		bool  isListCreator;
-        std::vector <GshhsPolygon*> * lsPoly_level1  [5];
-        std::vector <GshhsPolygon*> * lsPoly_level2  [5];
-        std::vector <GshhsPolygon*> * lsPoly_level3  [5];
-        std::vector <GshhsPolygon*> * lsPoly_level4  [5];
-        std::vector <GshhsPolygon*> * lsPoly_boundaries [5];
-        std::vector <GshhsPolygon*> * lsPoly_rivers  [5];
-
-        std::vector <GshhsPolygon*> & getList_level(int level);
-        std::vector <GshhsPolygon*> & getList_boundaries();
-        std::vector <GshhsPolygon*> & getList_rivers();
+        GshhsPolygonList * lsPoly_level1  [5];
+        GshhsPolygonList * lsPoly_level2  [5];
+        GshhsPolygonList * lsPoly_level3  [5];
+        GshhsPolygonList * lsPoly_level4  [5];
+        GshhsPolygonList * lsPoly_boundaries [5];
+        GshhsPolygonList * lsPoly_rivers  [5];
+
+        GshhsPolygonList & getList_level(int level);
+        GshhsPolygonList & getList_boundaries();
+        GshhsPolygonList & getList_rivers();
+        //-----------------------------------------------------
+        // Polygones découpés à la zone visible puis projetés.
+        // Réutilisés tant que la vue ne change pas.
+        struct ClippedView {
+            int    projection, W, H;
+            double xmin, xmax, ymin, ymax;
+            double lodFactor;
+        };
+        struct ClippedPolygons {
+            const GshhsPolygonList *lst;
+            std::vector <QPoint> pts;      // points of all the polygons
+            std::vector <int>    sizes;    // number of points of each polygon
+        };
+        ClippedView  clippedView;
+        std::list <ClippedPolygons> clippedCache;
+        
+        const ClippedPolygons & getClippedPolygons (const GshhsPolygonList &lst,
+                                Projection *proj);
         //-----------------------------------------------------
                 
+        // Buffers for Projection::map2screenBatch
+        std::vector <double> batchX, batchY;
+        std::vector <int>    batchI, batchJ;
+        
+        // Size of a pixel in degrees (x lodFactor): smaller details are not drawn
+        double lodFactor;
+        double getLodTolerance(Projection *proj);
+        
         int GSHHS_scaledPoints(GshhsPolygon *pol, QPoint *pts, double decx,
-                                Projection *proj
+                                Projection *proj, float tolerance
+        );
+        // Polygones visibles avec le décalage de longitude decx
+        void findVisiblePolygons(const GshhsPolygonList &lst, double decx,
+                                Projection *proj, std::vector <GshhsPolygon*> &visible
         );
-        void GsshDrawPolygons(QPainter &pnt, std::vector <GshhsPolygon*> &lst,
+        void GsshDrawPolygons(QPainter &pnt, GshhsPolygonList &lst,
                                 Projection *proj
         );
-        void GsshDrawLines(QPainter &pnt, std::vector <GshhsPolygon*> &lst,
+        void GsshDrawLines(QPainter &pnt, GshhsPolygonList &lst,
                                 Projection *proj, bool isClosed
         );
         void clearLists();
@@ -197,6 +197,20 @@ bool Projection::map2screen_glob (double lon, double lat, int *pi, int *pj) cons
 	return false;
 }
 
+//-------------------------------------------------------------------------------
+void Projection::map2screenBatch (const double *x, const double *y, int n,
+								  int *i, int *j) const
+{
+	for (int k=0; k<n; k++)
+		map2screen (x[k], y[k], &i[k], &j[k]);
+}
+//-------------------------------------------------------------------------------
+void Projection::screen2mapBatch (const int *i, const int *j, int n,
+								  double *x, double *y) const
+{
+	for (int k=0; k<n; k++)
+		screen2map (i[k], j[k], &x[k], &y[k]);
+}
 
 
 
@@ -224,8 +238,9 @@ Projection_ZYGRIB::Projection_ZYGRIB (const Projection_ZYGRIB &model)
 void Projection_ZYGRIB::map2screen (double x, double y, int *i, int *j) const
 {
 	double scaley = scale*dscale;
-	*i =  W/2 + (int) (scale * (x-CX) + 0.5);
-	*j =  H/2 - (int) (scaley * (y-CY) + 0.5);
+	// floor: same rounding on both sides of the center (exact translations)
+	*i =  W/2 + (int) floor (scale * (x-CX) + 0.5);
+	*j =  H/2 - (int) floor (scaley * (y-CY) + 0.5);
 //printf("Projection_ZYGRIB::map2screen: x= %g   %d\n", x, *i);
 }
 
@@ -238,6 +253,45 @@ void Projection_ZYGRIB::screen2map (int i, int j, double *x, double *y) const
 //printf("screen2map : i=%d j=%d  ->  x=%f y=%f \n", i,j, *x,*y);
 }
 
+//-------------------------------------------------------------------------------
+void Projection_ZYGRIB::map2screenBatch (const double *x, const double *y, int n,
+										 int *i, int *j) const
+{
+	double scaley = scale*dscale;
+	int W2 = W/2;
+	int H2 = H/2;
+	for (int k=0; k<n; k++) {
+		i[k] = W2 + (int) floor (scale * (x[k]-CX) + 0.5);
+		j[k] = H2 - (int) floor (scaley * (y[k]-CY) + 0.5);
+	}
+}
+//-------------------------------------------------------------------------------
+void Projection_ZYGRIB::screen2mapBatch (const int *i, const int *j, int n,
+										 double *x, double *y) const
+{
+	double scaley = scale*dscale;
+	for (int k=0; k<n; k++) {
+		x[k] = (double)(i[k] - W/2 + scale*CX)/ scale;
+		y[k] = (double)(H/2 -j[k] + scaley * CY)/ scaley;
+	}
+}
+
+//-------------------------------------------------------------------------------
+void Projection_ZYGRIB::getScreenOrigin (double *x0, double *y0) const
+{
+	double scaley = scale*dscale;
+	*x0 = scale*CX - W/2;
+	*y0 = -scaley*CY - H/2;
+}
+//-------------------------------------------------------------------------------
+void Projection_ZYGRIB::setScreenOrigin (double x0, double y0)
+{
+	double scaley = scale*dscale;
+	CX =  (x0 + W/2) / scale;
+	CY = -(y0 + H/2) / scaley;
+	updateBoundaries();
+}
+
 //--------------------------------------------------------------
 void Projection_ZYGRIB::setVisibleArea (double x0, double y0, double x1, double y1)
 {
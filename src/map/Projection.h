@@ -41,6 +41,13 @@ Q_OBJECT
         virtual void screen2map (int i, int j, double *x, double *y) const = 0;
         virtual void map2screen (double x, double y, int *i, int *j) const = 0;
         bool map2screen_glob (double x, double y, int *i, int *j) const;
+        
+        // Same transformations for arrays of n points (same results as
+        // map2screen and screen2map, but faster for long lists of points).
+        virtual void map2screenBatch (const double *x, const double *y, int n,
+                                      int *i, int *j) const;
+        virtual void screen2mapBatch (const int *i, const int *j, int n,
+                                      double *x, double *y) const;
 		
         virtual void setScale (double sc)  = 0;
         virtual void setScreenSize (int w, int h);
@@ -73,6 +80,14 @@ Q_OBJECT
         virtual void zoom (double k);
         virtual void move (double dx, double dy);
 
+        // Position of the screen top left corner, in pixels of the whole map
+        // at the current scale. Changing it translates the map exactly
+        // (no rounding of the center): used to pan with map tiles.
+        virtual void getScreenOrigin (double *x0, double *y0) const = 0;
+        virtual void setScreenOrigin (double x0, double y0) = 0;
+
+        virtual int  getProjection () const = 0;
+
         enum ProjectionType {
 				 PROJ_ZYGRIB,
 				 PROJ_MERCATOR,
@@ -114,9 +129,18 @@ class Projection_ZYGRIB : public Projection
 
         virtual void screen2map(int i, int j, double *x, double *y) const;
         virtual void map2screen(double x, double y, int *i, int *j) const;
+        virtual void map2screenBatch (const double *x, const double *y, int n,
+                                      int *i, int *j) const;
+        virtual void screen2mapBatch (const int *i, const int *j, int n,
+                                      double *x, double *y) const;
         
         virtual void setVisibleArea(double x0, double y0, double x1, double y1);
         virtual void setScale(double sc);
+
+        virtual void getScreenOrigin (double *x0, double *y0) const;
+        virtual void setScreenOrigin (double x0, double y0);
+
+        int   getProjection () const   {return PROJ_ZYGRIB;}
 	
 	private :
         double dscale;	   // rapport scaley/scalex
@@ -135,20 +159,34 @@ class Projection_libproj : public Projection
 	
         virtual void screen2map(int i, int j, double *x, double *y) const;
         virtual void map2screen(double x, double y, int *i, int *j) const;
+        // Mercator and Plate Carrée: closed-form formulas (WGS84), without libproj.
+        // Other projections: one call to proj_trans_generic.
+        virtual void map2screenBatch (const double *x, const double *y, int n,
+                                      int *i, int *j) const;
+        virtual void screen2mapBatch (const int *i, const int *j, int n,
+                                      double *x, double *y) const;
 		
         virtual void setVisibleArea(double x0, double y0, double x1, double y1);
         virtual void setScale(double sc);
+
+        virtual void getScreenOrigin (double *x0, double *y0) const;
+        virtual void setScreenOrigin (double x0, double y0);
 		
 		void  setProjection(int codeProj);
-		int   getProjection()   {return currentProj;}
+		int   getProjection() const   {return currentProj;}
 
 	private :
+		// Each projection has its own context: the clones may be used
+		// in several threads at the same time.
 #ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
+		projCtx libCtx;
 		projPJ libProj;
 #else
+		PJ_CONTEXT * libCtx;
 		PJ * libProj;
 #endif
 		int  currentProj;
+		void  createContext ();
 };
 
 //=========================================================
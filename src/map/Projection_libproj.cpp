@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <cmath>
 #include <cassert>
 #include <cstdio>
+#include <vector>
 
 #include "Projection.h"
 
@@ -28,6 +29,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 Projection_libproj::Projection_libproj(int code, int w, int h, double cx, double cy, double scale)
 	: Projection(w,h, cx,cy, scale)
 {
+	createContext();
 	setProjection(code);
 	CX = cx;
 	CY = cy;
@@ -38,6 +40,7 @@ Projection_libproj::Projection_libproj(int code, int w, int h, double cx, double
 Projection_libproj::Projection_libproj(const Projection_libproj &model)
 	: Projection(model.getW(),model.getH(), model.getCX(),model.getCY(),model.getScale())
 {
+	createContext();
 	setProjection(model.currentProj);
 	CX = model.getCX();
 	CY = model.getCY();
@@ -45,6 +48,17 @@ Projection_libproj::Projection_libproj(const Projection_libproj &model)
 //    setCenterPosition(model.getCX(),model.getCY());
 }
 //-----------------------------------------------------------------------------------------
+void Projection_libproj::createContext()
+{
+	libProj = nullptr;
+#ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
+	libCtx = pj_ctx_alloc();
+#else
+	libCtx = proj_context_create();
+#endif
+	assert(libCtx);
+}
+//-----------------------------------------------------------------------------------------
 void Projection_libproj::setProjection(int code)
 {
     const char *params[20];
@@ -93,13 +107,17 @@ void Projection_libproj::setProjection(int code)
     params[nbpar++] = "no_defs";
     params[nbpar++] = "over";	// allow longitude > 180Â°
 #ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
-    libProj = pj_init(nbpar, (char **)params);
+	if (libProj != nullptr)
+		pj_free(libProj);
+    libProj = pj_init_ctx(libCtx, nbpar, (char **)params);
 	if (!libProj)
-		printf("proj error: %s\n", pj_strerrno(pj_errno));
+		printf("proj error: %s\n", pj_strerrno(pj_ctx_get_errno(libCtx)));
 #else
-    libProj = proj_create_argv(PJ_DEFAULT_CTX, nbpar, (char **)params);
+	if (libProj != nullptr)
+		proj_destroy(libProj);
+    libProj = proj_create_argv(libCtx, nbpar, (char **)params);
 	if (!libProj)
-		printf("proj error: %s\n", proj_errno_string(proj_errno(libProj)));
+		printf("proj error: %s\n", proj_errno_string(proj_context_errno(libCtx)));
 #endif
 	assert(libProj);
 	currentProj = code;
@@ -117,6 +135,11 @@ Projection_libproj::~Projection_libproj()
 		proj_destroy(libProj);
 #endif
 	}
+#ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
+	pj_ctx_free(libCtx);
+#else
+	proj_context_destroy(libCtx);
+#endif
 }
 
 //-------------------------------------------------------------------------------
@@ -135,14 +158,14 @@ void Projection_libproj::map2screen(double x, double y, int *i, int *j) const
 	data.v =  y * DEG_TO_RAD;
 	data.u =  x * DEG_TO_RAD;
 	res = pj_fwd(data, libProj);
-	*i =  (int) (W/2.0 + scale * (res.u/111319.0-CX) + 0.5);
-	*j =  (int) (H/2.0 - scale * (res.v/111319.0-CY) + 0.5);
+	*i =  (int) floor (W/2.0 + scale * (res.u/111319.0-CX) + 0.5);
+	*j =  (int) floor (H/2.0 - scale * (res.v/111319.0-CY) + 0.5);
 #else
 	data.uv.v =  y;
 	data.uv.u =  x;
 	res = proj_trans(libProj, PJ_FWD, data);
-	*i =  (int) (W/2.0 + scale * (res.uv.u/111319.0-CX) + 0.5);
-	*j =  (int) (H/2.0 - scale * (res.uv.v/111319.0-CY) + 0.5);
+	*i =  (int) floor (W/2.0 + scale * (res.uv.u/111319.0-CX) + 0.5);
+	*j =  (int) floor (H/2.0 - scale * (res.uv.v/111319.0-CY) + 0.5);
 #endif
 	//printf("PROJ   map2screen (%f %f) -> (%3d %3d)\n", x,y, *i,*j);
 }
@@ -168,6 +191,116 @@ void Projection_libproj::screen2map(int i, int j, double *x, double *y) const
 #endif
 	//printf("PROJ   screen2map (%3d %3d) -> (%f %f)\n", i,j, *x,*y);
 }
+//-------------------------------------------------------------------------------
+// Batch transformations
+//-------------------------------------------------------------------------------
+// WGS84 ellipsoid (same parameters as libproj)
+static const double WGS84_A = 6378137.0;
+static const double WGS84_E = sqrt ((2.0 - 1.0/298.257223563) / 298.257223563);
+static const double DEGREE_TO_RAD = M_PI / 180.0;
+
+//-------------------------------------------------------------------------------
+void Projection_libproj::map2screenBatch (const double *x, const double *y, int n,
+										  int *i, int *j) const
+{
+	if (currentProj == PROJ_EQU_CYL || currentProj == PROJ_MERCATOR)
+	{
+		bool merc = (currentProj == PROJ_MERCATOR);
+		for (int p=0; p<n; p++)
+		{
+			double lat = y[p];
+			if (lat <= -90.0)
+				lat = -90.0+1e-5;
+			if (lat >= 90.0)
+				lat = 90.0-1e-5;
+			double u = x[p] * DEGREE_TO_RAD;
+			double v = lat * DEGREE_TO_RAD;
+			if (merc) {
+				double sinphi = sin (v);
+				v = asinh (tan (v)) - WGS84_E * atanh (WGS84_E * sinphi);
+			}
+			i[p] =  (int) floor (W/2.0 + scale * (WGS84_A*u/111319.0-CX) + 0.5);
+			j[p] =  (int) floor (H/2.0 - scale * (WGS84_A*v/111319.0-CY) + 0.5);
+		}
+		return;
+	}
+#ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
+	Projection::map2screenBatch (x, y, n, i, j);
+#else
+	std::vector <double> u (x, x+n);
+	std::vector <double> v (n);
+	for (int p=0; p<n; p++) {
+		v[p] = y[p];
+		if (v[p] <= -90.0)
+			v[p] = -90.0+1e-5;
+		if (v[p] >= 90.0)
+			v[p] = 90.0-1e-5;
+	}
+	proj_trans_generic (libProj, PJ_FWD, u.data(), sizeof(double), n,
+										 v.data(), sizeof(double), n,
+										 nullptr, 0, 0, nullptr, 0, 0);
+	for (int p=0; p<n; p++) {
+		i[p] =  (int) floor (W/2.0 + scale * (u[p]/111319.0-CX) + 0.5);
+		j[p] =  (int) floor (H/2.0 - scale * (v[p]/111319.0-CY) + 0.5);
+	}
+#endif
+}
+//-------------------------------------------------------------------------------
+void Projection_libproj::screen2mapBatch (const int *i, const int *j, int n,
+										  double *x, double *y) const
+{
+	if (currentProj == PROJ_EQU_CYL || currentProj == PROJ_MERCATOR)
+	{
+		bool merc = (currentProj == PROJ_MERCATOR);
+		for (int p=0; p<n; p++)
+		{
+			double u = ((i[p]-W/2.0)/scale+ CX)*111319.0 / WGS84_A;
+			double v = ((H/2.0-j[p])/scale+ CY)*111319.0 / WGS84_A;
+			if (merc) {
+				// latitude from the isometric latitude (iterations as in libproj)
+				double ts = exp (-v);
+				double e2 = 0.5 * WGS84_E;
+				double phi = M_PI_2 - 2 * atan (ts);
+				for (int it=0; it<15; it++) {
+					double con = WGS84_E * sin (phi);
+					double dphi = M_PI_2 - 2 * atan (ts * pow ((1-con)/(1+con), e2)) - phi;
+					phi += dphi;
+					if (fabs (dphi) < 1e-10)
+						break;
+				}
+				v = phi;
+			}
+			x[p] = u / DEGREE_TO_RAD;
+			y[p] = v / DEGREE_TO_RAD;
+		}
+		return;
+	}
+#ifdef ACCEPT_USE_OF_DEPRECATED_PROJ_API_H
+	Projection::screen2mapBatch (i, j, n, x, y);
+#else
+	for (int p=0; p<n; p++) {
+		x[p] =  ((i[p]-W/2.0)/scale+ CX)*111319.0 ;
+		y[p] =  ((H/2.0-j[p])/scale+ CY)*111319.0 ;
+	}
+	proj_trans_generic (libProj, PJ_INV, x, sizeof(double), n,
+										 y, sizeof(double), n,
+										 nullptr, 0, 0, nullptr, 0, 0);
+#endif
+}
+
+//-------------------------------------------------------------------------------
+void Projection_libproj::getScreenOrigin (double *x0, double *y0) const
+{
+	*x0 = scale*CX - W/2.0;
+	*y0 = -scale*CY - H/2.0;
+}
+//-------------------------------------------------------------------------------
+void Projection_libproj::setScreenOrigin (double x0, double y0)
+{
+	CX =  (x0 + W/2.0) / scale;
+	CY = -(y0 + H/2.0) / scale;
+	updateBoundaries();
+}
 //--------------------------------------------------------------
 void Projection_libproj::setVisibleArea(double x0, double y0, double x1, double y1)
 {
@@ -0,0 +1,205 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#include <cmath>
+#include <algorithm>
+
+#include "ScreenMapGrid.h"
+
+static const int    SMG_COARSE_CELL = 16;	// samples between the exact points
+static const double SMG_TOLERANCE = 0.25;	// pixel
+static const double SMG_TOLERANCE_DEG = 1e-4;
+
+QMutex ScreenMapGrid::mutex;
+std::list < std::pair <ScreenMapGrid::Key, std::shared_ptr<const ScreenMapGrid> > >
+		ScreenMapGrid::cache;
+
+//---------------------------------------------------------------------
+bool ScreenMapGrid::Key::operator== (const Key &o) const
+{
+	return projection==o.projection && W==o.W && H==o.H && step==o.step
+		&& CX==o.CX && CY==o.CY && scale==o.scale
+		&& xmin==o.xmin && xmax==o.xmax && ymin==o.ymin && ymax==o.ymax;
+}
+//---------------------------------------------------------------------
+ScreenMapGrid::Key ScreenMapGrid::makeKey (const Projection *proj, int step)
+{
+	Key k;
+	k.projection = proj->getProjection();
+	k.W = proj->getW();
+	k.H = proj->getH();
+	k.step = step;
+	k.CX = proj->getCX();
+	k.CY = proj->getCY();
+	k.scale = proj->getScale();
+	k.xmin = proj->getXmin();
+	k.xmax = proj->getXmax();
+	k.ymin = proj->getYmin();
+	k.ymax = proj->getYmax();
+	return k;
+}
+//---------------------------------------------------------------------
+std::shared_ptr <const ScreenMapGrid> ScreenMapGrid::get (const Projection *proj, int step)
+{
+	Key key = makeKey (proj, step);
+	{
+		QMutexLocker lock (&mutex);
+		for (auto it=cache.begin(); it!=cache.end(); ++it) {
+			if (it->first == key) {
+				cache.splice (cache.begin(), cache, it);
+				return cache.front().second;
+			}
+		}
+	}
+	// computed outside the lock: another thread may compute the same grid
+	std::shared_ptr <const ScreenMapGrid> grid (new ScreenMapGrid (proj, step));
+	QMutexLocker lock (&mutex);
+	cache.push_front (std::make_pair (key, grid));
+	while (cache.size() > cacheMaxSize)
+		cache.pop_back ();
+	return grid;
+}
+
+//=====================================================================
+ScreenMapGrid::ScreenMapGrid (const Projection *proj, int step)
+{
+	this->step = step;
+	nx = proj->getW() / step;
+	ny = proj->getH() / step;
+	nbExact = 0;
+	lons.resize (nx*ny);
+	lats.resize (nx*ny);
+	exact.assign (nx*ny, 0);
+	if (nx==0 || ny==0)
+		return;
+	
+	// Réseau grossier (plus la dernière ligne et la dernière colonne)
+	std::vector <int> as, bs, points;
+	for (int a=0; a<nx-1; a+=SMG_COARSE_CELL)
+		as.push_back (a);
+	as.push_back (nx-1);
+	for (int b=0; b<ny-1; b+=SMG_COARSE_CELL)
+		bs.push_back (b);
+	bs.push_back (ny-1);
+	for (int a : as)
+		for (int b : bs)
+			points.push_back (a*ny+b);
+	computeExact (proj, points);
+	
+	for (size_t ka=0; ka+1<as.size(); ka++)
+		for (size_t kb=0; kb+1<bs.size(); kb++)
+			refine (proj, as[ka], bs[kb], as[ka+1], bs[kb+1]);
+	if (as.size() == 1 || bs.size() == 1) {
+		// une seule ligne ou colonne d'échantillons
+		points.clear();
+		for (int k=0; k<nx*ny; k++)
+			points.push_back (k);
+		computeExact (proj, points);
+	}
+}
+//---------------------------------------------------------------------
+void ScreenMapGrid::computeExact (const Projection *proj, const std::vector <int> &points)
+{
+	std::vector <int> vi, vj, todo;
+	for (int p : points) {
+		if (! exact[p]) {
+			todo.push_back (p);
+			vi.push_back ((p/ny)*step);
+			vj.push_back ((p%ny)*step);
+		}
+	}
+	int n = todo.size();
+	std::vector <double> x (n), y (n);
+	proj->screen2mapBatch (vi.data(), vj.data(), n, x.data(), y.data());
+	for (int k=0; k<n; k++) {
+		lons [todo[k]] = x[k];
+		lats [todo[k]] = y[k];
+		exact [todo[k]] = 1;
+	}
+	nbExact += n;
+}
+//---------------------------------------------------------------------
+void ScreenMapGrid::interpolate (int a, int b, int a0, int b0, int a1, int b1,
+								 double *lon, double *lat) const
+{
+	double u = (a1==a0) ? 0 : (double)(a-a0)/(a1-a0);
+	double v = (b1==b0) ? 0 : (double)(b-b0)/(b1-b0);
+	int p00=a0*ny+b0, p01=a0*ny+b1, p10=a1*ny+b0, p11=a1*ny+b1;
+	*lon = (1-u)*((1-v)*lons[p00] + v*lons[p01]) + u*((1-v)*lons[p10] + v*lons[p11]);
+	*lat = (1-u)*((1-v)*lats[p00] + v*lats[p01]) + u*((1-v)*lats[p10] + v*lats[p11]);
+}
+//---------------------------------------------------------------------
+// Les 4 coins de la cellule sont exacts.
+void ScreenMapGrid::refine (const Projection *proj, int a0, int b0, int a1, int b1)
+{
+	if (a1-a0 <= 1 && b1-b0 <= 1)
+		return;
+	std::vector <int> points;
+	if (a1-a0 <= 2 && b1-b0 <= 2) {
+		// petite cellule : calcul exact
+		for (int a=a0; a<=a1; a++)
+			for (int b=b0; b<=b1; b++)
+				points.push_back (a*ny+b);
+		computeExact (proj, points);
+		return;
+	}
+	int am = (a0+a1)/2;
+	int bm = (b0+b1)/2;
+	// points de test : centre et milieux des côtés
+	points = { am*ny+bm, am*ny+b0, am*ny+b1, a0*ny+bm, a1*ny+bm };
+	computeExact (proj, points);
+	
+	// Déplacement (degrés) pour un pixel selon i et selon j :
+	// les écarts sont convertis en pixels.
+	double xlon = (lons[a1*ny+b0]-lons[a0*ny+b0]) / ((a1-a0)*step);
+	double xlat = (lats[a1*ny+b0]-lats[a0*ny+b0]) / ((a1-a0)*step);
+	double ylon = (lons[a0*ny+b1]-lons[a0*ny+b0]) / ((b1-b0)*step);
+	double ylat = (lats[a0*ny+b1]-lats[a0*ny+b0]) / ((b1-b0)*step);
+	double det = xlon*ylat - xlat*ylon;
+	
+	bool ok = true;
+	for (int p : points) {
+		double lon, lat;
+		interpolate (p/ny, p%ny, a0, b0, a1, b1, &lon, &lat);
+		double dlon = lons[p]-lon;
+		double dlat = lats[p]-lat;
+		if (std::fabs(dlon) < SMG_TOLERANCE_DEG && std::fabs(dlat) < SMG_TOLERANCE_DEG)
+			continue;		// far below the resolution of any data
+		double di = (dlon*ylat - dlat*ylon) / det;
+		double dj = (xlon*dlat - xlat*dlon) / det;
+		if (! (std::hypot (di, dj) <= SMG_TOLERANCE)) {	// NaN: outside of the projection
+			ok = false;
+			break;
+		}
+	}
+	if (ok) {
+		for (int a=a0; a<=a1; a++) {
+			for (int b=b0; b<=b1; b++) {
+				int p = a*ny+b;
+				if (! exact[p])
+					interpolate (a, b, a0, b0, a1, b1, &lons[p], &lats[p]);
+			}
+		}
+	}
+	else {
+		refine (proj, a0, b0, am, bm);
+		refine (proj, am, b0, a1, bm);
+		refine (proj, a0, bm, am, b1);
+		refine (proj, am, bm, a1, b1);
+	}
+}
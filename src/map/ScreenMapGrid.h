@@ -0,0 +1,83 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef SCREENMAPGRID_H
+#define SCREENMAPGRID_H
+
+#include <vector>
+#include <list>
+#include <memory>
+
+#include <QMutex>
+
+#include "Projection.h"
+
+//===============================================================
+// Coordonnées géographiques des pixels (step*a, step*b) de l'écran.
+// screen2map n'est calculé exactement que sur un réseau grossier,
+// affiné (quadtree) là où l'interpolation bilinéaire s'écarte
+// de plus de tolerance pixel de la projection. Ailleurs, les valeurs
+// sont interpolées.
+// Les grilles sont partagées (cache par état de la projection).
+//===============================================================
+class ScreenMapGrid
+{
+    public:
+        // Grid of the current state of the projection (thread safe)
+        static std::shared_ptr <const ScreenMapGrid> get (const Projection *proj,
+                                                          int step = 2);
+
+        int getNx () const    {return nx;}    // pixels i = 0, step, ..., step*(nx-1)
+        int getNy () const    {return ny;}
+        int getStep () const  {return step;}
+
+        void getMap (int a, int b, double *lon, double *lat) const
+                        { *lon = lons [a*ny+b];  *lat = lats [a*ny+b]; }
+        // ny values of the column a (pixel i = step*a)
+        const double *getColumnLon (int a) const   {return &lons [a*ny];}
+        const double *getColumnLat (int a) const   {return &lats [a*ny];}
+
+        int getNbExactPoints () const   {return nbExact;}
+
+    private:
+        ScreenMapGrid (const Projection *proj, int step);
+
+        struct Key {
+            int    projection, W, H, step;
+            double CX, CY, scale, xmin, xmax, ymin, ymax;
+            bool operator== (const Key &o) const;
+        };
+        static Key makeKey (const Projection *proj, int step);
+
+        static QMutex mutex;
+        static std::list < std::pair <Key, std::shared_ptr<const ScreenMapGrid> > > cache;
+        static const int cacheMaxSize = 8;
+
+        int step, nx, ny;
+        int nbExact;
+        std::vector <double> lons, lats;      // column major: a*ny+b
+        std::vector <unsigned char> exact;
+
+        // points: list of sample indexes a*ny+b
+        void computeExact (const Projection *proj, const std::vector <int> &points);
+        void refine (const Projection *proj, int a0, int b0, int a1, int b1);
+        void interpolate (int a, int b, int a0, int b0, int a1, int b1,
+                          double *lon, double *lat) const;
+};
+
+#endif
@@ -0,0 +1,90 @@
+/**********************************************************************
+XyGrib: meteorological GRIB file viewer
+Copyright (C) 2008-2012 - Jacques Zaninetti - http://www.zygrib.org
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+***********************************************************************/
+
+#ifndef LINESIMPLIFIER_H
+#define LINESIMPLIFIER_H
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "Util.h"
+
+//==========================================================================
+// Simplification de polylignes (Douglas-Peucker).
+// Au lieu de simplifier pour une tolérance donnée, on calcule pour chaque
+// point la plus grande tolérance pour laquelle il est conservé.
+// La polyligne simplifiée pour une tolérance t est formée des points
+// d'importance >= t : changer de zoom ne demande aucun nouveau calcul.
+//==========================================================================
+class LineSimplifier
+{
+    public:
+		static float maxSignificance ()
+						{ return std::numeric_limits<float>::max(); }
+
+		// x, y : n points ; significance : n valeurs calculées
+		template <typename T>
+		static void computeSignificance (const T *x, const T *y, int n,
+										 float *significance);
+};
+
+//--------------------------------------------------------------------------
+template <typename T>
+void LineSimplifier::computeSignificance (const T *x, const T *y, int n,
+										  float *significance)
+{
+	if (n <= 0)
+		return;
+	// Les extrémités sont toujours conservées
+	significance [0] = maxSignificance ();
+	significance [n-1] = maxSignificance ();
+	
+	struct Range {
+		int a, b;       // extrémités de la sous-polyligne
+		float parent;   // importance du point qui l'a créée
+	};
+	std::vector <Range> stack;
+	stack.push_back ({0, n-1, maxSignificance()});
+	while (! stack.empty())
+	{
+		Range r = stack.back ();
+		stack.pop_back ();
+		if (r.b - r.a < 2)
+			continue;
+		double dmax = -1;
+		int    imax = r.a+1;
+		for (int i=r.a+1; i<r.b; i++)
+		{
+			double d = Util::distancePointSegment (x[i], y[i],
+									x[r.a], y[r.a], x[r.b], y[r.b]);
+			if (d > dmax) {
+				dmax = d;
+				imax = i;
+			}
+		}
+		// Un point n'est jamais plus important que celui qui l'encadre :
+		// les points conservés pour une tolérance le sont pour les plus petites.
+		float sig = std::min ((float) dmax, r.parent);
+		significance [imax] = sig;
+		stack.push_back ({r.a, imax, sig});
+		stack.push_back ({imax, r.b, sig});
+	}
+}
+
+#endif